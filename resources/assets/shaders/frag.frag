@@ -59,6 +59,7 @@ uniform Material material;
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 LinearToSrgb(vec3 color);
 
 void main()
 {
@@ -75,7 +76,8 @@ void main()
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
 
-    oFragColor = vec4(result, 1.0);
+    // Albedo textures are linearised when sampled, so lighting happens in linear space
+    oFragColor = vec4(LinearToSrgb(result), 1.0);
 }
 
 // calculates the color when using a directional light.
@@ -90,7 +92,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.albedo_tex, TexCoord));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.albedo_tex, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord));
+    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord).r);
     return (ambient + diffuse + specular);
 }
 
@@ -109,7 +111,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.albedo_tex, TexCoord));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.albedo_tex, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord));
+    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord).r);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -135,9 +137,16 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.albedo_tex, TexCoord));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.albedo_tex, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord));
+    vec3 specular = light.specular * spec * vec3(texture(material.roughness_tex, TexCoord).r);
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
 }
+
+// encodes a linear colour for the sRGB colour buffer.
+vec3 LinearToSrgb(vec3 color)
+{
+    color = clamp(color, 0.0, 1.0);
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
@@ -4,8 +4,25 @@ out vec4 FragColor;
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
+// Environment maps hold linear HDR radiance, other cubemaps are already sRGB encoded
+uniform bool hdr;
+
+vec3 LinearToSrgb(vec3 color);
 
 void main()
 {
-    FragColor = texture(skybox, TexCoords);
+    if (!hdr) {
+        FragColor = texture(skybox, TexCoords);
+        return;
+    }
+    // Only the first level is the sky itself, the rest are prefiltered for rough reflections
+    vec3 radiance = textureLod(skybox, TexCoords, 0.0).rgb;
+    FragColor = vec4(LinearToSrgb(radiance / (radiance + 1.0)), 1.0);  // Reinhard tone mapping
+}
+
+// encodes a linear colour for the sRGB colour buffer, same as in frag.frag.
+vec3 LinearToSrgb(vec3 color)
+{
+    color = clamp(color, 0.0, 1.0);
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
 }
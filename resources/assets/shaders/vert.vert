@@ -16,13 +16,22 @@ layout(std140) uniform Matrices
 };
 uniform mat4 model;
 uniform mat3 mTransposed;
+uniform vec4 uvTransform;  // Scale and offset into a texture atlas
+uniform bool octahedralNormals;  // Packed vertices only store the octahedral encoding of the normal in xy
+
+vec3 OctahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main() {
     FragPos = vec3(model * vec4(iPos, 1.0));
-    Normal = mTransposed * iNormal;
+    Normal = mTransposed * (octahedralNormals ? OctahedralDecode(iNormal.xy) : iNormal);
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 
-    TexCoord = iTexCoord;
+    TexCoord = iTexCoord * uvTransform.xy + uvTransform.zw;
     VertexColor = iColor;
 }
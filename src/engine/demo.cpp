@@ -0,0 +1,141 @@
+#include "demo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "engine/util/logging.h"
+
+namespace Demo {
+    /*! @returns The size of a record's payload, or nothing for unknown record types. */
+    std::optional<size_t> getPayloadSize(const RecordType type) {
+        switch (type) {
+            case RecordType::EVENT:
+                return sizeof(SDL_Event);
+            case RecordType::FRAME:
+            case RecordType::TICK:
+            case RecordType::RENDER:
+                return sizeof(double);
+        }
+        return std::nullopt;
+    }
+
+    bool isRecordedEvent(const SDL_Event& event) {
+        switch (event.type) {
+            case SDL_QUIT:  // Replays end where the recording did anyway
+            case SDL_WINDOWEVENT:
+            case SDL_SYSWMEVENT:
+            case SDL_DROPFILE:
+            case SDL_DROPTEXT:
+            case SDL_DROPBEGIN:
+            case SDL_DROPCOMPLETE:
+                return false;
+            default:
+                return event.type < SDL_USEREVENT;
+        }
+    }
+
+    Expected<Recorder> Recorder::create(const std::string& demoPath) {
+        std::ofstream file(demoPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return std::unexpected(ERROR("Failed to open demo for writing: " + demoPath));
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.eventSize = sizeof(SDL_Event);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+            return std::unexpected(ERROR("Failed to write demo header: " + demoPath));
+        SPDLOG_INFO("Recording demo to \"{}\"", demoPath);
+        return Recorder(std::move(file), demoPath);
+    }
+
+    void Recorder::write(const RecordType type, const void* payload, const size_t size) {
+        if (failed)
+            return;
+        file.put(static_cast<char>(type));
+        file.write(static_cast<const char*>(payload), static_cast<std::streamsize>(size));
+        if (!file) {
+            failed = true;
+            reportError(ERROR("Failed to write demo, the rest of the session won't be recorded: " + path));
+        }
+    }
+
+    void Recorder::recordEvent(const SDL_Event& event) {
+        if (isRecordedEvent(event))
+            write(RecordType::EVENT, &event, sizeof(event));
+    }
+    void Recorder::recordFrame(const double deltaTime) {
+        write(RecordType::FRAME, &deltaTime, sizeof(deltaTime));
+    }
+    void Recorder::recordTick(const double fixedDeltaTime) {
+        write(RecordType::TICK, &fixedDeltaTime, sizeof(fixedDeltaTime));
+    }
+    void Recorder::recordRender(const double interpolationAlpha) {
+        write(RecordType::RENDER, &interpolationAlpha, sizeof(interpolationAlpha));
+    }
+
+    Expected<Player> Player::open(const std::string& demoPath) {
+        std::ifstream file(demoPath, std::ios::binary);
+        if (!file.is_open())
+            return std::unexpected(ERROR("Failed to open demo: " + demoPath));
+        std::vector<unsigned char> data((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
+
+        Header header{};
+        if (data.size() < sizeof(header))
+            return std::unexpected(ERROR("Demo is too small to hold a header: " + demoPath));
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+            return std::unexpected(ERROR("Not a demo: " + demoPath));
+        if (header.version != VERSION)
+            return std::unexpected(ERROR("Unsupported demo version " + std::to_string(header.version) + ": " + demoPath));
+        if (header.eventSize != sizeof(SDL_Event))
+            return std::unexpected(ERROR("Demo was recorded with a different SDL_Event layout: " + demoPath));
+
+        // Check every record up front, so replaying never has to
+        size_t cursor = sizeof(header);
+        while (cursor < data.size()) {
+            const std::optional<size_t> payloadSize = getPayloadSize(static_cast<RecordType>(data[cursor]));
+            if (!payloadSize.has_value())
+                return std::unexpected(ERROR("Unknown record type " + std::to_string(data[cursor]) + " in demo: " + demoPath));
+            if (data.size() - cursor - 1 < payloadSize.value()) {
+                // Most likely the game stopped mid-write, everything before is still good
+                SPDLOG_WARN("Demo \"{}\" ends in a partial record, ignoring it", demoPath);
+                data.resize(cursor);
+                break;
+            }
+            cursor += 1 + payloadSize.value();
+        }
+        SPDLOG_INFO("Replaying demo \"{}\"", demoPath);
+        return Player(std::move(data));
+    }
+
+    std::optional<Record> Player::next() {
+        if (cursor >= data.size())
+            return std::nullopt;
+        Record record{};
+        record.type = static_cast<RecordType>(data[cursor++]);
+        if (record.type == RecordType::EVENT) {
+            std::memcpy(&record.event, data.data() + cursor, sizeof(SDL_Event));
+            cursor += sizeof(SDL_Event);
+        }
+        else {
+            std::memcpy(&record.value, data.data() + cursor, sizeof(double));
+            cursor += sizeof(double);
+        }
+        return record;
+    }
+
+    void Player::addFrameTime(const double seconds) {
+        frameCount++;
+        totalFrameSeconds += seconds;
+        worstFrameSeconds = std::max(worstFrameSeconds, seconds);
+    }
+
+    std::string Player::getSummary() const {
+        if (frameCount == 0)
+            return "No frames replayed";
+        return fmt::format("{} frames in {:.2f} s, average {:.2f} ms ({:.1f} FPS), worst {:.2f} ms",
+            frameCount, totalFrameSeconds, totalFrameSeconds / static_cast<double>(frameCount) * 1000.0,
+            static_cast<double>(frameCount) / totalFrameSeconds, worstFrameSeconds * 1000.0);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <SDL_events.h>
+
+#include "engine/util/error.h"
+
+/*
+ * On-disk layout of a demo (all values little-endian):
+ *   Demo::Header
+ *   records, each a Demo::RecordType byte followed by its payload:
+ *     EVENT   the raw SDL_Event, Header::eventSize bytes
+ *     FRAME   double, the frame's deltaTime
+ *     TICK    double, the deltaTime of one fixed update
+ *     RENDER  double, the interpolation alpha the frame was rendered with
+ *
+ * Records are in the order things happened on the main thread, so replaying them in order reproduces the session.
+ * A frame is everything up to and including its RENDER record.
+ */
+namespace Demo {
+    constexpr char MAGIC[8] = {'L', 'L', 'G', 'D', 'E', 'M', 'O', '\0'};
+    constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t eventSize;  // sizeof(SDL_Event) when recorded, demos from builds where it differs can't be read
+    };
+    static_assert(sizeof(Header) == 16);
+
+    enum class RecordType : uint8_t { EVENT, FRAME, TICK, RENDER };
+
+    struct Record {
+        RecordType type;
+        SDL_Event event;  // EVENT only
+        double value;     // Everything else
+    };
+
+    /*!
+     * @returns Whether an event belongs in a demo.
+     * @details Window events describe the window the demo is replayed in rather than the player,
+     *          and some event types hold pointers.
+     */
+    [[nodiscard]] bool isRecordedEvent(const SDL_Event& event);
+
+    /*!
+     * Writes a demo while the game runs.
+     * @details Writing stops at the first failure, which is reported once.
+     */
+    class Recorder {
+    public:
+        [[nodiscard]] static Expected<Recorder> create(const std::string& demoPath);
+
+        /*! Events that don't belong in a demo are skipped, see \ref isRecordedEvent(). */
+        void recordEvent(const SDL_Event& event);
+        void recordFrame(double deltaTime);
+        void recordTick(double fixedDeltaTime);
+        void recordRender(double interpolationAlpha);
+
+    private:
+        Recorder(std::ofstream&& file, std::string path) : file(std::move(file)), path(std::move(path)) {}
+        void write(RecordType type, const void* payload, size_t size);
+
+        std::ofstream file;
+        std::string path;
+        bool failed = false;
+    };
+
+    /*! Reads back a demo, and keeps track of how fast it was replayed. */
+    class Player {
+    public:
+        /*! Reads and validates a whole demo. */
+        [[nodiscard]] static Expected<Player> open(const std::string& demoPath);
+
+        /*! @returns The next record, or nothing once the demo is over. */
+        [[nodiscard]] std::optional<Record> next();
+
+        /*! Counts a replayed frame and how long it really took. */
+        void addFrameTime(double seconds);
+        /*! @returns The frame count and frame times of the replay so far, to compare between builds. */
+        [[nodiscard]] std::string getSummary() const;
+
+    private:
+        explicit Player(std::vector<unsigned char>&& data) : data(std::move(data)) {}
+
+        std::vector<unsigned char> data;
+        size_t cursor = sizeof(Header);
+
+        size_t frameCount = 0;
+        double totalFrameSeconds = 0.0;
+        double worstFrameSeconds = 0.0;
+    };
+}
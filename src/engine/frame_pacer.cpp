@@ -0,0 +1,140 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <GL/glew.h>
+#include <SDL_timer.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace Engine {
+    // Sleeping can overshoot by about this much, so the last stretch before a deadline is spun instead
+    constexpr double SPIN_SECONDS = 0.001;
+    // The longest sleep between handling events while waiting
+    constexpr double POLL_INTERVAL_SECONDS = 0.001;
+    // Frames still in flight beyond this are dropped from the measurements, so fences can't pile up
+    constexpr size_t MAX_PENDING_FRAMES = 8;
+
+    /*! @returns Whether an event is the player doing something, rather than the window or system. */
+    bool isInputEvent(const SDL_Event& event) {
+        switch (event.type) {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            case SDL_MOUSEMOTION:
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+            case SDL_MOUSEWHEEL:
+            case SDL_CONTROLLERAXISMOTION:
+            case SDL_CONTROLLERBUTTONDOWN:
+            case SDL_CONTROLLERBUTTONUP:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    double secondsBetween(const uint64_t start, const uint64_t end) {
+        return static_cast<double>(end - start) / static_cast<double>(SDL_GetPerformanceFrequency());
+    }
+
+    FramePacer::~FramePacer() {
+        for (const PendingFrame& frame : pendingFrames)
+            glDeleteSync(static_cast<GLsync>(frame.fence));
+#ifdef _WIN32
+        if (timer != nullptr)
+            CloseHandle(timer);
+#endif
+    }
+
+    bool FramePacer::pollEvents(const std::function<bool(const SDL_Event&)>& handleEvent) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (!firstInputTime.has_value() && isInputEvent(event))
+                firstInputTime = SDL_GetPerformanceCounter();
+            if (!handleEvent(event))
+                return false;
+        }
+        return true;
+    }
+
+    bool FramePacer::waitUntil(const uint64_t deadline, const std::function<bool(const SDL_Event&)>& handleEvent) {
+        while (true) {
+            if (!pollEvents(handleEvent))
+                return false;
+            checkFences();
+
+            const uint64_t now = SDL_GetPerformanceCounter();
+            if (now >= deadline)
+                return true;
+            const double remaining = secondsBetween(now, deadline);
+            if (remaining > SPIN_SECONDS)
+                sleepFor(std::min(remaining - SPIN_SECONDS, POLL_INTERVAL_SECONDS));
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void FramePacer::frameSubmitted() {
+        checkFences();
+        if (!firstInputTime.has_value())
+            return;
+        if (pendingFrames.size() == MAX_PENDING_FRAMES) {
+            glDeleteSync(static_cast<GLsync>(pendingFrames.front().fence));
+            pendingFrames.pop_front();
+        }
+        pendingFrames.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), *firstInputTime});
+        // Without a flush the fence might only reach the GPU with the next frame's commands
+        glFlush();
+        firstInputTime.reset();
+    }
+
+    void FramePacer::checkFences() {
+        while (!pendingFrames.empty()) {
+            const PendingFrame& frame = pendingFrames.front();
+            const GLenum status = glClientWaitSync(static_cast<GLsync>(frame.fence), 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                return;  // Frames finish in order, so later ones aren't done either
+            if (status != GL_WAIT_FAILED) {
+                latencySamples[latencySampleCount % LATENCY_SAMPLES] = secondsBetween(frame.inputTime, SDL_GetPerformanceCounter());
+                latencySampleCount++;
+            }
+            glDeleteSync(static_cast<GLsync>(frame.fence));
+            pendingFrames.pop_front();
+        }
+    }
+
+    LatencyStats FramePacer::getLatencyStats() const {
+        LatencyStats stats;
+        stats.sampleCount = std::min(latencySampleCount, LATENCY_SAMPLES);
+        if (stats.sampleCount == 0)
+            return stats;
+        stats.latestSeconds = latencySamples[(latencySampleCount - 1) % LATENCY_SAMPLES];
+        for (size_t i = 0; i < stats.sampleCount; i++) {
+            stats.averageSeconds += latencySamples[i];
+            stats.maxSeconds = std::max(stats.maxSeconds, latencySamples[i]);
+        }
+        stats.averageSeconds /= static_cast<double>(stats.sampleCount);
+        return stats;
+    }
+
+    void FramePacer::sleepFor(const double seconds) {
+#ifdef _WIN32
+        if (timer == nullptr)
+            timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (timer != nullptr) {
+            LARGE_INTEGER dueTime;
+            dueTime.QuadPart = -static_cast<LONGLONG>(seconds * 1e7);  // Negative for relative, in 100 ns units
+            if (SetWaitableTimer(timer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+}
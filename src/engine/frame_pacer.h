@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <SDL_events.h>
+
+namespace Engine {
+    /*! How long input took to show up in a finished frame, over recent frames. */
+    struct LatencyStats {
+        double latestSeconds = 0.0;
+        double averageSeconds = 0.0;
+        double maxSeconds = 0.0;
+        size_t sampleCount = 0;
+    };
+
+    /*!
+     * Limits the frame rate while keeping input latency low, and measures that latency.
+     * @details Instead of sleeping through the rest of a frame, waiting keeps handling events,
+     *          sleeping only in short steps and spinning for the last stretch, so the next frame starts right on time
+     *          with the latest input.
+     *
+     *          Latency is measured from the first input event handled for a frame to the GPU finishing that frame,
+     *          which is checked with a fence. Scanout is not included, so this is input-to-present rather than input-to-photon.
+     *          While waiting, fences are checked continuously, otherwise only once per frame, which rounds latency up.
+     * @note Must only be used on the main thread, with the OpenGL context current.
+     */
+    class FramePacer {
+    public:
+        FramePacer() = default;
+        ~FramePacer();
+        FramePacer(const FramePacer&) = delete;
+        FramePacer& operator=(const FramePacer&) = delete;
+
+        /*!
+         * Handles every pending event.
+         * @param handleEvent Returns false to stop handling events, such as on quit.
+         * @return False if `handleEvent` did.
+         */
+        [[nodiscard]] bool pollEvents(const std::function<bool(const SDL_Event&)>& handleEvent);
+        /*!
+         * Handles events until a deadline, like \ref pollEvents() "pollEvents()" does.
+         * @param deadline In SDL performance counter ticks.
+         * @return False if `handleEvent` did, without waiting for the deadline.
+         */
+        [[nodiscard]] bool waitUntil(uint64_t deadline, const std::function<bool(const SDL_Event&)>& handleEvent);
+        /*! @brief Marks the end of a frame's rendering, after the buffers were swapped. */
+        void frameSubmitted();
+
+        [[nodiscard]] LatencyStats getLatencyStats() const;
+
+    private:
+        void sleepFor(double seconds);
+        /*! Records the latency of every frame whose fence has been reached. */
+        void checkFences();
+
+        struct PendingFrame {
+            void* fence;  // GLsync
+            uint64_t inputTime;
+        };
+        std::optional<uint64_t> firstInputTime;  // Of the frame being prepared
+        std::deque<PendingFrame> pendingFrames;
+
+        static constexpr size_t LATENCY_SAMPLES = 120;
+        std::array<double, LATENCY_SAMPLES> latencySamples{};
+        size_t latencySampleCount = 0;  // In total, the latest is at (count - 1) % LATENCY_SAMPLES
+
+#ifdef _WIN32
+        void* timer = nullptr;  // High resolution waitable timer, as Sleep is only as precise as the system timer
+#endif
+    };
+}
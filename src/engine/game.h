@@ -4,7 +4,20 @@
 bool setupGame();
 void shutdownGame();
 
-bool renderUpdate(double deltaTime);
+/*!
+ * Draws a frame, on the main thread.
+ * @param interpolationAlpha How far time is between the latest two fixed updates, from 0 to 1,
+ *                           for rendering state between them rather than jumping from tick to tick.
+ *                           Always 0 with \ref EngineConfig::threadedSimulation, where a tick can finish between
+ *                           this being worked out and the game reading the latest two ticks' state,
+ *                           so the game works it out from the end time of the tick it read instead.
+ */
+bool renderUpdate(double deltaTime, double interpolationAlpha);
+/*!
+ * Advances the simulation by one tick.
+ * @note Runs on its own thread if \ref EngineConfig::threadedSimulation is enabled,
+ *       so anything shared with rendering or event handling must be synchronised.
+ */
 bool fixedUpdate(double deltaTime);
 
 bool handleEvent(const SDL_Event &event);
@@ -0,0 +1,160 @@
+#include "culling.h"
+
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace Culling {
+    glm::vec4 normalizePlane(const glm::vec4& plane) {
+        const float length = glm::length(glm::vec3(plane));
+        return length > 0.0f ? plane / length : plane;
+    }
+
+    View makeView(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const bool cullBackfaces) {
+        // Gribb and Hartmann: every side plane is the last row of the matrix plus or minus one of the first two
+        const auto row = [&](const int i) {
+            return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        };
+        View view;
+        view.planes = {
+            normalizePlane(row(3) + row(0)),
+            normalizePlane(row(3) - row(0)),
+            normalizePlane(row(3) + row(1)),
+            normalizePlane(row(3) - row(1)),
+        };
+        view.cameraPosition = cameraPosition;
+        view.cullBackfaces = cullBackfaces;
+        return view;
+    }
+
+    MeshletBounds MeshletBounds::build(const std::span<const MeshOptimizer::Meshlet> meshlets) {
+        MeshletBounds bounds;
+        bounds.count = meshlets.size();
+        const size_t padded = (meshlets.size() + 3) / 4 * 4;
+        for (std::vector<float>* array : {&bounds.centerX, &bounds.centerY, &bounds.centerZ, &bounds.radius,
+                                          &bounds.coneAxisX, &bounds.coneAxisY, &bounds.coneAxisZ, &bounds.coneCutoff})
+            array->resize(padded, 0.0f);
+        bounds.firstIndex.resize(padded, 0);
+        bounds.indexCount.resize(padded, 0);
+        for (size_t i = 0; i < meshlets.size(); i++) {
+            const MeshOptimizer::Meshlet& meshlet = meshlets[i];
+            bounds.centerX[i] = meshlet.center[0];
+            bounds.centerY[i] = meshlet.center[1];
+            bounds.centerZ[i] = meshlet.center[2];
+            bounds.radius[i] = meshlet.radius;
+            bounds.coneAxisX[i] = meshlet.coneAxis[0];
+            bounds.coneAxisY[i] = meshlet.coneAxis[1];
+            bounds.coneAxisZ[i] = meshlet.coneAxis[2];
+            bounds.coneCutoff[i] = meshlet.coneCutoff;
+            bounds.firstIndex[i] = meshlet.firstIndex;
+            bounds.indexCount[i] = meshlet.indexCount;
+        }
+        return bounds;
+    }
+
+    /*! The view brought into the model space of one mesh. */
+    struct ModelView {
+        std::array<glm::vec4, 4> planes;
+        glm::vec3 cameraPosition;
+        bool cullBackfaces;
+    };
+
+    ModelView toModelSpace(const View& view, const glm::mat4& modelTransform) {
+        ModelView modelView{};
+        // A plane p keeps the points where dot(p, M x) = 0, so it becomes transpose(M) p
+        const glm::mat4 transposed = glm::transpose(modelTransform);
+        for (size_t i = 0; i < view.planes.size(); i++)
+            modelView.planes[i] = normalizePlane(transposed * view.planes[i]);
+        modelView.cameraPosition = glm::vec3(glm::inverse(modelTransform) * glm::vec4(view.cameraPosition, 1.0f));
+
+        // Normals only keep their angles through rotations and uniform scales, and mirroring swaps which side is the front
+        const float scaleX = glm::length(glm::vec3(modelTransform[0]));
+        const float scaleY = glm::length(glm::vec3(modelTransform[1]));
+        const float scaleZ = glm::length(glm::vec3(modelTransform[2]));
+        constexpr float SCALE_TOLERANCE = 1e-3f;
+        const bool uniformScale = std::abs(scaleX - scaleY) <= SCALE_TOLERANCE * scaleX && std::abs(scaleX - scaleZ) <= SCALE_TOLERANCE * scaleX;
+        modelView.cullBackfaces = view.cullBackfaces && uniformScale && glm::determinant(glm::mat3(modelTransform)) > 0.0f;
+        return modelView;
+    }
+
+    bool isSphereVisible(const View& view, const glm::mat4& modelTransform, const glm::vec3& center, const float radius) {
+        const ModelView modelView = toModelSpace(view, modelTransform);
+        for (const glm::vec4& plane : modelView.planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)
+                return false;
+        return true;
+    }
+
+    void addRange(DrawRanges& ranges, const uint32_t firstIndex, const uint32_t indexCount, const size_t indexSize) {
+        const uintptr_t offset = static_cast<uintptr_t>(firstIndex) * indexSize;
+        // Meshlets are contiguous, so runs of visible ones become a single draw
+        if (!ranges.counts.empty()
+            && reinterpret_cast<uintptr_t>(ranges.offsets.back()) + static_cast<uintptr_t>(ranges.counts.back()) * indexSize == offset) {
+            ranges.counts.back() += static_cast<int32_t>(indexCount);
+            return;
+        }
+        ranges.counts.push_back(static_cast<int32_t>(indexCount));
+        ranges.offsets.push_back(reinterpret_cast<const void*>(offset));
+    }
+
+    void cullMeshlets(const MeshletBounds& meshlets, const glm::mat4& modelTransform, const View& view, const size_t indexSize,
+                      DrawRanges& visible) {
+        const ModelView modelView = toModelSpace(view, modelTransform);
+        const glm::vec3& eye = modelView.cameraPosition;
+#ifdef CULLING_SSE
+        for (size_t i = 0; i < meshlets.count; i += 4) {
+            const __m128 centerX = _mm_loadu_ps(&meshlets.centerX[i]);
+            const __m128 centerY = _mm_loadu_ps(&meshlets.centerY[i]);
+            const __m128 centerZ = _mm_loadu_ps(&meshlets.centerZ[i]);
+            const __m128 radius = _mm_loadu_ps(&meshlets.radius[i]);
+            const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+            __m128 inside = _mm_cmpeq_ps(radius, radius);  // All set, radii are never NaN
+            for (const glm::vec4& plane : modelView.planes) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centerZ), _mm_set1_ps(plane.w)));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+            }
+            if (modelView.cullBackfaces) {
+                const __m128 toCenterX = _mm_sub_ps(centerX, _mm_set1_ps(eye.x));
+                const __m128 toCenterY = _mm_sub_ps(centerY, _mm_set1_ps(eye.y));
+                const __m128 toCenterZ = _mm_sub_ps(centerZ, _mm_set1_ps(eye.z));
+                const __m128 facing = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(toCenterX, _mm_loadu_ps(&meshlets.coneAxisX[i])),
+                    _mm_mul_ps(toCenterY, _mm_loadu_ps(&meshlets.coneAxisY[i]))),
+                    _mm_mul_ps(toCenterZ, _mm_loadu_ps(&meshlets.coneAxisZ[i])));
+                const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(toCenterX, toCenterX), _mm_mul_ps(toCenterY, toCenterY)), _mm_mul_ps(toCenterZ, toCenterZ)));
+                const __m128 backfacing = _mm_cmpge_ps(facing,
+                    _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&meshlets.coneCutoff[i]), distance), radius));
+                inside = _mm_andnot_ps(backfacing, inside);
+            }
+
+            const int mask = _mm_movemask_ps(inside);
+            for (size_t lane = 0; lane < 4 && i + lane < meshlets.count; lane++)
+                if (mask & (1 << lane))
+                    addRange(visible, meshlets.firstIndex[i + lane], meshlets.indexCount[i + lane], indexSize);
+        }
+#else
+        for (size_t i = 0; i < meshlets.count; i++) {
+            const glm::vec3 center(meshlets.centerX[i], meshlets.centerY[i], meshlets.centerZ[i]);
+            bool inside = true;
+            for (const glm::vec4& plane : modelView.planes)
+                inside &= glm::dot(glm::vec3(plane), center) + plane.w > -meshlets.radius[i];
+            if (inside && modelView.cullBackfaces) {
+                const glm::vec3 toCenter = center - eye;
+                const glm::vec3 coneAxis(meshlets.coneAxisX[i], meshlets.coneAxisY[i], meshlets.coneAxisZ[i]);
+                inside = glm::dot(toCenter, coneAxis) < meshlets.coneCutoff[i] * glm::length(toCenter) + meshlets.radius[i];
+            }
+            if (inside)
+                addRange(visible, meshlets.firstIndex[i], meshlets.indexCount[i], indexSize);
+        }
+#endif
+    }
+}
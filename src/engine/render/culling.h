@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "engine/resources/mesh_optimizer.h"
+
+/*
+ * Culling of meshes and their meshlets against the camera, on the CPU, before their index ranges are drawn.
+ *
+ * Bounds stay in model space, the view is brought into the model space of every mesh instead.
+ * Meshlets are tested four at a time, see MeshletBounds.
+ */
+namespace Culling {
+    /*! The camera to cull against, in world space. */
+    struct View {
+        /*! The left, right, bottom and top planes of the frustum, normalised and facing inwards. */
+        std::array<glm::vec4, 4> planes{};
+        glm::vec3 cameraPosition = glm::vec3(0.0f);
+        /*! Whether back faces are culled when drawing, which makes meshlets facing away from the camera safe to skip. */
+        bool cullBackfaces = false;
+    };
+    /*!
+     * @param viewProjection The projection matrix times the view matrix.
+     *                       Only the side planes are used, so it works the same with reversed or [0, 1] depth.
+     */
+    [[nodiscard]] View makeView(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, bool cullBackfaces);
+
+    /*!
+     * The bounds and index ranges of a mesh's meshlets, one array per member so four can be tested at once.
+     * @details Every array is padded to a multiple of four, `count` holds the real number of meshlets.
+     */
+    struct MeshletBounds {
+        std::vector<float> centerX, centerY, centerZ, radius;
+        std::vector<float> coneAxisX, coneAxisY, coneAxisZ, coneCutoff;
+        std::vector<uint32_t> firstIndex, indexCount;
+        size_t count = 0;
+
+        [[nodiscard]] static MeshletBounds build(std::span<const MeshOptimizer::Meshlet> meshlets);
+    };
+
+    /*! Index ranges in the form glMultiDrawElements takes them. */
+    struct DrawRanges {
+        std::vector<int32_t> counts;
+        std::vector<const void*> offsets;  // In bytes, into the bound element buffer
+
+        void clear() {
+            counts.clear();
+            offsets.clear();
+        }
+    };
+
+    /*! @returns Whether a sphere in model space is at least partly inside the view. */
+    [[nodiscard]] bool isSphereVisible(const View& view, const glm::mat4& modelTransform, const glm::vec3& center, float radius);
+    /*!
+     * Finds the meshlets that are inside the view and, if back faces are culled, don't face away from the camera.
+     * @param indexSize The size of one index in the element buffer.
+     * @param visible Receives the index ranges of the visible meshlets, with neighbouring ranges merged.
+     */
+    void cullMeshlets(const MeshletBounds& meshlets, const glm::mat4& modelTransform, const View& view, size_t indexSize,
+                      DrawRanges& visible);
+}
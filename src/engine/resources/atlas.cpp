@@ -0,0 +1,124 @@
+#include "atlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace Atlas {
+    int alignUp(const int value, const int alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    SkylinePacker::SkylinePacker(const int width, const int height)
+        : skyline{{0, 0, width}}, width(width), height(height) {}
+
+    std::optional<int> SkylinePacker::getRestingHeight(const size_t index, const int rectWidth, const int rectHeight) const {
+        if (skyline[index].x + rectWidth > width)
+            return std::nullopt;
+        int y = 0;
+        int remaining = rectWidth;
+        // The segments always cover the whole width, so this never runs past the end
+        for (size_t i = index; remaining > 0; i++) {
+            y = std::max(y, skyline[i].y);
+            if (y + rectHeight > height)
+                return std::nullopt;
+            remaining -= skyline[i].width;
+        }
+        return y;
+    }
+
+    std::optional<Rect> SkylinePacker::insert(const int rectWidth, const int rectHeight) {
+        size_t bestIndex = skyline.size();
+        int bestY = 0, bestTop = height + 1;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            const std::optional<int> y = getRestingHeight(i, rectWidth, rectHeight);
+            if (y.has_value() && y.value() + rectHeight < bestTop) {
+                bestIndex = i;
+                bestY = y.value();
+                bestTop = y.value() + rectHeight;
+            }
+        }
+        if (bestIndex == skyline.size())
+            return std::nullopt;
+
+        const Rect rect{skyline[bestIndex].x, bestY, rectWidth, rectHeight};
+        skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(bestIndex), {rect.x, rect.y + rect.height, rect.width});
+        // Cut the segments the new one now covers
+        for (size_t i = bestIndex + 1; i < skyline.size();) {
+            const int coveredUntil = skyline[i - 1].x + skyline[i - 1].width;
+            if (skyline[i].x >= coveredUntil)
+                break;
+            const int overlap = coveredUntil - skyline[i].x;
+            skyline[i].x += overlap;
+            skyline[i].width -= overlap;
+            if (skyline[i].width > 0)
+                break;
+            skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        // Neighbours at the same height are one segment
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+            } else
+                i++;
+        }
+
+        usedSize.width = std::max(usedSize.width, rect.x + rect.width);
+        usedSize.height = std::max(usedSize.height, rect.y + rect.height);
+        return rect;
+    }
+
+    Size getPaddedSize(const Size size) {
+        return {alignUp(size.width, PADDING) + PADDING * 2, alignUp(size.height, PADDING) + PADDING * 2};
+    }
+
+    Layout pack(const std::span<const Size> sizes, const int maxPageSize) {
+        // Tall images first, so each row of the skyline is evened out by the shorter ones that follow
+        std::vector<size_t> order(sizes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, [&](const size_t a, const size_t b) {
+            return sizes[a].height != sizes[b].height ? sizes[a].height > sizes[b].height : sizes[a].width > sizes[b].width;
+        });
+
+        Layout layout;
+        layout.placements.resize(sizes.size());
+        std::vector<SkylinePacker> packers;
+        for (const size_t index : order) {
+            const Size padded = getPaddedSize(sizes[index]);
+            assert(padded.width <= maxPageSize && padded.height <= maxPageSize);
+            std::optional<Rect> rect;
+            size_t page = 0;
+            for (; page < packers.size() && !rect.has_value(); page++)
+                rect = packers[page].insert(padded.width, padded.height);
+            if (rect.has_value())
+                page--;
+            else {
+                packers.emplace_back(maxPageSize, maxPageSize);
+                rect = packers.back().insert(padded.width, padded.height);
+                page = packers.size() - 1;
+            }
+            layout.placements[index] = {page, {rect->x + PADDING, rect->y + PADDING, sizes[index].width, sizes[index].height}};
+        }
+        for (const SkylinePacker& packer : packers)
+            layout.pages.push_back(packer.getUsedSize());
+        return layout;
+    }
+
+    void copyWithPadding(const std::span<unsigned char> page, const int pageWidth, const Rect& rect,
+                         const std::span<const unsigned char> rgba) {
+        const Size padded = getPaddedSize({rect.width, rect.height});
+        const int left = rect.x - PADDING, top = rect.y - PADDING;
+        for (int y = 0; y < padded.height; y++) {
+            const int sourceY = std::clamp(top + y - rect.y, 0, rect.height - 1);
+            const unsigned char* sourceRow = rgba.data() + static_cast<size_t>(sourceY) * rect.width * 4;
+            unsigned char* row = page.data() + (static_cast<size_t>(top + y) * pageWidth + left) * 4;
+            for (int x = 0; x < PADDING; x++)
+                std::memcpy(row + x * 4, sourceRow, 4);
+            std::memcpy(row + PADDING * 4, sourceRow, static_cast<size_t>(rect.width) * 4);
+            for (int x = PADDING + rect.width; x < padded.width; x++)
+                std::memcpy(row + x * 4, sourceRow + static_cast<size_t>(rect.width - 1) * 4, 4);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+/*
+ * Packing of many small RGBA8 images into a few larger atlas pages.
+ *
+ * Every image is surrounded by PADDING texels copied from its edges, and placed on a PADDING aligned grid,
+ * so the first MIP_LEVEL_COUNT mip levels of a page never blend neighbouring images together.
+ * Levels below that have to be left out when the page is sampled.
+ *
+ * Kept free of engine dependencies, like the mip chain generation it is used with.
+ */
+namespace Atlas {
+    constexpr int PADDING = 8;
+    constexpr int MIP_LEVEL_COUNT = 4;  // One texel of the last level covers exactly PADDING texels of the first
+    static_assert(1 << (MIP_LEVEL_COUNT - 1) == PADDING);
+
+    struct Size {
+        int width, height;
+    };
+    struct Rect {
+        int x, y, width, height;
+    };
+
+    /*!
+     * Bottom-left skyline packer. Tracks the top edge of everything placed so far as a list of horizontal segments,
+     * and places each rectangle where its top edge ends up lowest.
+     */
+    class SkylinePacker {
+    public:
+        SkylinePacker(int width, int height);
+
+        /*! @returns Where the rectangle was placed, or nothing if it doesn't fit anywhere. */
+        std::optional<Rect> insert(int width, int height);
+        /*! @returns The bounds of everything placed so far. */
+        [[nodiscard]] Size getUsedSize() const { return usedSize; }
+
+    private:
+        struct Segment {
+            int x, y, width;
+        };
+        std::vector<Segment> skyline;
+        int width, height;
+        Size usedSize{0, 0};
+
+        /*! @returns The height a rectangle with its left edge at segment `index` would rest at, or nothing if it doesn't fit there. */
+        [[nodiscard]] std::optional<int> getRestingHeight(size_t index, int rectWidth, int rectHeight) const;
+    };
+
+    struct Placement {
+        size_t page;
+        Rect rect;  // Excluding the padding
+    };
+    struct Layout {
+        std::vector<Size> pages;
+        std::vector<Placement> placements;  // In the same order as the packed sizes
+    };
+    /*!
+     * Packs images into as few pages as possible, largest first.
+     * @param maxPageSize The width and height pages are allowed to grow to. Pages are cropped to what they use.
+     * @attention Every image must fit within a page once padded, see \ref getPaddedSize() "getPaddedSize()".
+     */
+    [[nodiscard]] Layout pack(std::span<const Size> sizes, int maxPageSize);
+    /*! @returns The space an image takes up in a page, including its padding. */
+    [[nodiscard]] Size getPaddedSize(Size size);
+
+    /*!
+     * Copies an RGBA8 image into its place in an RGBA8 page, filling its padding with its edge texels.
+     * @param rect Where the image was placed, as returned by \ref pack() "pack()".
+     */
+    void copyWithPadding(std::span<unsigned char> page, int pageWidth, const Rect& rect, std::span<const unsigned char> rgba);
+}
@@ -0,0 +1,443 @@
+#include "block_compression.h"
+
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace BlockCompression {
+    TextureUsage guessTextureUsage(const std::string_view filePath) {
+        std::string_view stem = filePath.substr(filePath.find_last_of("/\\") + 1);
+        stem = stem.substr(0, stem.find_last_of('.'));
+        std::string lowerStem(stem);
+        for (char& c : lowerStem)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+        for (const std::string_view suffix : {"_normal", "_nrm", "_n"})
+            if (lowerStem.ends_with(suffix))
+                return TextureUsage::NORMAL;
+        for (const std::string_view suffix : {"_specular", "_spec", "_roughness", "_metallic", "_ao"})
+            if (lowerStem.ends_with(suffix))
+                return TextureUsage::SPECULAR;
+        return TextureUsage::ALBEDO;
+    }
+
+    /*! Writes bit fields least significant bit first, as all BC formats are laid out. */
+    class BitWriter {
+    public:
+        explicit BitWriter(unsigned char* output) : output(output) {}
+        void write(const uint32_t value, const int bitCount) {
+            for (int bit = 0; bit < bitCount; bit++, position++)
+                if ((value >> bit) & 1)
+                    output[position / 8] |= static_cast<unsigned char>(1 << (position % 8));
+        }
+    private:
+        unsigned char* output;
+        int position = 0;
+    };
+
+#pragma region BC1/BC3
+    uint16_t toRGB565(const std::array<int, 3>& color) {
+        return static_cast<uint16_t>((color[0] >> 3) << 11 | (color[1] >> 2) << 5 | color[2] >> 3);
+    }
+    std::array<int, 3> fromRGB565(const uint16_t color) {
+        const int r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+        return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+    }
+
+#ifdef BLOCK_COMPRESSION_SSE2
+    /*! Picks the closest of the 4 palette colours for every pixel, by the sum of absolute RGB differences. */
+    uint32_t findBC1Indices(const unsigned char* rgba, const std::array<std::array<int, 3>, 4>& palette) {
+        const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+        const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i paletteColors[4];
+        for (int i = 0; i < 4; i++)
+            paletteColors[i] = _mm_set1_epi32(palette[i][0] | palette[i][1] << 8 | palette[i][2] << 16);
+
+        uint32_t indices = 0;
+        for (int row = 0; row < 4; row++) {
+            const __m128i pixels = _mm_and_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + row * 16)), colorMask);
+            __m128i bestDistance = _mm_set1_epi32(INT32_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int i = 0; i < 4; i++) {
+                const __m128i difference = _mm_or_si128(
+                    _mm_subs_epu8(pixels, paletteColors[i]), _mm_subs_epu8(paletteColors[i], pixels));
+                // Sum the bytes of each pixel: pairs of bytes into 16 bits, then pairs of those into 32 bits
+                const __m128i pairs = _mm_add_epi16(_mm_and_si128(difference, lowBytes), _mm_srli_epi16(difference, 8));
+                const __m128i distance = _mm_madd_epi16(pairs, ones);
+                const __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+                bestDistance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance));
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(i)), _mm_andnot_si128(closer, bestIndex));
+            }
+            alignas(16) int32_t rowIndices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(rowIndices), bestIndex);
+            for (int x = 0; x < 4; x++)
+                indices |= static_cast<uint32_t>(rowIndices[x]) << (2 * (row * 4 + x));
+        }
+        return indices;
+    }
+#else
+    uint32_t findBC1Indices(const unsigned char* rgba, const std::array<std::array<int, 3>, 4>& palette) {
+        uint32_t indices = 0;
+        for (int pixel = 0; pixel < 16; pixel++) {
+            int bestDistance = INT32_MAX, bestIndex = 0;
+            for (int i = 0; i < 4; i++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                    distance += std::abs(rgba[pixel * 4 + c] - palette[i][c]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = i;
+                }
+            }
+            indices |= static_cast<uint32_t>(bestIndex) << (2 * pixel);
+        }
+        return indices;
+    }
+#endif
+
+    void encodeBC1Block(const unsigned char* rgba, unsigned char* output) {
+        std::array<int, 3> minColor{}, maxColor{};
+#ifdef BLOCK_COMPRESSION_SSE2
+        __m128i minPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba));
+        __m128i maxPixels = minPixels;
+        for (int row = 1; row < 4; row++) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + row * 16));
+            minPixels = _mm_min_epu8(minPixels, pixels);
+            maxPixels = _mm_max_epu8(maxPixels, pixels);
+        }
+        minPixels = _mm_min_epu8(minPixels, _mm_srli_si128(minPixels, 8));
+        minPixels = _mm_min_epu8(minPixels, _mm_srli_si128(minPixels, 4));
+        maxPixels = _mm_max_epu8(maxPixels, _mm_srli_si128(maxPixels, 8));
+        maxPixels = _mm_max_epu8(maxPixels, _mm_srli_si128(maxPixels, 4));
+        const auto minPacked = static_cast<uint32_t>(_mm_cvtsi128_si32(minPixels));
+        const auto maxPacked = static_cast<uint32_t>(_mm_cvtsi128_si32(maxPixels));
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = static_cast<int>(minPacked >> (8 * c) & 0xFF);
+            maxColor[c] = static_cast<int>(maxPacked >> (8 * c) & 0xFF);
+        }
+#else
+        minColor = {255, 255, 255};
+        for (int pixel = 0; pixel < 16; pixel++) {
+            for (int c = 0; c < 3; c++) {
+                minColor[c] = std::min<int>(minColor[c], rgba[pixel * 4 + c]);
+                maxColor[c] = std::max<int>(maxColor[c], rgba[pixel * 4 + c]);
+            }
+        }
+#endif
+        // Insetting the bounding box slightly lowers the average error of the interpolated colours
+        for (int c = 0; c < 3; c++) {
+            const int inset = (maxColor[c] - minColor[c]) >> 4;
+            minColor[c] += inset;
+            maxColor[c] -= inset;
+        }
+
+        // Every channel of the maximum is at least that of the minimum, so the first endpoint is never smaller.
+        // That selects the mode with two interpolated colours, rather than one and transparent black.
+        const uint16_t color0 = toRGB565(maxColor), color1 = toRGB565(minColor);
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            std::array<std::array<int, 3>, 4> palette{fromRGB565(color0), fromRGB565(color1)};
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            indices = findBC1Indices(rgba, palette);
+        }
+        output[0] = static_cast<unsigned char>(color0);
+        output[1] = static_cast<unsigned char>(color0 >> 8);
+        output[2] = static_cast<unsigned char>(color1);
+        output[3] = static_cast<unsigned char>(color1 >> 8);
+        for (int i = 0; i < 4; i++)
+            output[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+
+    void encodeBC3Block(const unsigned char* rgba, unsigned char* output) {
+        encodeBC4Block(rgba, output, 3);
+        encodeBC1Block(rgba, output + 8);
+    }
+#pragma endregion
+
+#pragma region BC4/BC5
+    /*!
+     * Rounds every value to the closest of 8 evenly spaced steps between the endpoints.
+     * Step 0 is the minimum and step 7 the maximum, with the endpoints themselves using indices 1 and 0.
+     */
+#ifdef BLOCK_COMPRESSION_SSE2
+    uint64_t findBC4Indices(const unsigned char* rgba, const int channel, const int minValue, const int range) {
+        // Gather the channel into 16 bytes
+        __m128i rows[4];
+        for (int row = 0; row < 4; row++) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + row * 16));
+            rows[row] = _mm_and_si128(_mm_srli_epi32(pixels, 8 * channel), _mm_set1_epi32(0xFF));
+        }
+        const __m128i values = _mm_subs_epu8(
+            _mm_packus_epi16(_mm_packs_epi32(rows[0], rows[1]), _mm_packs_epi32(rows[2], rows[3])),
+            _mm_set1_epi8(static_cast<char>(minValue)));
+
+        // A value is at least step k once it passes the halfway point between step k-1 and k
+        __m128i steps = _mm_setzero_si128();
+        for (int step = 1; step < 8; step++) {
+            const __m128i threshold = _mm_set1_epi8(static_cast<char>(((2 * step - 1) * range + 13) / 14));
+            const __m128i reached = _mm_cmpeq_epi8(_mm_max_epu8(values, threshold), values);
+            steps = _mm_sub_epi8(steps, reached);  // Subtracting -1 for every threshold reached
+        }
+        // (8 - step) & 7 is right for every step but the endpoints, which need their lowest bit flipped
+        const __m128i flipped = _mm_and_si128(_mm_sub_epi8(_mm_set1_epi8(8), steps), _mm_set1_epi8(7));
+        const __m128i isEndpoint = _mm_and_si128(_mm_cmplt_epi8(flipped, _mm_set1_epi8(2)), _mm_set1_epi8(1));
+        alignas(16) unsigned char pixelIndices[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(pixelIndices), _mm_xor_si128(flipped, isEndpoint));
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i++)
+            indices |= static_cast<uint64_t>(pixelIndices[i]) << (3 * i);
+        return indices;
+    }
+#else
+    uint64_t findBC4Indices(const unsigned char* rgba, const int channel, const int minValue, const int range) {
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i++) {
+            const int value = rgba[i * 4 + channel] - minValue;
+            const int step = (value * 14 + range) / (2 * range);
+            const uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (3 * i);
+        }
+        return indices;
+    }
+#endif
+
+    void encodeBC4Block(const unsigned char* rgba, unsigned char* output, const int channel) {
+        int minValue = 255, maxValue = 0;
+        for (int i = 0; i < 16; i++) {
+            minValue = std::min<int>(minValue, rgba[i * 4 + channel]);
+            maxValue = std::max<int>(maxValue, rgba[i * 4 + channel]);
+        }
+        // The first endpoint being larger selects the mode with 6 interpolated values rather than 4
+        output[0] = static_cast<unsigned char>(maxValue);
+        output[1] = static_cast<unsigned char>(minValue);
+
+        const uint64_t indices = maxValue > minValue ? findBC4Indices(rgba, channel, minValue, maxValue - minValue) : 0;
+        for (int i = 0; i < 6; i++)
+            output[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+
+    void encodeBC5Block(const unsigned char* rgba, unsigned char* output) {
+        encodeBC4Block(rgba, output, 0);
+        encodeBC4Block(rgba, output + 8, 1);
+    }
+#pragma endregion
+
+#pragma region BC7
+    constexpr std::array<int, 16> BC7_WEIGHTS = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct BC7Endpoint {
+        std::array<int, 4> quantized;  // 7 bits per channel
+        int pBit;                      // Shared lowest bit of every channel
+        [[nodiscard]] int expand(const int channel) const { return quantized[channel] << 1 | pBit; }
+    };
+
+    BC7Endpoint quantizeBC7Endpoint(const std::array<float, 4>& value) {
+        BC7Endpoint best{};
+        float bestError = INFINITY;
+        for (int pBit = 0; pBit < 2; pBit++) {
+            BC7Endpoint endpoint{{}, pBit};
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                endpoint.quantized[c] = std::clamp(static_cast<int>(std::lround((value[c] - pBit) / 2.0f)), 0, 127);
+                const float difference = static_cast<float>(endpoint.expand(c)) - value[c];
+                error += difference * difference;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = endpoint;
+            }
+        }
+        return best;
+    }
+
+    /*! Picks the closest palette entry for every pixel. @returns The total squared error. */
+    int findBC7Indices(const unsigned char* rgba, const BC7Endpoint& e0, const BC7Endpoint& e1,
+                       std::array<int, 16>& indices) {
+        std::array<std::array<int, 4>, 16> palette{};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++)
+                palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0.expand(c) + BC7_WEIGHTS[i] * e1.expand(c) + 32) >> 6;
+
+        int totalError = 0;
+        for (int pixel = 0; pixel < 16; pixel++) {
+            int bestError = INT32_MAX;
+            for (int i = 0; i < 16; i++) {
+                int error = 0;
+                for (int c = 0; c < 4; c++) {
+                    const int difference = palette[i][c] - rgba[pixel * 4 + c];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    indices[pixel] = i;
+                }
+            }
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    void encodeBC7Block(const unsigned char* rgba, unsigned char* output) {
+        // Initial endpoints from the extent of the block along its principal axis
+        std::array<float, 4> mean{};
+        for (int pixel = 0; pixel < 16; pixel++)
+            for (int c = 0; c < 4; c++)
+                mean[c] += rgba[pixel * 4 + c] / 16.0f;
+        std::array<std::array<float, 4>, 4> covariance{};
+        std::array<float, 4> minValue{255, 255, 255, 255}, maxValue{};
+        for (int pixel = 0; pixel < 16; pixel++) {
+            for (int a = 0; a < 4; a++) {
+                minValue[a] = std::min<float>(minValue[a], rgba[pixel * 4 + a]);
+                maxValue[a] = std::max<float>(maxValue[a], rgba[pixel * 4 + a]);
+                for (int b = 0; b < 4; b++)
+                    covariance[a][b] += (rgba[pixel * 4 + a] - mean[a]) * (rgba[pixel * 4 + b] - mean[b]);
+            }
+        }
+        std::array<float, 4> axis{};
+        for (int c = 0; c < 4; c++)
+            axis[c] = maxValue[c] - minValue[c];
+        for (int iteration = 0; iteration < 8; iteration++) {  // Power iteration
+            std::array<float, 4> next{};
+            for (int a = 0; a < 4; a++)
+                for (int b = 0; b < 4; b++)
+                    next[a] += covariance[a][b] * axis[b];
+            const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 4; c++)
+                axis[c] = next[c] / length;
+        }
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (int pixel = 0; pixel < 16; pixel++) {
+            float projection = 0.0f;
+            for (int c = 0; c < 4; c++)
+                projection += (rgba[pixel * 4 + c] - mean[c]) * axis[c];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        std::array<float, 4> start{}, end{};
+        for (int c = 0; c < 4; c++) {
+            start[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+            end[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+        }
+
+        BC7Endpoint e0 = quantizeBC7Endpoint(start), e1 = quantizeBC7Endpoint(end);
+        std::array<int, 16> indices{};
+        int error = findBC7Indices(rgba, e0, e1, indices);
+
+        // Refine the endpoints with a least squares fit to the chosen indices
+        for (int iteration = 0; iteration < 2 && error > 0; iteration++) {
+            float a = 0.0f, b = 0.0f, c = 0.0f;
+            std::array<float, 4> d0{}, d1{};
+            for (int pixel = 0; pixel < 16; pixel++) {
+                const float w = BC7_WEIGHTS[indices[pixel]] / 64.0f;
+                a += (1.0f - w) * (1.0f - w);
+                b += (1.0f - w) * w;
+                c += w * w;
+                for (int channel = 0; channel < 4; channel++) {
+                    d0[channel] += (1.0f - w) * rgba[pixel * 4 + channel];
+                    d1[channel] += w * rgba[pixel * 4 + channel];
+                }
+            }
+            const float determinant = a * c - b * b;
+            if (std::abs(determinant) < 1e-6f)
+                break;
+            for (int channel = 0; channel < 4; channel++) {
+                start[channel] = std::clamp((c * d0[channel] - b * d1[channel]) / determinant, 0.0f, 255.0f);
+                end[channel] = std::clamp((a * d1[channel] - b * d0[channel]) / determinant, 0.0f, 255.0f);
+            }
+            const BC7Endpoint refined0 = quantizeBC7Endpoint(start), refined1 = quantizeBC7Endpoint(end);
+            std::array<int, 16> refinedIndices{};
+            const int refinedError = findBC7Indices(rgba, refined0, refined1, refinedIndices);
+            if (refinedError >= error)
+                break;
+            e0 = refined0;
+            e1 = refined1;
+            indices = refinedIndices;
+            error = refinedError;
+        }
+
+        // The first index has an implicit 0 as its top bit, which can always be arranged by swapping the endpoints
+        if (indices[0] & 8) {
+            std::swap(e0, e1);
+            for (int& index : indices)
+                index = 15 - index;
+        }
+
+        std::memset(output, 0, 16);
+        BitWriter writer(output);
+        writer.write(1 << 6, 7);  // Mode 6
+        for (int c = 0; c < 4; c++) {
+            writer.write(e0.quantized[c], 7);
+            writer.write(e1.quantized[c], 7);
+        }
+        writer.write(e0.pBit, 1);
+        writer.write(e1.pBit, 1);
+        writer.write(indices[0], 3);
+        for (int pixel = 1; pixel < 16; pixel++)
+            writer.write(indices[pixel], 4);
+    }
+#pragma endregion
+
+    void compressImage(const BlockFormat format, const std::span<const unsigned char> rgba, const int width, const int height,
+                       const std::span<unsigned char> output) {
+        const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        const size_t blockBytes = getBlockBytes(format);
+        std::array<unsigned char, 16 * 4> block{};
+        for (int blockY = 0; blockY < blocksY; blockY++) {
+            for (int blockX = 0; blockX < blocksX; blockX++) {
+                for (int y = 0; y < 4; y++) {
+                    const int sourceY = std::min(blockY * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++) {
+                        const int sourceX = std::min(blockX * 4 + x, width - 1);
+                        std::memcpy(&block[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+                    }
+                }
+                unsigned char* blockOutput = &output[(static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes];
+                switch (format) {
+                    case BlockFormat::BC1: encodeBC1Block(block.data(), blockOutput); break;
+                    case BlockFormat::BC3: encodeBC3Block(block.data(), blockOutput); break;
+                    case BlockFormat::BC4: encodeBC4Block(block.data(), blockOutput); break;
+                    case BlockFormat::BC5: encodeBC5Block(block.data(), blockOutput); break;
+                    case BlockFormat::BC7: encodeBC7Block(block.data(), blockOutput); break;
+                }
+            }
+        }
+    }
+
+    std::vector<unsigned char> compressMipChain(const BlockFormat format, const std::span<const unsigned char> rgba,
+                                                const int width, const int height, const Mipmap::Options& options,
+                                                const Mipmap::ParallelFor& parallelFor) {
+        const std::vector<unsigned char> chain = Mipmap::generateChain(rgba, width, height, options, parallelFor);
+        const int levelCount = Mipmap::getLevelCount(width, height);
+        std::vector<unsigned char> compressed;
+        int levelWidth = width, levelHeight = height;
+        size_t chainOffset = 0;
+        for (int level = 0; level < levelCount; level++) {
+            const size_t offset = compressed.size();
+            compressed.resize(offset + getCompressedSize(format, levelWidth, levelHeight));
+            const std::span<const unsigned char> levelPixels = level == 0
+                ? rgba
+                : std::span(chain).subspan(chainOffset, static_cast<size_t>(levelWidth) * levelHeight * 4);
+            compressImage(format, levelPixels, levelWidth, levelHeight, std::span(compressed).subspan(offset));
+            if (level > 0)
+                chainOffset += levelPixels.size();
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+        return compressed;
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "engine/resources/mipmap.h"
+
+/*
+ * CPU encoders for GPU block compressed texture formats.
+ * Every format stores 4x4 pixel blocks in either 8 or 16 bytes.
+ *
+ * Shared between the engine and the texture cooker tool, so this header must stay free of engine dependencies.
+ */
+namespace BlockCompression {
+    enum class BlockFormat {
+        BC1,  // RGB, 4 bits per pixel
+        BC3,  // RGBA, 8 bits per pixel
+        BC4,  // One channel, 4 bits per pixel
+        BC5,  // Two channels, 8 bits per pixel
+        BC7,  // RGBA, 8 bits per pixel
+    };
+
+    /*! What a texture is used for, which decides the format it is compressed to. */
+    enum class TextureUsage {
+        ALBEDO,    // Colour, with or without alpha
+        NORMAL,    // Tangent space normal map, only X and Y are kept
+        SPECULAR,  // Single channel mask, read from the red channel
+    };
+
+    constexpr size_t getBlockBytes(const BlockFormat format) {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+    }
+    constexpr int getChannelCount(const BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return 3;
+            case BlockFormat::BC4: return 1;
+            case BlockFormat::BC5: return 2;
+            case BlockFormat::BC3:
+            case BlockFormat::BC7:
+            default: return 4;
+        }
+    }
+    /*! @returns The size in bytes of a single compressed image. Partial blocks at the edges are padded out. */
+    constexpr size_t getCompressedSize(const BlockFormat format, const int width, const int height) {
+        const size_t blocksX = (std::max(width, 1) + 3) / 4;
+        const size_t blocksY = (std::max(height, 1) + 3) / 4;
+        return blocksX * blocksY * getBlockBytes(format);
+    }
+    /*! The format used when cooking offline, where encoding time doesn't matter. */
+    constexpr BlockFormat getBlockFormat(const TextureUsage usage) {
+        switch (usage) {
+            case TextureUsage::NORMAL: return BlockFormat::BC5;
+            case TextureUsage::SPECULAR: return BlockFormat::BC4;
+            case TextureUsage::ALBEDO:
+            default: return BlockFormat::BC7;
+        }
+    }
+    /*! The format used when compressing at load time, limited to the formats with fast encoders. */
+    constexpr BlockFormat getFastBlockFormat(const TextureUsage usage, const bool hasAlpha) {
+        switch (usage) {
+            case TextureUsage::NORMAL: return BlockFormat::BC5;
+            case TextureUsage::SPECULAR: return BlockFormat::BC4;
+            case TextureUsage::ALBEDO:
+            default: return hasAlpha ? BlockFormat::BC3 : BlockFormat::BC1;
+        }
+    }
+    /*! The alpha test threshold of our lit shader, anything below it is cut out. */
+    constexpr float ALPHA_TEST_CUTOFF = 0.5f;
+    /*! How mip levels should be filtered for a texture, colour is sRGB encoded and may be alpha tested. */
+    constexpr Mipmap::Options getMipmapOptions(const TextureUsage usage) {
+        Mipmap::Options options;
+        options.srgb = usage == TextureUsage::ALBEDO;
+        options.normalMap = usage == TextureUsage::NORMAL;
+        options.alphaCutoff = usage == TextureUsage::ALBEDO ? ALPHA_TEST_CUTOFF : 0.0f;
+        return options;
+    }
+    /*!
+     * Guesses what a texture is used for from its file name, following the `<name>_<usage>.png` convention of our assets.
+     * @example `brick_normal.png` is a normal map, `brick_specular.png` a specular mask and `brick.png` an albedo texture.
+     */
+    TextureUsage guessTextureUsage(std::string_view filePath);
+
+    /*!
+     * Encodes a single block of 4x4 RGBA8 pixels, in row major order.
+     * @note BC1, BC3, BC4 and BC5 use SSE2 where available. They are fast enough to run at load time.
+     */
+    void encodeBC1Block(const unsigned char* rgba, unsigned char* output);
+    void encodeBC3Block(const unsigned char* rgba, unsigned char* output);
+    void encodeBC4Block(const unsigned char* rgba, unsigned char* output, int channel = 0);
+    void encodeBC5Block(const unsigned char* rgba, unsigned char* output);
+    /*! Uses mode 6 only, a single RGBA endpoint pair with 16 interpolation steps. */
+    void encodeBC7Block(const unsigned char* rgba, unsigned char* output);
+
+    /*!
+     * Compresses an entire RGBA8 image.
+     * @param output Must be at least \ref getCompressedSize() "getCompressedSize()" bytes.
+     * @note Dimensions don't have to be multiples of 4, edge pixels are repeated to fill partial blocks.
+     */
+    void compressImage(BlockFormat format, std::span<const unsigned char> rgba, int width, int height,
+                       std::span<unsigned char> output);
+    /*!
+     * Compresses an RGBA8 image along with a full chain of mip levels, see \ref Mipmap::generateChain() "generateChain()".
+     * Every level is filtered from the uncompressed level above it, never from compressed data.
+     * @return The compressed levels stored back to back, largest first.
+     */
+    std::vector<unsigned char> compressMipChain(BlockFormat format, std::span<const unsigned char> rgba, int width, int height,
+                                                const Mipmap::Options& options, const Mipmap::ParallelFor& parallelFor = {});
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+
+#include "engine/resources/block_compression.h"
+
+/*
+ * On-disk layout of a DirectDraw Surface file, as written by the texture cooker:
+ *   uint32_t magic ("DDS ")
+ *   Dds::Header
+ *   Dds::HeaderDX10        (only when the pixel format's fourCC is "DX10")
+ *   compressed mip levels  (largest first, tightly packed)
+ *
+ * Cubemaps store their faces one after another in OpenGL order, each face with all of its mip levels.
+ * The engine writes those uncompressed, as RGBA16F, for the environment maps it prefilters.
+ *
+ * Shared between the engine and the texture cooker tool, so this header must stay free of engine dependencies.
+ */
+namespace Dds {
+    constexpr uint32_t makeFourCC(const char a, const char b, const char c, const char d) {
+        return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+    }
+    constexpr uint32_t MAGIC = makeFourCC('D', 'D', 'S', ' ');
+    constexpr uint32_t FOURCC_DX10 = makeFourCC('D', 'X', '1', '0');
+    // Older tools write these instead of a DX10 header
+    constexpr uint32_t FOURCC_DXT1 = makeFourCC('D', 'X', 'T', '1');
+    constexpr uint32_t FOURCC_DXT5 = makeFourCC('D', 'X', 'T', '5');
+    constexpr uint32_t FOURCC_ATI1 = makeFourCC('A', 'T', 'I', '1');
+    constexpr uint32_t FOURCC_BC4U = makeFourCC('B', 'C', '4', 'U');
+    constexpr uint32_t FOURCC_ATI2 = makeFourCC('A', 'T', 'I', '2');
+    constexpr uint32_t FOURCC_BC5U = makeFourCC('B', 'C', '5', 'U');
+
+    constexpr uint32_t FLAG_CAPS = 0x1;
+    constexpr uint32_t FLAG_HEIGHT = 0x2;
+    constexpr uint32_t FLAG_WIDTH = 0x4;
+    constexpr uint32_t FLAG_PITCH = 0x8;
+    constexpr uint32_t FLAG_PIXELFORMAT = 0x1000;
+    constexpr uint32_t FLAG_MIPMAPCOUNT = 0x20000;
+    constexpr uint32_t FLAG_LINEARSIZE = 0x80000;
+    constexpr uint32_t PIXELFORMAT_FOURCC = 0x4;
+    constexpr uint32_t CAPS_COMPLEX = 0x8;
+    constexpr uint32_t CAPS_TEXTURE = 0x1000;
+    constexpr uint32_t CAPS_MIPMAP = 0x400000;
+    constexpr uint32_t CAPS2_CUBEMAP_ALL_FACES = 0xFE00;  // The cubemap flag and one flag per face
+    constexpr uint32_t DIMENSION_TEXTURE2D = 3;
+    constexpr uint32_t MISC_TEXTURECUBE = 0x4;
+
+    enum DxgiFormat : uint32_t {
+        DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+        DXGI_FORMAT_BC1_UNORM = 71,
+        DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+        DXGI_FORMAT_BC3_UNORM = 77,
+        DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+        DXGI_FORMAT_BC4_UNORM = 80,
+        DXGI_FORMAT_BC5_UNORM = 83,
+        DXGI_FORMAT_BC7_UNORM = 98,
+        DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+    };
+
+    struct PixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+    };
+    static_assert(sizeof(PixelFormat) == 32);
+
+    struct Header {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        PixelFormat pixelFormat;
+        uint32_t caps, caps2, caps3, caps4;
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(Header) == 124);
+
+    struct HeaderDX10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+    static_assert(sizeof(HeaderDX10) == 20);
+
+    constexpr DxgiFormat toDxgiFormat(const BlockCompression::BlockFormat format) {
+        switch (format) {
+            case BlockCompression::BlockFormat::BC1: return DXGI_FORMAT_BC1_UNORM;
+            case BlockCompression::BlockFormat::BC3: return DXGI_FORMAT_BC3_UNORM;
+            case BlockCompression::BlockFormat::BC4: return DXGI_FORMAT_BC4_UNORM;
+            case BlockCompression::BlockFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+            case BlockCompression::BlockFormat::BC7:
+            default: return DXGI_FORMAT_BC7_UNORM;
+        }
+    }
+    constexpr std::optional<BlockCompression::BlockFormat> fromDxgiFormat(const uint32_t format) {
+        switch (format) {
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB: return BlockCompression::BlockFormat::BC1;
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB: return BlockCompression::BlockFormat::BC3;
+            case DXGI_FORMAT_BC4_UNORM: return BlockCompression::BlockFormat::BC4;
+            case DXGI_FORMAT_BC5_UNORM: return BlockCompression::BlockFormat::BC5;
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB: return BlockCompression::BlockFormat::BC7;
+            default: return std::nullopt;
+        }
+    }
+    constexpr std::optional<BlockCompression::BlockFormat> fromFourCC(const uint32_t fourCC) {
+        switch (fourCC) {
+            case FOURCC_DXT1: return BlockCompression::BlockFormat::BC1;
+            case FOURCC_DXT5: return BlockCompression::BlockFormat::BC3;
+            case FOURCC_ATI1: case FOURCC_BC4U: return BlockCompression::BlockFormat::BC4;
+            case FOURCC_ATI2: case FOURCC_BC5U: return BlockCompression::BlockFormat::BC5;
+            default: return std::nullopt;
+        }
+    }
+
+    /*!
+     * Writes a complete DDS file for a block compressed 2D texture.
+     * @param data Every mip level stored back to back, largest first.
+     * @return Whether everything was written successfully.
+     */
+    inline bool writeFile(std::ostream& out, const BlockCompression::BlockFormat format, const int width, const int height,
+                          const int levelCount, const std::span<const unsigned char> data) {
+        Header header{};
+        header.size = sizeof(Header);
+        header.flags = FLAG_CAPS | FLAG_HEIGHT | FLAG_WIDTH | FLAG_PIXELFORMAT | FLAG_MIPMAPCOUNT | FLAG_LINEARSIZE;
+        header.height = static_cast<uint32_t>(height);
+        header.width = static_cast<uint32_t>(width);
+        header.pitchOrLinearSize = static_cast<uint32_t>(BlockCompression::getCompressedSize(format, width, height));
+        header.mipMapCount = static_cast<uint32_t>(levelCount);
+        header.pixelFormat.size = sizeof(PixelFormat);
+        header.pixelFormat.flags = PIXELFORMAT_FOURCC;
+        header.pixelFormat.fourCC = FOURCC_DX10;
+        header.caps = CAPS_TEXTURE | CAPS_MIPMAP | CAPS_COMPLEX;
+        HeaderDX10 headerDX10{};
+        headerDX10.dxgiFormat = toDxgiFormat(format);
+        headerDX10.resourceDimension = DIMENSION_TEXTURE2D;
+        headerDX10.arraySize = 1;
+
+        out.write(reinterpret_cast<const char*>(&MAGIC), sizeof(MAGIC));
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(out);
+    }
+
+    /*!
+     * Writes a complete DDS file for an RGBA16F cubemap.
+     * @param texels The half float texels of every face, each face with its mip levels back to back, largest first.
+     * @return Whether everything was written successfully.
+     */
+    inline bool writeHalfCubemapFile(std::ostream& out, const int faceSize, const int levelCount,
+                                     const std::span<const uint16_t> texels) {
+        Header header{};
+        header.size = sizeof(Header);
+        header.flags = FLAG_CAPS | FLAG_HEIGHT | FLAG_WIDTH | FLAG_PIXELFORMAT | FLAG_MIPMAPCOUNT | FLAG_PITCH;
+        header.height = static_cast<uint32_t>(faceSize);
+        header.width = static_cast<uint32_t>(faceSize);
+        header.pitchOrLinearSize = static_cast<uint32_t>(faceSize) * 4 * sizeof(uint16_t);
+        header.mipMapCount = static_cast<uint32_t>(levelCount);
+        header.pixelFormat.size = sizeof(PixelFormat);
+        header.pixelFormat.flags = PIXELFORMAT_FOURCC;
+        header.pixelFormat.fourCC = FOURCC_DX10;
+        header.caps = CAPS_TEXTURE | CAPS_MIPMAP | CAPS_COMPLEX;
+        header.caps2 = CAPS2_CUBEMAP_ALL_FACES;
+        HeaderDX10 headerDX10{};
+        headerDX10.dxgiFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        headerDX10.resourceDimension = DIMENSION_TEXTURE2D;
+        headerDX10.miscFlag = MISC_TEXTURECUBE;
+        headerDX10.arraySize = 1;
+
+        out.write(reinterpret_cast<const char*>(&MAGIC), sizeof(MAGIC));
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+        out.write(reinterpret_cast<const char*>(texels.data()), static_cast<std::streamsize>(texels.size_bytes()));
+        return static_cast<bool>(out);
+    }
+}
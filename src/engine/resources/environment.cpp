@@ -0,0 +1,414 @@
+#include "environment.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ENVIRONMENT_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace Environment {
+    constexpr int ROWS_PER_TASK = 16;
+    constexpr int SPECULAR_SAMPLE_COUNT = 64;
+    // Irradiance is so smooth that projecting a small level loses nothing
+    constexpr int IRRADIANCE_SOURCE_SIZE = 64;
+
+    size_t Cubemap::getFaceStride() const {
+        size_t stride = 0;
+        for (int level = 0; level < levelCount; level++) {
+            const size_t size = std::max(faceSize >> level, 1);
+            stride += size * size * 4;
+        }
+        return stride;
+    }
+
+    size_t Cubemap::getOffset(const int face, const int level) const {
+        size_t offset = static_cast<size_t>(face) * getFaceStride();
+        for (int i = 0; i < level; i++) {
+            const size_t size = std::max(faceSize >> i, 1);
+            offset += size * size * 4;
+        }
+        return offset;
+    }
+
+    int getFaceSize(const int equirectangularWidth) {
+        // A quarter of the width covers the same angle as a face
+        return std::clamp(static_cast<int>(std::bit_floor(static_cast<unsigned int>(std::max(equirectangularWidth / 4, 1)))),
+            1, MAX_FACE_SIZE);
+    }
+
+#pragma region Texels
+#ifdef ENVIRONMENT_SSE
+    using Texel = __m128;
+    Texel loadTexel(const float* texel) { return _mm_loadu_ps(texel); }
+    void storeTexel(float* texel, const Texel value) { _mm_storeu_ps(texel, value); }
+    Texel zeroTexel() { return _mm_setzero_ps(); }
+    Texel add(const Texel a, const Texel b) { return _mm_add_ps(a, b); }
+    Texel scale(const Texel a, const float factor) { return _mm_mul_ps(a, _mm_set1_ps(factor)); }
+    Texel lerp(const Texel a, const Texel b, const float t) {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+    }
+#else
+    struct Texel {
+        std::array<float, 4> channels;
+    };
+    Texel loadTexel(const float* texel) { return {{texel[0], texel[1], texel[2], texel[3]}}; }
+    void storeTexel(float* texel, const Texel value) { std::copy_n(value.channels.data(), 4, texel); }
+    Texel zeroTexel() { return {}; }
+    Texel add(const Texel a, const Texel b) {
+        return {{a.channels[0] + b.channels[0], a.channels[1] + b.channels[1], a.channels[2] + b.channels[2], a.channels[3] + b.channels[3]}};
+    }
+    Texel scale(const Texel a, const float factor) {
+        return {{a.channels[0] * factor, a.channels[1] * factor, a.channels[2] * factor, a.channels[3] * factor}};
+    }
+    Texel lerp(const Texel a, const Texel b, const float t) {
+        return add(a, scale(add(b, scale(a, -1.0f)), t));
+    }
+#endif
+
+    struct Direction {
+        float x, y, z;
+    };
+    Direction normalize(const Direction d) {
+        const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+        return {d.x / length, d.y / length, d.z / length};
+    }
+    Direction cross(const Direction a, const Direction b) {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    /*! @returns The direction through a point on a face, with `s` and `t` between -1 and 1. */
+    Direction getDirection(const int face, const float s, const float t) {
+        switch (face) {
+            case 0: return normalize({1.0f, -t, -s});
+            case 1: return normalize({-1.0f, -t, s});
+            case 2: return normalize({s, 1.0f, t});
+            case 3: return normalize({s, -1.0f, -t});
+            case 4: return normalize({s, -t, 1.0f});
+            default: return normalize({-s, -t, -1.0f});
+        }
+    }
+    /*! @returns The direction through the centre of a texel. */
+    Direction getTexelDirection(const int face, const int x, const int y, const int size) {
+        return getDirection(face, (static_cast<float>(x) + 0.5f) / static_cast<float>(size) * 2.0f - 1.0f,
+            (static_cast<float>(y) + 0.5f) / static_cast<float>(size) * 2.0f - 1.0f);
+    }
+
+    struct FacePoint {
+        int face;
+        float s, t;  // Between 0 and 1
+    };
+    /*! The inverse of \ref getDirection(), selecting the face the same way the GPU does. */
+    FacePoint getFacePoint(const Direction d) {
+        const float ax = std::abs(d.x), ay = std::abs(d.y), az = std::abs(d.z);
+        int face;
+        float major, sc, tc;
+        if (ax >= ay && ax >= az) {
+            face = d.x > 0.0f ? 0 : 1;
+            major = ax;
+            sc = d.x > 0.0f ? -d.z : d.z;
+            tc = -d.y;
+        } else if (ay >= az) {
+            face = d.y > 0.0f ? 2 : 3;
+            major = ay;
+            sc = d.x;
+            tc = d.y > 0.0f ? d.z : -d.z;
+        } else {
+            face = d.z > 0.0f ? 4 : 5;
+            major = az;
+            sc = d.z > 0.0f ? d.x : -d.x;
+            tc = -d.y;
+        }
+        return {face, (sc / major + 1.0f) * 0.5f, (tc / major + 1.0f) * 0.5f};
+    }
+
+    /*! Bilinearly samples one level of a face, clamping at its edges. */
+    Texel sampleLevel(const float* level, const int size, const float s, const float t) {
+        const float x = s * static_cast<float>(size) - 0.5f, y = t * static_cast<float>(size) - 0.5f;
+        const float fx = std::floor(x), fy = std::floor(y);
+        const int x0 = std::clamp(static_cast<int>(fx), 0, size - 1), x1 = std::clamp(static_cast<int>(fx) + 1, 0, size - 1);
+        const int y0 = std::clamp(static_cast<int>(fy), 0, size - 1), y1 = std::clamp(static_cast<int>(fy) + 1, 0, size - 1);
+        const auto texel = [&](const int tx, const int ty) {
+            return loadTexel(level + (static_cast<size_t>(ty) * size + tx) * 4);
+        };
+        return lerp(lerp(texel(x0, y0), texel(x1, y0), x - fx), lerp(texel(x0, y1), texel(x1, y1), x - fx), y - fy);
+    }
+    /*! Trilinearly samples a cubemap in a direction. Doesn't filter across face edges. */
+    Texel sampleCubemap(const Cubemap& cubemap, const Direction direction, const float lod) {
+        const FacePoint point = getFacePoint(direction);
+        const float clampedLod = std::clamp(lod, 0.0f, static_cast<float>(cubemap.levelCount - 1));
+        const int level = static_cast<int>(clampedLod);
+        const int nextLevel = std::min(level + 1, cubemap.levelCount - 1);
+        const auto sample = [&](const int l) {
+            return sampleLevel(cubemap.texels.data() + cubemap.getOffset(point.face, l),
+                std::max(cubemap.faceSize >> l, 1), point.s, point.t);
+        };
+        const Texel upper = sample(level);
+        return level == nextLevel ? upper : lerp(upper, sample(nextLevel), clampedLod - static_cast<float>(level));
+    }
+
+    /*! @returns The bits of `index` mirrored around the binary point, the second coordinate of a Hammersley point. */
+    double radicalInverse(uint32_t index) {
+        index = (index << 16) | (index >> 16);
+        index = ((index & 0x55555555u) << 1) | ((index & 0xAAAAAAAAu) >> 1);
+        index = ((index & 0x33333333u) << 2) | ((index & 0xCCCCCCCCu) >> 2);
+        index = ((index & 0x0F0F0F0Fu) << 4) | ((index & 0xF0F0F0F0u) >> 4);
+        index = ((index & 0x00FF00FFu) << 8) | ((index & 0xFF00FF00u) >> 8);
+        return static_cast<double>(index) / 4294967296.0;
+    }
+
+    /*! Runs `body(face, firstRow, lastRow)` over bands of rows of every face of a level. */
+    template<typename F>
+    void forEachRowBand(const int size, const Mipmap::ParallelFor& parallelFor, F&& body) {
+        const size_t bandsPerFace = (size + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        const auto runBand = [&](const size_t task) {
+            const int face = static_cast<int>(task / bandsPerFace);
+            const int firstRow = static_cast<int>(task % bandsPerFace) * ROWS_PER_TASK;
+            body(face, firstRow, std::min(firstRow + ROWS_PER_TASK, size));
+        };
+        if (parallelFor)
+            parallelFor(bandsPerFace * 6, runBand);
+        else
+            for (size_t task = 0; task < bandsPerFace * 6; task++)
+                runBand(task);
+    }
+#pragma endregion
+
+    Cubemap fromEquirectangular(const std::span<const float> rgba, const int width, const int height, const int faceSize,
+                                const Mipmap::ParallelFor& parallelFor) {
+        Cubemap cubemap;
+        cubemap.faceSize = faceSize;
+        cubemap.levelCount = Mipmap::getLevelCount(faceSize, faceSize);
+        cubemap.texels.resize(cubemap.getFaceStride() * 6);
+
+        forEachRowBand(faceSize, parallelFor, [&](const int face, const int firstRow, const int lastRow) {
+            float* out = cubemap.texels.data() + cubemap.getOffset(face, 0);
+            for (int y = firstRow; y < lastRow; y++) {
+                for (int x = 0; x < faceSize; x++) {
+                    const Direction d = getTexelDirection(face, x, y, faceSize);
+                    // Longitude wraps around, latitude is clamped at the poles
+                    const float u = std::atan2(d.z, d.x) / (2.0f * std::numbers::pi_v<float>) + 0.5f;
+                    const float v = std::acos(std::clamp(d.y, -1.0f, 1.0f)) / std::numbers::pi_v<float>;
+                    const float sx = u * static_cast<float>(width) - 0.5f, sy = v * static_cast<float>(height) - 0.5f;
+                    const float fx = std::floor(sx), fy = std::floor(sy);
+                    const int x0 = (static_cast<int>(fx) % width + width) % width, x1 = (x0 + 1) % width;
+                    const int y0 = std::clamp(static_cast<int>(fy), 0, height - 1), y1 = std::clamp(static_cast<int>(fy) + 1, 0, height - 1);
+                    const auto texel = [&](const int tx, const int ty) {
+                        return loadTexel(rgba.data() + (static_cast<size_t>(ty) * width + tx) * 4);
+                    };
+                    storeTexel(out + (static_cast<size_t>(y) * faceSize + x) * 4,
+                        lerp(lerp(texel(x0, y0), texel(x1, y0), sx - fx), lerp(texel(x0, y1), texel(x1, y1), sx - fx), sy - fy));
+                }
+            }
+        });
+
+        for (int level = 1; level < cubemap.levelCount; level++) {
+            const int size = std::max(faceSize >> level, 1), sourceSize = std::max(faceSize >> (level - 1), 1);
+            forEachRowBand(size, parallelFor, [&](const int face, const int firstRow, const int lastRow) {
+                const float* source = cubemap.texels.data() + cubemap.getOffset(face, level - 1);
+                float* out = cubemap.texels.data() + cubemap.getOffset(face, level);
+                for (int y = firstRow; y < lastRow; y++) {
+                    for (int x = 0; x < size; x++) {
+                        const auto texel = [&](const int tx, const int ty) {
+                            return loadTexel(source + (static_cast<size_t>(std::min(ty, sourceSize - 1)) * sourceSize
+                                + std::min(tx, sourceSize - 1)) * 4);
+                        };
+                        const Texel sum = add(add(texel(x * 2, y * 2), texel(x * 2 + 1, y * 2)),
+                            add(texel(x * 2, y * 2 + 1), texel(x * 2 + 1, y * 2 + 1)));
+                        storeTexel(out + (static_cast<size_t>(y) * size + x) * 4, scale(sum, 0.25f));
+                    }
+                }
+            });
+        }
+        return cubemap;
+    }
+
+    Cubemap prefilterSpecular(const Cubemap& radiance, const int levelCount, const Mipmap::ParallelFor& parallelFor) {
+        Cubemap cubemap;
+        cubemap.faceSize = radiance.faceSize;
+        cubemap.levelCount = std::min(levelCount, Mipmap::getLevelCount(radiance.faceSize, radiance.faceSize));
+        cubemap.texels.resize(cubemap.getFaceStride() * 6);
+        for (int face = 0; face < 6; face++)
+            std::copy_n(radiance.texels.begin() + static_cast<std::ptrdiff_t>(radiance.getOffset(face, 0)),
+                static_cast<size_t>(radiance.faceSize) * radiance.faceSize * 4,
+                cubemap.texels.begin() + static_cast<std::ptrdiff_t>(cubemap.getOffset(face, 0)));
+
+        // Filtered importance sampling reads each sample from the level whose texels cover about as much of the sphere as it does
+        const float texelSolidAngle = 4.0f * std::numbers::pi_v<float>
+            / (6.0f * static_cast<float>(radiance.faceSize) * static_cast<float>(radiance.faceSize));
+        for (int level = 1; level < cubemap.levelCount; level++) {
+            const float roughness = static_cast<float>(level) / static_cast<float>(cubemap.levelCount - 1);
+            const float alpha2 = roughness * roughness * roughness * roughness;
+
+            // With the view along the normal every texel uses the same samples, only rotated into its own frame
+            struct Sample {
+                Direction direction;  // Tangent space, the normal is +Z
+                float weight;
+                float lod;
+            };
+            std::vector<Sample> samples;
+            samples.reserve(SPECULAR_SAMPLE_COUNT);
+            for (uint32_t i = 0; i < SPECULAR_SAMPLE_COUNT; i++) {
+                // Hammersley point set
+                const float u = static_cast<float>(i) / SPECULAR_SAMPLE_COUNT;
+                const float v = static_cast<float>(radicalInverse(i));
+                const float phi = 2.0f * std::numbers::pi_v<float> * u;
+                const float cosTheta = std::sqrt((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+                const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                // Reflect the view, which is the normal, about the sampled half vector
+                const Direction direction{
+                    2.0f * cosTheta * sinTheta * std::cos(phi),
+                    2.0f * cosTheta * sinTheta * std::sin(phi),
+                    2.0f * cosTheta * cosTheta - 1.0f,
+                };
+                if (direction.z <= 0.0f)
+                    continue;
+                const float denominator = (alpha2 - 1.0f) * cosTheta * cosTheta + 1.0f;
+                const float distribution = alpha2 / (std::numbers::pi_v<float> * denominator * denominator);
+                const float sampleSolidAngle = 1.0f / (SPECULAR_SAMPLE_COUNT * distribution * 0.25f);
+                samples.push_back({direction, direction.z, std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f)});
+            }
+
+            const int size = std::max(cubemap.faceSize >> level, 1);
+            forEachRowBand(size, parallelFor, [&](const int face, const int firstRow, const int lastRow) {
+                float* out = cubemap.texels.data() + cubemap.getOffset(face, level);
+                for (int y = firstRow; y < lastRow; y++) {
+                    for (int x = 0; x < size; x++) {
+                        const Direction normal = getTexelDirection(face, x, y, size);
+                        const Direction up = std::abs(normal.z) < 0.999f ? Direction{0.0f, 0.0f, 1.0f} : Direction{1.0f, 0.0f, 0.0f};
+                        const Direction tangent = normalize(cross(up, normal));
+                        const Direction bitangent = cross(normal, tangent);
+
+                        Texel sum = zeroTexel();
+                        float totalWeight = 0.0f;
+                        for (const Sample& sample : samples) {
+                            const Direction& d = sample.direction;
+                            const Direction direction{
+                                tangent.x * d.x + bitangent.x * d.y + normal.x * d.z,
+                                tangent.y * d.x + bitangent.y * d.y + normal.y * d.z,
+                                tangent.z * d.x + bitangent.z * d.y + normal.z * d.z,
+                            };
+                            sum = add(sum, scale(sampleCubemap(radiance, direction, sample.lod), sample.weight));
+                            totalWeight += sample.weight;
+                        }
+                        storeTexel(out + (static_cast<size_t>(y) * size + x) * 4, scale(sum, 1.0f / totalWeight));
+                    }
+                }
+            });
+        }
+        return cubemap;
+    }
+
+    Cubemap convolveIrradiance(const Cubemap& radiance, const int faceSize, const Mipmap::ParallelFor& parallelFor) {
+        int sourceLevel = 0;
+        while (sourceLevel + 1 < radiance.levelCount && (radiance.faceSize >> sourceLevel) > IRRADIANCE_SOURCE_SIZE)
+            sourceLevel++;
+        const int sourceSize = std::max(radiance.faceSize >> sourceLevel, 1);
+
+        // Projection onto the first 9 real spherical harmonics, weighting each texel by the solid angle it covers
+        using Coefficients = std::array<std::array<double, 3>, 9>;
+        const auto getBasis = [](const Direction d) -> std::array<float, 9> {
+            return {
+                0.282095f,
+                0.488603f * d.y, 0.488603f * d.z, 0.488603f * d.x,
+                1.092548f * d.x * d.y, 1.092548f * d.y * d.z, 0.315392f * (3.0f * d.z * d.z - 1.0f),
+                1.092548f * d.x * d.z, 0.546274f * (d.x * d.x - d.y * d.y),
+            };
+        };
+        std::array<Coefficients, 6> faceCoefficients{};
+        const auto projectFace = [&](const size_t face) {
+            const float* source = radiance.texels.data() + radiance.getOffset(static_cast<int>(face), sourceLevel);
+            const float texelSize = 2.0f / static_cast<float>(sourceSize);
+            for (int y = 0; y < sourceSize; y++) {
+                for (int x = 0; x < sourceSize; x++) {
+                    const float s = (static_cast<float>(x) + 0.5f) * texelSize - 1.0f;
+                    const float t = (static_cast<float>(y) + 0.5f) * texelSize - 1.0f;
+                    const float solidAngle = texelSize * texelSize / std::pow(1.0f + s * s + t * t, 1.5f);
+                    const std::array<float, 9> basis = getBasis(getDirection(static_cast<int>(face), s, t));
+                    const float* texel = source + (static_cast<size_t>(y) * sourceSize + x) * 4;
+                    for (size_t i = 0; i < 9; i++)
+                        for (size_t c = 0; c < 3; c++)
+                            faceCoefficients[face][i][c] += static_cast<double>(texel[c] * basis[i] * solidAngle);
+                }
+            }
+        };
+        if (parallelFor)
+            parallelFor(6, projectFace);
+        else
+            for (size_t face = 0; face < 6; face++)
+                projectFace(face);
+
+        // Convolving with the clamped cosine only scales each band, see Ramamoorthi and Hanrahan 2001.
+        // Dividing by pi afterwards leaves 1, 2/3 and 1/4
+        constexpr std::array<float, 9> bandScales{1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+        std::array<std::array<float, 3>, 9> coefficients{};
+        for (size_t i = 0; i < 9; i++)
+            for (size_t c = 0; c < 3; c++) {
+                double sum = 0.0;
+                for (const Coefficients& face : faceCoefficients)
+                    sum += face[i][c];
+                coefficients[i][c] = static_cast<float>(sum) * bandScales[i];
+            }
+
+        Cubemap cubemap;
+        cubemap.faceSize = faceSize;
+        cubemap.texels.resize(cubemap.getFaceStride() * 6);
+        forEachRowBand(faceSize, parallelFor, [&](const int face, const int firstRow, const int lastRow) {
+            float* out = cubemap.texels.data() + cubemap.getOffset(face, 0);
+            for (int y = firstRow; y < lastRow; y++) {
+                for (int x = 0; x < faceSize; x++) {
+                    const std::array<float, 9> basis = getBasis(getTexelDirection(face, x, y, faceSize));
+                    float* texel = out + (static_cast<size_t>(y) * faceSize + x) * 4;
+                    for (size_t c = 0; c < 3; c++) {
+                        float irradiance = 0.0f;
+                        for (size_t i = 0; i < 9; i++)
+                            irradiance += coefficients[i][c] * basis[i];
+                        // Ringing can dip below zero opposite very bright lights
+                        texel[c] = std::max(irradiance, 0.0f);
+                    }
+                    texel[3] = 1.0f;
+                }
+            }
+        });
+        return cubemap;
+    }
+
+    uint16_t toHalf(const float value) {
+        const uint32_t bits = std::bit_cast<uint32_t>(value);
+        const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        const uint32_t magnitude = bits & 0x7fffffff;
+        if (magnitude > 0x7f800000)
+            return sign | 0x7e00;  // NaN
+        if (magnitude >= 0x477ff000)
+            return sign | 0x7bff;  // Rounds to beyond 65504, the largest half
+        if (magnitude < 0x33000000)
+            return sign;  // Rounds to zero
+
+        const uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa, shift;
+        if (exponent < 113) {
+            // Subnormal half, the implicit leading one becomes explicit
+            mantissa = (magnitude & 0x7fffff) | 0x800000;
+            shift = 126 - exponent;
+        } else {
+            mantissa = ((exponent - 112) << 23) | (magnitude & 0x7fffff);
+            shift = 13;
+        }
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        // Round to nearest even, a carry out of the mantissa correctly bumps the exponent
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    std::vector<uint16_t> toHalf(const std::span<const float> values) {
+        std::vector<uint16_t> halves(values.size());
+        std::ranges::transform(values, halves.begin(), [](const float value) { return toHalf(value); });
+        return halves;
+    }
+}
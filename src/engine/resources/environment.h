@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "engine/resources/mipmap.h"
+
+/*
+ * Conversion of equirectangular HDR images into cubemaps prefiltered for image based lighting.
+ *
+ * Cubemap faces follow the OpenGL order and orientation (+X, -X, +Y, -Y, +Z, -Z, first row at the top).
+ * Everything runs on the CPU, split over a ParallelFor, and is slow enough that the results should be cached.
+ *
+ * Kept free of engine dependencies, like the mip chain generation it builds on.
+ */
+namespace Environment {
+    /*! Level 0 of the specular cubemap is the unfiltered radiance, and the last level is fully rough. */
+    constexpr int SPECULAR_LEVEL_COUNT = 6;
+    constexpr int IRRADIANCE_FACE_SIZE = 32;
+    constexpr int MAX_FACE_SIZE = 1024;
+
+    /*! A cubemap of linear RGBA floats. */
+    struct Cubemap {
+        int faceSize = 0;
+        int levelCount = 1;
+        /*! Face by face, each face with its levels back to back, largest first. The order DDS files store them in. */
+        std::vector<float> texels;
+
+        /*! @returns The index in `texels` of the first texel of a level of a face. */
+        [[nodiscard]] size_t getOffset(int face, int level) const;
+        /*! @returns The number of floats taken up by one face with all of its levels. */
+        [[nodiscard]] size_t getFaceStride() const;
+    };
+
+    /*! @returns A face size that keeps about as much detail as an equirectangular image this wide has. */
+    int getFaceSize(int equirectangularWidth);
+    /*!
+     * Projects an equirectangular RGBA float image onto the faces of a cubemap, and box filters a full mip chain below them.
+     * @details The centre of the image faces +X, and its top row is straight up.
+     */
+    Cubemap fromEquirectangular(std::span<const float> rgba, int width, int height, int faceSize,
+                                const Mipmap::ParallelFor& parallelFor = {});
+    /*!
+     * Convolves every level below the first with a GGX lobe of increasing roughness, for the split sum approximation.
+     * @details Uses filtered importance sampling, reading from smaller levels of the source for wider lobes,
+     *          so few samples are needed without any of them aliasing.
+     * @param radiance A cubemap with a full mip chain, as made by \ref fromEquirectangular() "fromEquirectangular()".
+     * @return A cubemap of the same size, with `levelCount` levels. Level `i` has a roughness of `i / (levelCount - 1)`.
+     */
+    Cubemap prefilterSpecular(const Cubemap& radiance, int levelCount = SPECULAR_LEVEL_COUNT,
+                              const Mipmap::ParallelFor& parallelFor = {});
+    /*!
+     * Computes the diffuse irradiance in every direction, through a 9 coefficient spherical harmonics projection.
+     * @return A single level cubemap of the irradiance divided by pi, ready to be multiplied by the albedo.
+     */
+    Cubemap convolveIrradiance(const Cubemap& radiance, int faceSize = IRRADIANCE_FACE_SIZE,
+                               const Mipmap::ParallelFor& parallelFor = {});
+
+    /*! Converts to half floats, rounding to nearest and clamping to the largest finite half. */
+    std::vector<uint16_t> toHalf(std::span<const float> values);
+}
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <glm/vec4.hpp>
+
 #include "shader.h"
 #include "texture.h"
 
 namespace Resource
 {
+    /*! Index of a material in its scene's material table, so meshes with the same material can be told apart by an integer compare. */
+    using MaterialID = uint32_t;
+    constexpr MaterialID NO_MATERIAL = ~0u;
+
     /*! A fairly light wrapper around a shader containing PBR material data to pass to it. */
     struct PBRMaterial {
         std::shared_ptr<Shader> shader;
@@ -15,5 +23,14 @@ namespace Resource
         std::shared_ptr<ManagedTexture> roughness{};
         std::shared_ptr<ManagedTexture> metallic{};
         std::shared_ptr<ManagedTexture> ambientOcclusion{};
+
+        /*! Scale in xy and offset in zw applied to texture coordinates, placing the textures within a shared atlas. */
+        glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+        static constexpr size_t TEXTURE_SLOT_COUNT = 5;
+        /*! @returns Every texture slot in declaration order, for code that treats them all the same. */
+        [[nodiscard]] std::array<std::shared_ptr<ManagedTexture>*, TEXTURE_SLOT_COUNT> getTextureSlots() {
+            return {&albedo, &normal, &roughness, &metallic, &ambientOcclusion};
+        }
     };
 }
@@ -1,118 +1,217 @@
 #include "mesh.h"
 
+#include <cmath>
+#include <limits>
+
 #include <engine/state.h>
 #include <engine/resources/resource_manager.h>
+#include <engine/util/hash.h>
 
 #include <GL/glew.h>
+#include <glm/common.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
 
 namespace Resource {
-    Mesh::~Mesh() {
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
+    StagedMeshBuffers stageMeshBuffers(const std::span<const MeshVertex> vertices, const std::span<const unsigned int> indices,
+                                       const VertexFormat vertexFormat) {
+        StagedMeshBuffers staged;
+        staged.vertices = vertices;
+        staged.indices = indices;
+        staged.vertexFormat = vertexFormat;
+        staged.contentHash = xxh64(indices.data(), indices.size_bytes(),
+            xxh64(vertices.data(), vertices.size_bytes(), static_cast<uint64_t>(vertexFormat)));
+        if (vertexFormat == VertexFormat::PACKED) {
+            const MeshBounds bounds = computeMeshBounds(vertices, {});
+            staged.packedVertices = packMeshVertices(vertices, bounds.min, bounds.max);
+            staged.dequantizeTransform = getDequantizeTransform(bounds.min, bounds.max);
+        }
+        if (vertices.size() <= std::numeric_limits<uint16_t>::max() + size_t{1})
+            staged.shortIndices.assign(indices.begin(), indices.end());
+        return staged;
     }
 
-    void Mesh::rebuildGl() {
-        // where the "re" in rebuild comes in :3. delete on 0 is no-op
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-
+    MeshBuffers::MeshBuffers(const StagedMeshBuffers& staged)
+        : vertexCount(staged.vertices.size()), indexCount(staged.indices.size()), vertexFormat(staged.vertexFormat),
+          dequantizeTransform(staged.dequantizeTransform)
+    {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER,
-            static_cast<GLsizeiptr>(vertices.size() * sizeof(MeshVertex)),
-            vertices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            static_cast<GLsizeiptr>(indices.size() * sizeof(unsigned int)),
-            indices.data(), GL_STATIC_DRAW);
+        const std::span<const std::byte> vertexBytes = vertexFormat == VertexFormat::PACKED
+            ? std::as_bytes(std::span(staged.packedVertices)) : std::as_bytes(staged.vertices);
+        const GLsizei vertexStride = vertexFormat == VertexFormat::PACKED ? sizeof(PackedMeshVertex) : sizeof(MeshVertex);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexBytes.size()), vertexBytes.data(), GL_STATIC_DRAW);
 
-#define ENABLE_F_VERTEX_ATTRIB(index, member) \
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        const bool shortIndices = !staged.shortIndices.empty() || staged.indices.empty();
+        const std::span<const std::byte> indexBytes = shortIndices
+            ? std::as_bytes(std::span(staged.shortIndices)) : std::as_bytes(staged.indices);
+        indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexBytes.size()), indexBytes.data(), GL_STATIC_DRAW);
+        gpuBytes = vertexBytes.size() + indexBytes.size();
+
+#define VERTEX_ATTRIB(index, size, type, normalized, vertexType, member) \
         glEnableVertexAttribArray(index); \
-        glVertexAttribPointer(index, \
-            sizeof(MeshVertex::member) / sizeof(float), GL_FLOAT, \
-            GL_FALSE, \
-            sizeof(MeshVertex), \
-            reinterpret_cast<void *>(offsetof(MeshVertex, member)))
+        glVertexAttribFormat(index, size, type, normalized, offsetof(vertexType, member)); \
+        glVertexAttribBinding(index, 0)
         // Set all the properties of the vertices
-        ENABLE_F_VERTEX_ATTRIB(0, Position);
-        ENABLE_F_VERTEX_ATTRIB(1, Normal);
-        ENABLE_F_VERTEX_ATTRIB(2, TexCoords);
-#undef ENABLE_F_VERTEX_ATTRIB
+        if (vertexFormat == VertexFormat::PACKED) {
+            VERTEX_ATTRIB(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, PackedMeshVertex, Position);
+            VERTEX_ATTRIB(1, 2, GL_SHORT, GL_TRUE, PackedMeshVertex, Normal);  // Decoded in the vertex shader
+            VERTEX_ATTRIB(2, 2, GL_HALF_FLOAT, GL_FALSE, PackedMeshVertex, TexCoords);
+        }
+        else {
+            VERTEX_ATTRIB(0, 3, GL_FLOAT, GL_FALSE, MeshVertex, Position);
+            VERTEX_ATTRIB(1, 3, GL_FLOAT, GL_FALSE, MeshVertex, Normal);
+            VERTEX_ATTRIB(2, 2, GL_FLOAT, GL_FALSE, MeshVertex, TexCoords);
+        }
+#undef VERTEX_ATTRIB
+        glBindVertexBuffer(0, VBO, 0, vertexStride);
+    }
+
+    MeshBuffers::~MeshBuffers() {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    MeshBounds computeMeshBounds(const std::span<const MeshVertex> vertices, const std::span<const unsigned int> indices) {
+        MeshBounds bounds;
+        if (vertices.empty())
+            return bounds;
+        bounds.min = bounds.max = vertices[0].Position;
+        for (const MeshVertex& vertex : vertices) {
+            bounds.min = glm::min(bounds.min, vertex.Position);
+            bounds.max = glm::max(bounds.max, vertex.Position);
+        }
+
+        // Ratio of the total area in texture space to the total area in model space, per triangle it would vary a lot
+        double worldArea = 0.0, uvArea = 0.0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const MeshVertex& a = vertices[indices[i]];
+            const MeshVertex& b = vertices[indices[i + 1]];
+            const MeshVertex& c = vertices[indices[i + 2]];
+            worldArea += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position)) * 0.5;
+            const glm::vec2 uvB = b.TexCoords - a.TexCoords, uvC = c.TexCoords - a.TexCoords;
+            uvArea += std::abs(uvB.x * uvC.y - uvB.y * uvC.x) * 0.5;
+        }
+        bounds.uvDensity = worldArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / worldArea)) : 0.0f;
+        return bounds;
+    }
+
+    /*! Octahedral encoding, which spreads the precision evenly over the sphere unlike storing two of the components. */
+    glm::vec2 encodeOctahedral(const glm::vec3& normal) {
+        const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length <= 0.0f)
+            return glm::vec2(0.0f);
+        glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+        if (normal.z < 0.0f) {
+            // Fold the lower hemisphere over the diagonals
+            encoded = glm::vec2(
+                (1.0f - std::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return encoded;
     }
 
-#pragma region Move Semantics
-    Mesh& Mesh::operator=(Mesh&& other) noexcept {
-        if (this != &other) {
-            glDeleteVertexArrays(1, &VAO);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-
-            VAO = other.VAO;
-            VBO = other.VBO;
-            EBO = other.EBO;
-            vertices = std::move(other.vertices);
-            indices = std::move(other.indices);
-            material = std::move(other.material);
-
-            other.VAO = 0;
-            other.VBO = 0;
-            other.EBO = 0;
+    std::vector<PackedMeshVertex> packMeshVertices(const std::span<const MeshVertex> vertices,
+                                                   const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        const glm::vec3 extent = boundsMax - boundsMin;
+        std::vector<PackedMeshVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const MeshVertex& vertex = vertices[i];
+            for (int axis = 0; axis < 3; axis++) {
+                const float position = extent[axis] > 0.0f ? (vertex.Position[axis] - boundsMin[axis]) / extent[axis] : 0.0f;
+                packed[i].Position[axis] = glm::packUnorm1x16(position);
+            }
+            const glm::vec2 normal = encodeOctahedral(vertex.Normal);
+            packed[i].Normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+            packed[i].Normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+            packed[i].TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+            packed[i].TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
         }
-        return *this;
+        return packed;
     }
-    Mesh::Mesh(Mesh&& other) noexcept {
-        VAO = other.VAO;
-        VBO = other.VBO;
-        EBO = other.EBO;
-        vertices = std::move(other.vertices);
-        indices = std::move(other.indices);
-        material = std::move(other.material);
-
-        other.VAO = 0;
-        other.VBO = 0;
-        other.EBO = 0;
+
+    glm::mat4 getDequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), boundsMax - boundsMin);
+    }
+
+    void Mesh::updateBounds() {
+        const MeshBounds bounds = computeMeshBounds(vertices, indices);
+        boundsMin = bounds.min;
+        boundsMax = bounds.max;
+        uvDensity = bounds.uvDensity;
+    }
+
+    void Mesh::rebuildGl() {
+        // Identical geometry elsewhere is shared rather than uploaded again
+        buffers = engineState->resourceManager.loadMeshBuffers(vertices, indices);
     }
-#pragma endregion
 
     void Mesh::bindBuffers() const {
-        glBindVertexArray(VAO);
+        glBindVertexArray(buffers->VAO);
     }
 
-    Expected<void> Mesh::Draw(const glm::mat4& modelTransform) const {
-        const std::shared_ptr<Shader> shader = material->shader;
+    Expected<bool> Mesh::Draw(const glm::mat4& modelTransform, const PBRMaterial& material, const bool materialBound,
+                              const Culling::View* view) const {
+        const std::shared_ptr<Shader>& shader = material.shader;
         if (!shader)
             return std::unexpected(ERROR("Mesh material has no shader"));
-        shader->use();
-        shader->setMat4("model", modelTransform);
+        if (!buffers)
+            return std::unexpected(ERROR("Mesh has no GPU buffers"));
+        visibleRanges.clear();
+        if (view != nullptr) {
+            if (!Culling::isSphereVisible(*view, modelTransform, (boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f))
+                return false;
+            if (meshlets.count > 0) {
+                const size_t indexSize = buffers->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+                Culling::cullMeshlets(meshlets, modelTransform, *view, indexSize, visibleRanges);
+                if (visibleRanges.counts.empty())
+                    return false;
+            }
+        }
+        if (!materialBound) {
+            shader->use();
+            shader->setVec4("uvTransform", material.uvTransform);
+        }
+        // Packed positions are dequantized by the model transform, but normals are decoded separately
+        shader->setMat4("model", modelTransform * buffers->dequantizeTransform);
         shader->setMat3("mTransposed", glm::mat3(glm::transpose(glm::inverse(modelTransform))));
-        // Populate shader material uniforms
+        shader->setBool("octahedralNormals", buffers->vertexFormat == VertexFormat::PACKED);
+        // Populate shader material uniforms. The textures are still bound for every mesh, as each one requests the size it needs
         {
             Engine::ResourceManager& resourceManager = engineState->resourceManager;
+            const int requestedSize = resourceManager.getRequestedTextureSize(modelTransform, boundsMin, boundsMax, uvDensity);
             unsigned int workingIndex = 0;
 #define BIND_TEX(key, value) \
-            shader->setInt("material." key, static_cast<int>(workingIndex)); \
+            if (!materialBound) \
+                shader->setInt("material." key, static_cast<int>(workingIndex)); \
             glActiveTexture(GL_TEXTURE0 + workingIndex); \
-            glBindTexture(GL_TEXTURE_2D, value ? value->textureID : resourceManager.errorTexture->textureID); \
+            glBindTexture(GL_TEXTURE_2D, resourceManager.useTexture(value, requestedSize)); \
             workingIndex++
 
-            BIND_TEX("albedo_tex", material->albedo);
-            BIND_TEX("normal_tex", material->normal);
-            BIND_TEX("roughness_tex", material->roughness);
-            BIND_TEX("metallic_tex", material->metallic);
-            BIND_TEX("ambientOcclusion_tex", material->ambientOcclusion);
+            BIND_TEX("albedo_tex", material.albedo);
+            BIND_TEX("normal_tex", material.normal);
+            BIND_TEX("roughness_tex", material.roughness);
+            BIND_TEX("metallic_tex", material.metallic);
+            BIND_TEX("ambientOcclusion_tex", material.ambientOcclusion);
 #undef BIND_TEX
         }
 
         bindBuffers();
-        assert(!indices.empty() && indices.size() < std::numeric_limits<GLsizei>::max());
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
-        return {};
+        assert(buffers->indexCount > 0 && buffers->indexCount < std::numeric_limits<GLsizei>::max());
+        if (visibleRanges.counts.empty())
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(buffers->indexCount), buffers->indexType, nullptr);
+        else
+            glMultiDrawElements(GL_TRIANGLES, visibleRanges.counts.data(), buffers->indexType, visibleRanges.offsets.data(),
+                static_cast<GLsizei>(visibleRanges.counts.size()));
+        return true;
     }
 
 }
@@ -1,11 +1,15 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 
 #include "material.h"
+#include "engine/render/culling.h"
 
 
 namespace Resource {
@@ -16,34 +20,130 @@ namespace Resource {
         glm::vec2 TexCoords = glm::vec2(0.0f);
     };
 
+    /*!
+     * Half the size of \ref MeshVertex, for meshes that don't need full precision.
+     * @see packMeshVertices()
+     */
+    struct PackedMeshVertex {
+        uint16_t Position[4];  // UNORM16 within the bounds of the mesh, the last one is padding
+        int16_t Normal[2];  // SNORM16 octahedral encoding
+        uint16_t TexCoords[2];  // Half floats
+    };
+    static_assert(sizeof(PackedMeshVertex) == 16);
+
+    enum class VertexFormat {
+        FULL,  // MeshVertex
+        PACKED,  // PackedMeshVertex
+    };
+
+    /*! Bounds and texture coordinate density of a piece of geometry, see \ref Mesh for what they mean. */
+    struct MeshBounds {
+        glm::vec3 min = glm::vec3(0.0f), max = glm::vec3(0.0f);
+        float uvDensity = 0.0f;
+    };
+    /*! @note Doesn't touch OpenGL, so it is safe to call from any thread. */
+    [[nodiscard]] MeshBounds computeMeshBounds(std::span<const MeshVertex> vertices, std::span<const unsigned int> indices);
+    /*!
+     * Quantizes vertices into \ref PackedMeshVertex.
+     * Positions keep 1/65535th of the bounds' size along each axis, so sub-millimetre precision for meshes up to about 60m across.
+     * @param boundsMin, boundsMax Bounds of the vertex positions, see \ref getDequantizeTransform().
+     * @note Doesn't touch OpenGL, so it is safe to call from any thread.
+     */
+    [[nodiscard]] std::vector<PackedMeshVertex> packMeshVertices(std::span<const MeshVertex> vertices,
+                                                                 const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    /*! @returns The transform from quantized positions in [0, 1] back into model space. */
+    [[nodiscard]] glm::mat4 getDequantizeTransform(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    /*!
+     * Geometry converted into the formats it is uploaded in, ready to become \ref MeshBuffers.
+     * @note Staging doesn't touch OpenGL, so meshes can be staged on worker threads and only uploaded on the main thread.
+     */
+    struct StagedMeshBuffers {
+        std::span<const MeshVertex> vertices;  // Not copied, must outlive the staged buffers
+        std::span<const unsigned int> indices;
+        VertexFormat vertexFormat = VertexFormat::FULL;
+        uint64_t contentHash = 0;  // Of the vertices, indices and format
+        std::vector<PackedMeshVertex> packedVertices;  // Only for VertexFormat::PACKED
+        std::vector<uint16_t> shortIndices;  // Only for meshes with at most 65536 vertices
+        glm::mat4 dequantizeTransform = glm::mat4(1.0f);
+    };
+    [[nodiscard]] StagedMeshBuffers stageMeshBuffers(std::span<const MeshVertex> vertices, std::span<const unsigned int> indices,
+                                                     VertexFormat vertexFormat);
+
+    /*!
+     * The OpenGL buffers holding a mesh's geometry, deleted when it goes out of scope.
+     * Meshes with identical geometry share a single instance, see \ref Engine::ResourceManager::loadMeshBuffers() "loadMeshBuffers()".
+     * Meshes with at most 65536 vertices always get 16 bit indices.
+     */
+    class MeshBuffers {
+    public:
+        unsigned int VAO{}, VBO{}, EBO{};
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        VertexFormat vertexFormat = VertexFormat::FULL;
+        unsigned int indexType{};  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        size_t gpuBytes = 0;
+        /*! Applied before the model transform, to turn packed positions back into model space. Identity for full vertices. */
+        glm::mat4 dequantizeTransform = glm::mat4(1.0f);
+
+        explicit MeshBuffers(const StagedMeshBuffers& staged);
+        ~MeshBuffers();
+
+        // Non-copyable
+        MeshBuffers(const MeshBuffers&) = delete;
+        MeshBuffers& operator=(const MeshBuffers&) = delete;
+    };
+
     /*!
      * A mesh is a piece of geometry with a single material.
-     * It manages its own OpenGL buffers.
+     * Its OpenGL buffers are shared with other meshes with the same geometry.
      */
     class Mesh {
     public:
         std::vector<MeshVertex> vertices;
         std::vector<unsigned int> indices;
-        std::shared_ptr<PBRMaterial> material;
+        /*! The material in the table of the scene holding this mesh. */
+        MaterialID materialID = NO_MATERIAL;
+        /*! The meshlets covering all of \ref indices, culled separately when drawn with a view. Empty to always draw everything. */
+        Culling::MeshletBounds meshlets;
+
+        std::shared_ptr<MeshBuffers> buffers;
+
+        /*! Axis aligned bounds of the vertices, in model space. */
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+        /*!
+         * Average texture coordinate units per model space unit, used to work out how much of a texture is visible.
+         * 0 if the mesh has no texture coordinates.
+         */
+        float uvDensity = 0.0f;
+    private:
+        mutable Culling::DrawRanges visibleRanges;  // Scratch space for Draw()
 
-        unsigned int VAO{}, VBO{}, EBO{};
     public:
         Mesh() = default;
-        ~Mesh();
         std::string name;
 
+        /*! Recomputes the bounds and UV density from the current vertices and indices. */
+        void updateBounds();
         /*! Binds the mesh's VAO. */
         void bindBuffers() const;
         /*! (Re)creates the OpenGL buffers for this mesh based on its current data. */
         void rebuildGl();
 
-        Expected<void> Draw(const glm::mat4& modelTransform) const;
+        /*!
+         * @param material The material `materialID` refers to.
+         * @param materialBound Whether the previous draw used the same material, so its shader and uniforms are already set.
+         * @param view If given, the mesh is culled against it, and only its visible meshlets are drawn.
+         * @return Whether the mesh was drawn, false if it was culled. The material is only bound if it was.
+         */
+        Expected<bool> Draw(const glm::mat4& modelTransform, const PBRMaterial& material, bool materialBound = false,
+                            const Culling::View* view = nullptr) const;
 
         // Non-copyable
         Mesh(const Mesh&) = delete;
         Mesh& operator=(const Mesh&) = delete;
         // Moveable
-        Mesh(Mesh&& other) noexcept;
-        Mesh& operator=(Mesh&& other) noexcept;
+        Mesh(Mesh&& other) noexcept = default;
+        Mesh& operator=(Mesh&& other) noexcept = default;
     };
 }
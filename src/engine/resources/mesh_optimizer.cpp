@@ -0,0 +1,399 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+
+namespace MeshOptimizer {
+    constexpr unsigned int NO_VERTEX = ~0u;
+
+    uint64_t hashKey(const int64_t* key, const size_t length) {
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<uint64_t>(key[i]) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+        }
+        // Finalise like splitmix64, the open addressing below only uses the low bits
+        hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+        return hash ^ (hash >> 31);
+    }
+
+    size_t weldVertices(const std::span<float> vertices, const size_t floatsPerVertex, std::vector<unsigned int>& indices,
+                        const float quantum) {
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        std::vector<int64_t> keys(vertexCount * floatsPerVertex);
+        for (size_t i = 0; i < keys.size(); i++) {
+            const float value = vertices[i];
+            // Non-finite values can't be rounded, so they only match themselves
+            keys[i] = std::isfinite(value) ? std::llround(static_cast<double>(value) / quantum) : std::bit_cast<int32_t>(value);
+        }
+
+        const size_t tableSize = std::bit_ceil(std::max<size_t>(vertexCount * 2, 16));
+        std::vector<unsigned int> table(tableSize, NO_VERTEX);  // Holds the first vertex seen with each key
+        std::vector<unsigned int> remap(vertexCount);
+        size_t uniqueCount = 0;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+            const int64_t* key = keys.data() + vertex * floatsPerVertex;
+            for (size_t slot = hashKey(key, floatsPerVertex) & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1)) {
+                const unsigned int existing = table[slot];
+                if (existing == NO_VERTEX) {
+                    table[slot] = static_cast<unsigned int>(vertex);
+                    remap[vertex] = static_cast<unsigned int>(uniqueCount);
+                    // Never overwrites a vertex that is still to be read, the destination is never past the source
+                    std::memmove(vertices.data() + uniqueCount * floatsPerVertex, vertices.data() + vertex * floatsPerVertex,
+                        floatsPerVertex * sizeof(float));
+                    uniqueCount++;
+                    break;
+                }
+                if (std::equal(key, key + floatsPerVertex, keys.data() + existing * floatsPerVertex)) {
+                    remap[vertex] = remap[existing];
+                    break;
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;  // Collapsed into a line or a point
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+        return uniqueCount;
+    }
+
+    void optimizeVertexCache(const std::span<unsigned int> indices, const size_t vertexCount,
+                             std::vector<size_t>* clusterStarts, const unsigned int cacheSize) {
+        if (clusterStarts != nullptr)
+            clusterStarts->assign({0});
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // The triangles using every vertex, and how many of them are yet to be emitted
+        std::vector<unsigned int> liveTriangles(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            liveTriangles[indices[i]]++;
+        std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+        std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        {
+            std::vector<size_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < triangleCount * 3; i++)
+                adjacency[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnds, candidates, output;
+        deadEnds.reserve(triangleCount * 3);
+        output.reserve(triangleCount * 3);
+        unsigned int time = cacheSize + 1;
+        size_t scanCursor = 0;
+
+        const auto skipDeadEnd = [&]() -> size_t {
+            // Recently used vertices are likely still cached, otherwise start over from the next unfinished one
+            while (!deadEnds.empty()) {
+                const unsigned int vertex = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[vertex] > 0)
+                    return vertex;
+            }
+            for (; scanCursor < vertexCount; scanCursor++)
+                if (liveTriangles[scanCursor] > 0)
+                    return scanCursor;
+            return NO_VERTEX;
+        };
+
+        size_t fanning = skipDeadEnd();
+        while (fanning != NO_VERTEX) {
+            candidates.clear();
+            for (size_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+                const unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                emitted[triangle] = true;
+                for (size_t corner = 0; corner < 3; corner++) {
+                    const unsigned int vertex = indices[triangle * 3 + corner];
+                    output.push_back(vertex);
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+                    if (time - cacheTime[vertex] > cacheSize)
+                        cacheTime[vertex] = time++;
+                }
+            }
+
+            // Prefer the candidate that will still be cached after its remaining triangles are emitted, and has been cached longest
+            size_t next = NO_VERTEX;
+            int bestPriority = -1;
+            for (const unsigned int vertex : candidates) {
+                if (liveTriangles[vertex] == 0)
+                    continue;
+                int priority = 0;
+                if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                    priority = static_cast<int>(time - cacheTime[vertex]);
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = vertex;
+                }
+            }
+            if (next == NO_VERTEX) {
+                next = skipDeadEnd();
+                if (next != NO_VERTEX && clusterStarts != nullptr)
+                    clusterStarts->push_back(output.size());
+            }
+            fanning = next;
+        }
+        std::ranges::copy(output, indices.begin());
+    }
+
+    void optimizeOverdraw(const std::span<unsigned int> indices, const std::span<const float> positions, const size_t positionStride,
+                          const std::span<const size_t> clusterStarts, const float threshold, const unsigned int cacheSize) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+        const size_t vertexCount = positions.size() / positionStride;
+
+        // Split the clusters wherever a fresh cache costs little compared to the cluster as a whole
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        const auto countMisses = [&](const size_t triangle) {
+            unsigned int misses = 0;
+            for (size_t corner = 0; corner < 3; corner++) {
+                const unsigned int vertex = indices[triangle * 3 + corner];
+                if (time - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        };
+        const auto flushCache = [&] { time += cacheSize + 1; };
+
+        std::vector<size_t> clusters;  // First triangle of each
+        for (size_t hard = 0; hard < clusterStarts.size(); hard++) {
+            const size_t first = clusterStarts[hard] / 3;
+            const size_t end = hard + 1 < clusterStarts.size() ? clusterStarts[hard + 1] / 3 : triangleCount;
+            if (first >= end)
+                continue;
+            flushCache();
+            size_t clusterMisses = 0;
+            for (size_t triangle = first; triangle < end; triangle++)
+                clusterMisses += countMisses(triangle);
+            const float budget = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - first);
+
+            flushCache();
+            clusters.push_back(first);
+            size_t start = first, misses = 0;
+            for (size_t triangle = first; triangle < end; triangle++) {
+                misses += countMisses(triangle);
+                if (triangle + 1 < end && static_cast<float>(misses) <= budget * static_cast<float>(triangle + 1 - start)) {
+                    clusters.push_back(triangle + 1);
+                    start = triangle + 1;
+                    misses = 0;
+                    flushCache();
+                }
+            }
+        }
+        if (clusters.empty() || clusters.front() != 0)
+            clusters.insert(clusters.begin(), 0);
+
+        struct Cluster {
+            size_t first, end;
+            float sortKey;
+        };
+        const auto position = [&](const unsigned int vertex, const size_t axis) {
+            return static_cast<double>(positions[vertex * positionStride + axis]);
+        };
+        std::vector<Cluster> sorted;
+        std::vector<std::array<double, 7>> sums;  // Area weighted centroid, area, and area weighted normal
+        std::array<double, 4> meshSum{};
+        for (size_t c = 0; c < clusters.size(); c++) {
+            const size_t first = clusters[c], end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            std::array<double, 7> sum{};
+            for (size_t triangle = first; triangle < end; triangle++) {
+                const unsigned int a = indices[triangle * 3], b = indices[triangle * 3 + 1], v = indices[triangle * 3 + 2];
+                std::array<double, 3> ab{}, ac{}, centroid{};
+                for (size_t axis = 0; axis < 3; axis++) {
+                    ab[axis] = position(b, axis) - position(a, axis);
+                    ac[axis] = position(v, axis) - position(a, axis);
+                    centroid[axis] = (position(a, axis) + position(b, axis) + position(v, axis)) / 3.0;
+                }
+                const std::array normal = {
+                    ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0],
+                };
+                const double area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) * 0.5;
+                for (size_t axis = 0; axis < 3; axis++) {
+                    sum[axis] += centroid[axis] * area;
+                    sum[4 + axis] += normal[axis];
+                }
+                sum[3] += area;
+            }
+            for (size_t i = 0; i < 4; i++)
+                meshSum[i] += sum[i];
+            sums.push_back(sum);
+            sorted.push_back({first, end, 0.0f});
+        }
+        if (meshSum[3] <= 0.0)
+            return;  // Nothing but degenerate triangles, so nothing to sort by
+
+        for (size_t c = 0; c < sorted.size(); c++) {
+            const std::array<double, 7>& sum = sums[c];
+            const double normalLength = std::sqrt(sum[4] * sum[4] + sum[5] * sum[5] + sum[6] * sum[6]);
+            if (sum[3] <= 0.0 || normalLength <= 0.0)
+                continue;
+            double key = 0.0;
+            for (size_t axis = 0; axis < 3; axis++)
+                key += (sum[axis] / sum[3] - meshSum[axis] / meshSum[3]) * sum[4 + axis] / normalLength;
+            sorted[c].sortKey = static_cast<float>(key);
+        }
+        std::ranges::stable_sort(sorted, std::greater{}, &Cluster::sortKey);
+
+        std::vector<unsigned int> output;
+        output.reserve(triangleCount * 3);
+        for (const Cluster& cluster : sorted)
+            output.insert(output.end(), indices.begin() + static_cast<std::ptrdiff_t>(cluster.first * 3),
+                indices.begin() + static_cast<std::ptrdiff_t>(cluster.end * 3));
+        std::ranges::copy(output, indices.begin());
+    }
+
+    size_t optimizeVertexFetch(const std::span<float> vertices, const size_t floatsPerVertex, const std::span<unsigned int> indices) {
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        std::vector<unsigned int> remap(vertexCount, NO_VERTEX);
+        unsigned int nextVertex = 0;
+        for (unsigned int& index : indices) {
+            if (remap[index] == NO_VERTEX)
+                remap[index] = nextVertex++;
+            index = remap[index];
+        }
+
+        std::vector<float> reordered(static_cast<size_t>(nextVertex) * floatsPerVertex);
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+            if (remap[vertex] != NO_VERTEX)
+                std::copy_n(vertices.begin() + static_cast<std::ptrdiff_t>(vertex * floatsPerVertex), floatsPerVertex,
+                    reordered.begin() + static_cast<std::ptrdiff_t>(remap[vertex] * floatsPerVertex));
+        std::ranges::copy(reordered, vertices.begin());
+        return nextVertex;
+    }
+
+    /*! Works out the bounding sphere and normal cone of a finished meshlet. */
+    void computeMeshletBounds(Meshlet& meshlet, const std::span<const unsigned int> indices, const std::span<const float> positions,
+                              const size_t positionStride) {
+        const auto position = [&](const unsigned int vertex) -> std::array<float, 3> {
+            const float* p = positions.data() + vertex * positionStride;
+            return {p[0], p[1], p[2]};
+        };
+        const std::span<const unsigned int> meshletIndices = indices.subspan(meshlet.firstIndex, meshlet.indexCount);
+
+        // The centre of the box around the vertices is close enough to the smallest sphere for culling
+        std::array<float, 3> min = position(meshletIndices[0]), max = min;
+        for (const unsigned int vertex : meshletIndices) {
+            const std::array<float, 3> p = position(vertex);
+            for (size_t axis = 0; axis < 3; axis++) {
+                min[axis] = std::min(min[axis], p[axis]);
+                max[axis] = std::max(max[axis], p[axis]);
+            }
+        }
+        float radiusSquared = 0.0f;
+        for (size_t axis = 0; axis < 3; axis++)
+            meshlet.center[axis] = (min[axis] + max[axis]) * 0.5f;
+        for (const unsigned int vertex : meshletIndices) {
+            const std::array<float, 3> p = position(vertex);
+            float distanceSquared = 0.0f;
+            for (size_t axis = 0; axis < 3; axis++)
+                distanceSquared += (p[axis] - meshlet.center[axis]) * (p[axis] - meshlet.center[axis]);
+            radiusSquared = std::max(radiusSquared, distanceSquared);
+        }
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // Counter-clockwise triangles face along (b - a) x (c - a)
+        std::vector<std::array<float, 3>> normals;
+        normals.reserve(meshletIndices.size() / 3);
+        std::array<float, 3> axisSum{};
+        for (size_t i = 0; i + 2 < meshletIndices.size(); i += 3) {
+            const std::array<float, 3> a = position(meshletIndices[i]), b = position(meshletIndices[i + 1]), c = position(meshletIndices[i + 2]);
+            const std::array ab = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, ac = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            std::array normal = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length <= 0.0f)
+                continue;  // Degenerate triangles are never drawn, so they can face any way
+            for (size_t axis = 0; axis < 3; axis++) {
+                normal[axis] /= length;
+                axisSum[axis] += normal[axis];
+            }
+            normals.push_back(normal);
+        }
+        const float axisLength = std::sqrt(axisSum[0] * axisSum[0] + axisSum[1] * axisSum[1] + axisSum[2] * axisSum[2]);
+        float minimumDot = 1.0f;
+        for (size_t axis = 0; axis < 3; axis++)
+            meshlet.coneAxis[axis] = axisLength > 0.0f ? axisSum[axis] / axisLength : 0.0f;
+        for (const std::array<float, 3>& normal : normals)
+            minimumDot = std::min(minimumDot,
+                normal[0] * meshlet.coneAxis[0] + normal[1] * meshlet.coneAxis[1] + normal[2] * meshlet.coneAxis[2]);
+        // Past about 84 degrees the cone is so wide that hardly any view direction could cull it
+        meshlet.coneCutoff = axisLength <= 0.0f || minimumDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+
+    std::vector<Meshlet> buildMeshlets(const std::span<const unsigned int> indices, const std::span<const float> positions,
+                                       const size_t positionStride, const size_t maxVertices, const size_t maxTriangles) {
+        std::vector<Meshlet> meshlets;
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return meshlets;
+
+        // Which meshlet each vertex was last counted in, so a vertex shared by many triangles only counts once
+        std::vector<uint32_t> lastMeshlet(positions.size() / positionStride, ~0u);
+        Meshlet current{};
+        size_t vertexCount = 0;
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            size_t newVertices = 0;
+            for (size_t corner = 0; corner < 3; corner++)
+                newVertices += lastMeshlet[indices[triangle * 3 + corner]] != meshlets.size() ? 1 : 0;
+            if (current.indexCount > 0 && (vertexCount + newVertices > maxVertices || current.indexCount / 3 + 1 > maxTriangles)) {
+                computeMeshletBounds(current, indices, positions, positionStride);
+                meshlets.push_back(current);
+                current = Meshlet{};
+                current.firstIndex = static_cast<uint32_t>(triangle * 3);
+                vertexCount = 0;
+            }
+
+            const auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+            for (size_t corner = 0; corner < 3; corner++) {
+                uint32_t& last = lastMeshlet[indices[triangle * 3 + corner]];
+                if (last != meshletIndex) {
+                    last = meshletIndex;
+                    vertexCount++;
+                }
+            }
+            current.indexCount += 3;
+        }
+        computeMeshletBounds(current, indices, positions, positionStride);
+        meshlets.push_back(current);
+        return meshlets;
+    }
+
+    float computeACMR(const std::span<const unsigned int> indices, const size_t vertexCount, const unsigned int cacheSize) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return 0.0f;
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        size_t misses = 0;
+        for (const unsigned int vertex : indices.first(triangleCount * 3)) {
+            if (time - cacheTime[vertex] > cacheSize) {
+                cacheTime[vertex] = time++;
+                misses++;
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(triangleCount);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * Reordering of indexed triangle meshes for faster rendering, run once when a scene is imported.
+ *
+ * The stages are meant to run in order: weld identical vertices, order triangles for the post-transform vertex cache,
+ * order clusters of triangles to reduce overdraw, then order vertices by first use for the pre-transform fetch.
+ * Splitting the result into meshlets for culling leaves the order as it is.
+ * Vertices are treated as tightly packed floats, so any vertex layout without integer attributes works.
+ *
+ * Kept free of engine dependencies, like the other mesh and texture processing stages.
+ */
+namespace MeshOptimizer {
+    /*! Size of the FIFO cache simulated when ordering triangles, about what GPUs effectively reuse from. */
+    constexpr unsigned int VERTEX_CACHE_SIZE = 16;
+    /*! How much worse than its best the vertex cache efficiency may get, in exchange for less overdraw. */
+    constexpr float OVERDRAW_THRESHOLD = 1.05f;
+    /*! Meshlet limits, the sizes mesh shading hardware is built around. */
+    constexpr size_t MESHLET_MAX_VERTICES = 64;
+    constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+    /*! A contiguous range of a mesh's triangles, with the bounds needed to cull it as a whole. */
+    struct Meshlet {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float center[3];
+        float radius;
+        /*! Average facing of the triangles. */
+        float coneAxis[3];
+        /*!
+         * Sine of the largest angle between the axis and any triangle's normal, or 1 if they face too many ways to cull by.
+         * The meshlet faces away from a camera at `eye` when `dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius`.
+         */
+        float coneCutoff;
+    };
+    static_assert(sizeof(Meshlet) == 40);
+
+    /*!
+     * Merges vertices whose components all round to the same multiple of `quantum`, and drops triangles that become degenerate.
+     * @param vertices Tightly packed vertices. The unique ones are moved to the front, in order of first appearance.
+     * @return The number of unique vertices kept at the front of `vertices`.
+     */
+    size_t weldVertices(std::span<float> vertices, size_t floatsPerVertex, std::vector<unsigned int>& indices, float quantum);
+
+    /*!
+     * Reorders triangles to reuse recently transformed vertices, using Tipsify (Sander, Nehab and Barczak 2007).
+     * @param clusterStarts If given, set to the first index of every run of triangles that starts where Tipsify had to leave the current fan.
+     *                      These are the clusters \ref optimizeOverdraw() "optimizeOverdraw()" can reorder.
+     */
+    void optimizeVertexCache(std::span<unsigned int> indices, size_t vertexCount,
+                             std::vector<size_t>* clusterStarts = nullptr, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+    /*!
+     * Reorders clusters of triangles so the ones facing outwards, which are likely to hide the others, are drawn first.
+     * @details Clusters are split further where that costs little vertex cache efficiency, then sorted by how much they face away
+     *          from the centre of the mesh, as in the second half of the Tipsify paper.
+     * @param positions The position of every vertex, `positionStride` floats apart.
+     * @param clusterStarts As returned by \ref optimizeVertexCache() "optimizeVertexCache()".
+     */
+    void optimizeOverdraw(std::span<unsigned int> indices, std::span<const float> positions, size_t positionStride,
+                          std::span<const size_t> clusterStarts, float threshold = OVERDRAW_THRESHOLD,
+                          unsigned int cacheSize = VERTEX_CACHE_SIZE);
+    /*!
+     * Reorders vertices by when they are first used, so drawing reads the vertex buffer mostly in order. Unused vertices are dropped.
+     * @return The number of vertices kept at the front of `vertices`.
+     */
+    size_t optimizeVertexFetch(std::span<float> vertices, size_t floatsPerVertex, std::span<unsigned int> indices);
+
+    /*!
+     * Splits triangles into meshlets of at most `maxVertices` unique vertices and `maxTriangles` triangles, in their current order.
+     * @details Run it after the other stages, whose orders already keep neighbouring triangles close together.
+     */
+    [[nodiscard]] std::vector<Meshlet> buildMeshlets(std::span<const unsigned int> indices, std::span<const float> positions,
+                                                     size_t positionStride, size_t maxVertices = MESHLET_MAX_VERTICES,
+                                                     size_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    /*! @returns The average number of vertices transformed per triangle by a FIFO vertex cache. 3 is the worst, 0.5 about the best. */
+    [[nodiscard]] float computeACMR(std::span<const unsigned int> indices, size_t vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+}
@@ -0,0 +1,231 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Mipmap {
+    // Levels smaller than this aren't worth handing to other threads
+    constexpr size_t PARALLEL_MIN_PIXELS = 128 * 128;
+    constexpr int ROWS_PER_TASK = 16;
+
+    int getLevelCount(const int width, const int height) {
+        return std::bit_width(static_cast<unsigned int>(std::max({width, height, 1})));
+    }
+
+#pragma region sRGB
+    float srgbToLinear(const float value) {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    float linearToSrgb(const float value) {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    const std::array<float, 256>& getLinearTable() {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> result{};
+            for (int i = 0; i < 256; i++)
+                result[i] = srgbToLinear(static_cast<float>(i) / 255.0f);
+            return result;
+        }();
+        return table;
+    }
+    // Indexed by the linear value scaled to 16 bits, fine enough to round trip every 8 bit sRGB value
+    constexpr int SRGB_TABLE_SIZE = 1 << 16;
+    const std::vector<unsigned char>& getSrgbTable() {
+        static const std::vector<unsigned char> table = [] {
+            std::vector<unsigned char> result(SRGB_TABLE_SIZE);
+            for (int i = 0; i < SRGB_TABLE_SIZE; i++)
+                result[i] = static_cast<unsigned char>(std::lround(
+                    linearToSrgb(static_cast<float>(i) / (SRGB_TABLE_SIZE - 1)) * 255.0f));
+            return result;
+        }();
+        return table;
+    }
+#pragma endregion
+
+#pragma region Row filters
+    struct Level {
+        const unsigned char* pixels;
+        int width, height;
+    };
+
+    const unsigned char* getPixel(const Level& level, const int x, const int y) {
+        return level.pixels + (static_cast<size_t>(y) * level.width + x) * 4;
+    }
+
+    void filterRowBox(const Level& source, unsigned char* out, const int newWidth, const int y, int x) {
+        // Clamped so that 1 pixel wide images average the same pixel with itself
+        const int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+        for (; x < newWidth; x++) {
+            const int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+            const unsigned char* samples[4] = {
+                getPixel(source, x0, y0), getPixel(source, x1, y0), getPixel(source, x0, y1), getPixel(source, x1, y1),
+            };
+            for (int c = 0; c < 4; c++)
+                out[x * 4 + c] = static_cast<unsigned char>((samples[0][c] + samples[1][c] + samples[2][c] + samples[3][c] + 2) / 4);
+        }
+    }
+
+#ifdef MIPMAP_SSE2
+    /*! Same result as \ref filterRowBox(), two output pixels at a time. Needs at least two source rows and columns. */
+    void filterRowBoxSSE2(const Level& source, unsigned char* out, const int newWidth, const int y) {
+        const unsigned char* row0 = getPixel(source, 0, y * 2);
+        const unsigned char* row1 = getPixel(source, 0, y * 2 + 1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        int x = 0;
+        for (; x + 2 <= newWidth; x += 2) {
+            // Four source pixels from each row, summed vertically in 16 bits
+            const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            const __m128i sumLow = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            const __m128i sumHigh = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            // Then horizontally, each half holds two neighbouring pixels
+            const __m128i pairLow = _mm_add_epi16(sumLow, _mm_srli_si128(sumLow, 8));
+            const __m128i pairHigh = _mm_add_epi16(sumHigh, _mm_srli_si128(sumHigh, 8));
+            const __m128i sum = _mm_unpacklo_epi64(pairLow, pairHigh);
+            const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(average, zero));
+        }
+        filterRowBox(source, out, newWidth, y, x);
+    }
+#endif
+
+    void filterRowSrgb(const Level& source, unsigned char* out, const int newWidth, const int y) {
+        const std::array<float, 256>& toLinear = getLinearTable();
+        const std::vector<unsigned char>& toSrgb = getSrgbTable();
+        const int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+        for (int x = 0; x < newWidth; x++) {
+            const int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+            const unsigned char* samples[4] = {
+                getPixel(source, x0, y0), getPixel(source, x1, y0), getPixel(source, x0, y1), getPixel(source, x1, y1),
+            };
+            for (int c = 0; c < 3; c++) {
+                const float linear = (toLinear[samples[0][c]] + toLinear[samples[1][c]]
+                    + toLinear[samples[2][c]] + toLinear[samples[3][c]]) * 0.25f;
+                out[x * 4 + c] = toSrgb[static_cast<size_t>(linear * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+            }
+            // Alpha is coverage, not colour, so it is always averaged as is
+            out[x * 4 + 3] = static_cast<unsigned char>((samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 2) / 4);
+        }
+    }
+
+    void renormalizeRow(unsigned char* out, const int newWidth) {
+        for (int x = 0; x < newWidth; x++) {
+            float normal[3];
+            for (int c = 0; c < 3; c++)
+                normal[c] = out[x * 4 + c] / 127.5f - 1.0f;
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 1e-4f)
+                for (int c = 0; c < 3; c++)
+                    out[x * 4 + c] = static_cast<unsigned char>(std::lround((normal[c] / length + 1.0f) * 127.5f));
+        }
+    }
+#pragma endregion
+
+#pragma region Alpha coverage
+    using AlphaHistogram = std::array<size_t, 256>;
+
+    AlphaHistogram getAlphaHistogram(const std::span<const unsigned char> rgba) {
+        AlphaHistogram histogram{};
+        for (size_t i = 3; i < rgba.size(); i += 4)
+            histogram[rgba[i]]++;
+        return histogram;
+    }
+    /*! @returns The share of pixels that pass the alpha test once their alpha is multiplied by `scale`. */
+    float getCoverage(const AlphaHistogram& histogram, const float cutoff, const float scale) {
+        size_t passing = 0, total = 0;
+        for (int alpha = 0; alpha < 256; alpha++) {
+            total += histogram[alpha];
+            if (std::min(static_cast<float>(alpha) * scale, 255.0f) >= cutoff * 255.0f)
+                passing += histogram[alpha];
+        }
+        return total > 0 ? static_cast<float>(passing) / static_cast<float>(total) : 0.0f;
+    }
+
+    /*! Rescales the alpha of a level so its coverage matches the full size image. */
+    void preserveCoverage(std::span<unsigned char> rgba, const float cutoff, const float targetCoverage) {
+        const AlphaHistogram histogram = getAlphaHistogram(rgba);
+        // Coverage only grows with the scale, so it can be found with a binary search
+        float low = 0.0f, high = 4.0f, scale = 1.0f;
+        for (int i = 0; i < 12; i++) {
+            scale = (low + high) * 0.5f;
+            if (getCoverage(histogram, cutoff, scale) < targetCoverage)
+                low = scale;
+            else
+                high = scale;
+        }
+        scale = high;
+        if (std::abs(scale - 1.0f) < 1e-3f)
+            return;
+        for (size_t i = 3; i < rgba.size(); i += 4)
+            rgba[i] = static_cast<unsigned char>(std::min(std::lround(rgba[i] * scale), 255L));
+    }
+#pragma endregion
+
+    std::vector<unsigned char> downsample(const std::span<const unsigned char> rgba, const int width, const int height,
+                                          const Options& options, const ParallelFor& parallelFor) {
+        const int newWidth = std::max(width / 2, 1), newHeight = std::max(height / 2, 1);
+        std::vector<unsigned char> result(static_cast<size_t>(newWidth) * newHeight * 4);
+        const Level source{rgba.data(), width, height};
+
+        const auto filterRows = [&](const int firstRow, const int lastRow) {
+            for (int y = firstRow; y < lastRow; y++) {
+                unsigned char* out = &result[static_cast<size_t>(y) * newWidth * 4];
+                if (options.srgb && !options.normalMap)
+                    filterRowSrgb(source, out, newWidth, y);
+#ifdef MIPMAP_SSE2
+                else if (width >= 2 && height >= 2)
+                    filterRowBoxSSE2(source, out, newWidth, y);
+#endif
+                else
+                    filterRowBox(source, out, newWidth, y, 0);
+                if (options.normalMap)
+                    renormalizeRow(out, newWidth);
+            }
+        };
+
+        const size_t taskCount = (newHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        if (parallelFor && result.size() / 4 >= PARALLEL_MIN_PIXELS && taskCount > 1)
+            parallelFor(taskCount, [&](const size_t task) {
+                const int firstRow = static_cast<int>(task) * ROWS_PER_TASK;
+                filterRows(firstRow, std::min(firstRow + ROWS_PER_TASK, newHeight));
+            });
+        else
+            filterRows(0, newHeight);
+        return result;
+    }
+
+    std::vector<unsigned char> generateChain(const std::span<const unsigned char> rgba, int width, int height,
+                                             const Options& options, const ParallelFor& parallelFor) {
+        const bool preservingCoverage = options.alphaCutoff > 0.0f;
+        const float targetCoverage = preservingCoverage
+            ? getCoverage(getAlphaHistogram(rgba), options.alphaCutoff, 1.0f) : 1.0f;
+
+        std::vector<unsigned char> chain;
+        std::vector<unsigned char> level;  // Filtered from the unscaled level above, scaling compounds otherwise
+        std::span<const unsigned char> previous = rgba;
+        const int levelCount = getLevelCount(width, height);
+        for (int levelIndex = 1; levelIndex < levelCount; levelIndex++) {
+            level = downsample(previous, width, height, options, parallelFor);
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+
+            const size_t offset = chain.size();
+            chain.insert(chain.end(), level.begin(), level.end());
+            // Fully opaque or fully cut out images keep their coverage without any help
+            if (preservingCoverage && targetCoverage > 0.0f && targetCoverage < 1.0f)
+                preserveCoverage(std::span(chain).subspan(offset), options.alphaCutoff, targetCoverage);
+            previous = level;
+        }
+        return chain;
+    }
+}
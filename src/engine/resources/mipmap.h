@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <span>
+#include <vector>
+
+/*
+ * CPU mip chain generation for RGBA8 images.
+ *
+ * Shared between the engine and the texture cooker tool, so this header must stay free of engine dependencies.
+ */
+namespace Mipmap {
+    struct Options {
+        /*! Average the colour channels in linear space, so sRGB encoded images don't darken as they shrink. */
+        bool srgb = false;
+        /*! Renormalise the averaged vectors rather than letting them shrink towards flat. */
+        bool normalMap = false;
+        /*!
+         * Alpha test threshold of cutout textures, between 0 and 1, or 0 if the texture isn't alpha tested.
+         * Every level's alpha is rescaled so the same share of pixels passes the test as in the full size image,
+         * otherwise foliage and fences thin out and vanish in the distance.
+         */
+        float alphaCutoff = 0.0f;
+    };
+    /*!
+     * Calls `body(i)` for every i in [0, count), possibly in parallel. Only used for large levels.
+     * Empty to run everything on the calling thread.
+     */
+    using ParallelFor = std::function<void(size_t count, const std::function<void(size_t)>& body)>;
+
+    /*! @returns The number of levels in a full mip chain, down to and including 1x1. */
+    int getLevelCount(int width, int height);
+
+    /*! Halves an RGBA8 image with a 2x2 box filter. Odd dimensions are rounded down, but never below 1. */
+    std::vector<unsigned char> downsample(std::span<const unsigned char> rgba, int width, int height,
+                                          const Options& options = {}, const ParallelFor& parallelFor = {});
+    /*!
+     * Generates every level below the given image, each one filtered from the level above it.
+     * @return The levels stored back to back, starting with the half size level. Empty for 1x1 images.
+     */
+    std::vector<unsigned char> generateChain(std::span<const unsigned char> rgba, int width, int height,
+                                             const Options& options = {}, const ParallelFor& parallelFor = {});
+}
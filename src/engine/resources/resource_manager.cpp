@@ -1,6 +1,12 @@
 #include "resource_manager.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <glm/geometric.hpp>
 #include <numeric>
+#include <ranges>
 #include <spdlog/fmt/ranges.h>
 
 // Generated header files for embedded resources
@@ -9,15 +15,96 @@
 #include <error_shader_frag.h>
 #include <error_shader_vert.h>
 
+#include "engine/state.h"
+#include "engine/util/hash.h"
+#include "engine/util/pack_format.h"
+
 
 namespace Engine {
+    constexpr std::array<std::pair<ResourceType, std::string_view>, 4> resourceTypeNames = {{
+        {ResourceType::SHADER, "shader"},
+        {ResourceType::TEXTURE, "texture"},
+        {ResourceType::CUBEMAP, "cubemap"},
+        {ResourceType::SCENE, "scene"},
+    }};
+    constexpr size_t MAX_RECENT_LOADS = 64;
+    // Streaming never gets to hog the thread pool, prefetches and compressions share it
+    constexpr size_t MAX_PENDING_STREAMS = 4;
+
+    /*!
+     * Takes the result of a prefetch if one was started, otherwise loads the resource right away.
+     * @param wasPrefetched Set to whether the result came from a prefetch.
+     * @note Helps run jobs spawned by the workers if the prefetch hasn't finished yet, see \ref ThreadPool::wait(const JobCounter&).
+     */
+    template<typename T, typename F>
+    Expected<T> takePrefetched(std::unordered_map<std::string, std::future<Expected<T>>>& prefetched,
+                               const std::string& key, bool& wasPrefetched, F&& loadNow)
+    {
+        wasPrefetched = false;
+        const auto it = prefetched.find(key);
+        if (it == prefetched.end())
+            return loadNow();
+        std::future<Expected<T>> future = std::move(it->second);
+        prefetched.erase(it);
+        try {
+            engineState->threadPool.wait(future);  // Helps with jobs the workers spawned, then blocks
+            Expected<T> result = future.get();
+            wasPrefetched = true;
+            return result;
+        } catch (const std::future_error&) {  // The task was discarded
+            return loadNow();
+        }
+    }
+
+    /*! @returns The size of the smallest mip level of a texture that is at least as large as requested of it. */
+    int getStreamingTargetSize(const Resource::ManagedTexture& texture) {
+        int size = texture.fullSize;
+        while (size > 1 && size / 2 >= texture.requestedSize)
+            size /= 2;
+        return size;
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void TimingHistogram::record(const double seconds) {
+        const auto microseconds = static_cast<uint64_t>(seconds * 1e6);
+        const size_t bucket = microseconds == 0 ? 0 : std::bit_width(microseconds) - 1;
+        buckets[std::min(bucket, BUCKET_COUNT - 1)]++;
+        count++;
+        totalSeconds += seconds;
+        maxSeconds = std::max(maxSeconds, seconds);
+    }
+
     ResourceManager::ResourceManager() {
         // Init error resources to an almost valid state
         errorShader = std::make_shared<Resource::Shader>(0);
         errorTexture = std::make_shared<Resource::ManagedTexture>(0);
+        errorCubemap = std::make_shared<Resource::ManagedTexture>(0, GL_TEXTURE_CUBE_MAP);
         errorScene = std::make_shared<Resource::Scene>();
     }
 
+    ResourceManager::~ResourceManager() {
+        const auto waitAll = [](auto& prefetched) {
+            for (auto& future : prefetched | std::views::values)
+                if (future.valid())
+                    future.wait();
+        };
+        waitAll(prefetchedShaderSources);
+        waitAll(prefetchedTextures);
+        waitAll(prefetchedCubemaps);
+        waitAll(prefetchedScenes);
+        for (auto& future : discardedScenes)
+            future.wait();
+        for (PendingCompression& pending : pendingCompressions)
+            if (pending.compressed.valid())
+                pending.compressed.wait();
+        for (PendingStream& pending : pendingStreams)
+            if (pending.image.valid())
+                pending.image.wait();
+    }
+
     Expected<void> ResourceManager::populateErrorResources()
     {
         // TEXTURE
@@ -29,7 +116,7 @@ namespace Engine {
         const auto tmpCubemap = Resource::Loading::loadCubemapSingle(BIN_ERROR_PNG.data(), BIN_ERROR_PNG.size());
         if (!tmpCubemap.has_value())
             return std::unexpected(FW_ERROR(tmpCubemap.error(), "Failed to load error cubemap"));
-        errorCubemap = std::make_shared<Resource::ManagedTexture>(tmpCubemap.value());
+        errorCubemap = std::make_shared<Resource::ManagedTexture>(tmpCubemap.value(), GL_TEXTURE_CUBE_MAP);
 
         // SHADER
         const auto vertShaderID = Resource::Loading::loadGLShaderSource(
@@ -68,24 +155,50 @@ namespace Engine {
         if (scenes.contains(scenePath)) {
             if (scenes[scenePath].expired())
                 scenes.erase(scenePath);
-            else
+            else {
+                stats[ResourceType::SCENE].cacheHits++;
                 return scenes[scenePath].lock();
+            }
         }
+        stats[ResourceType::SCENE].cacheMisses++;
+
+        recordLoad(ResourceType::SCENE, scenePath);
+        LoadEvent event{ResourceType::SCENE, scenePath, 0.0, 0.0, false, false};
+        const auto waitStart = std::chrono::steady_clock::now();
+        const Expected<Resource::Loading::ImportedScene> imported = takePrefetched(prefetchedScenes, scenePath, event.prefetched,
+            [&] {
+                ScopedLoadTimer timer(*this, ResourceType::SCENE, LoadStage::DECODE);
+                return Resource::Loading::importScene(scenePath);
+            });
+        event.waitSeconds = secondsSince(waitStart);
 
-        std::expected<Resource::Scene, Error> scene = Resource::Loading::loadScene(scenePath);
+        // Includes loading the scene's textures and shaders, which are also timed on their own
+        const auto convertStart = std::chrono::steady_clock::now();
+        std::expected<Resource::Scene, Error> scene = imported.has_value()
+            ? Resource::Loading::loadScene(imported.value())
+            : std::unexpected(imported.error());
+        if (imported.has_value()) {
+            event.uploadSeconds = secondsSince(convertStart);
+            recordTiming(ResourceType::SCENE, LoadStage::UPLOAD, event.uploadSeconds);
+        }
         if (!scene.has_value()) {
             scenes[scenePath] = errorScene;  // Only error once, then use the error scene
             reportError(FW_ERROR(scene.error(), "Failed to load uncached scene"));
+            event.failed = true;
+            recordLoadEvent(std::move(event));
             return errorScene;
         }
         auto ptr = std::make_shared<Resource::Scene>(std::move(scene.value()));
         scenes[scenePath] = ptr;
+        recordLoadEvent(std::move(event));
         return ptr;
     }
 
     std::shared_ptr<Resource::ManagedTexture>
-    ResourceManager::loadTexture(const std::string& texturePath)
+    ResourceManager::loadTexture(const std::string& requestedPath)
     {
+        // Different spellings of the same path should not be loaded twice
+        const std::string texturePath = Pack::normalizePath(requestedPath);
         SPDLOG_DEBUG("Loading texture: {}", texturePath);
         if (errorTexture == nullptr || errorTexture->textureID == 0)
             throw std::runtime_error("Error texture is uninitialised or invalid. Refusing to proceed.");
@@ -93,25 +206,152 @@ namespace Engine {
         if (textures.contains(texturePath)) {
             if (textures[texturePath].expired())
                 textures.erase(texturePath);
-            else
+            else {
+                stats[ResourceType::TEXTURE].cacheHits++;
                 return textures[texturePath].lock();
+            }
         }
+        stats[ResourceType::TEXTURE].cacheMisses++;
 
-        std::expected<unsigned int, Error> textureID = Resource::Loading::loadTexture(texturePath.c_str());
+        recordLoad(ResourceType::TEXTURE, texturePath);
+        LoadEvent event{ResourceType::TEXTURE, texturePath, 0.0, 0.0, false, false};
+        const auto waitStart = std::chrono::steady_clock::now();
+        Expected<Resource::Loading::Image> image = takePrefetched(prefetchedTextures, texturePath, event.prefetched,
+            [&] {
+                ScopedLoadTimer timer(*this, ResourceType::TEXTURE, LoadStage::DECODE);
+                return Resource::Loading::decodeImage(texturePath, engineState->config.compressTextures);
+            });
+        event.waitSeconds = secondsSince(waitStart);
+        if (image.has_value()) {
+            const auto existing = texturesByContent.find(image->contentHash);
+            if (existing != texturesByContent.end() && !existing->second.expired()) {
+                SPDLOG_DEBUG("Texture \"{}\" is identical to an already loaded texture, sharing it", texturePath);
+                auto ptr = existing->second.lock();
+                textures[texturePath] = ptr;
+                stats[ResourceType::TEXTURE].contentShares++;
+                recordLoadEvent(std::move(event));
+                return ptr;
+            }
+        }
+        // Streamed textures start out with only their smallest levels, the rest follow once they are needed
+        const int initialSize = engineState->config.textureStreaming
+            ? engineState->config.textureStreamingInitialSize : std::numeric_limits<int>::max();
+        const auto uploadStart = std::chrono::steady_clock::now();
+        std::expected<unsigned int, Error> textureID = image.has_value()
+            ? Resource::Loading::uploadTexture(image.value(), initialSize)
+            : std::unexpected(image.error());
+        if (image.has_value()) {
+            event.uploadSeconds = secondsSince(uploadStart);
+            recordTiming(ResourceType::TEXTURE, LoadStage::UPLOAD, event.uploadSeconds);
+        }
         if (!textureID.has_value()) {
             textures[texturePath] = errorTexture;  // Only error once, then use the error texture
             reportError(FW_ERROR(textureID.error(), "Failed to load uncached texture"));
+            event.failed = true;
+            recordLoadEvent(std::move(event));
             return errorTexture;
         }
 
-        auto ptr = std::make_shared<Resource::ManagedTexture>(textureID.value());
+        auto ptr = std::make_shared<Resource::ManagedTexture>(textureID.value(), GL_TEXTURE_2D);
+        ptr->sourcePath = texturePath;
+        ptr->gpuBytes = Resource::getTextureMemoryUsage(ptr->textureID, ptr->target);
+        ptr->lastUsedFrame = frameIndex;
+        ptr->fullSize = std::max(image->width, image->height);
+        ptr->residentSize = Resource::Loading::getUploadedSize(image.value(), initialSize);
+        if (ptr->residentSize < ptr->fullSize)
+            ptr->residency = Resource::TextureResidency::DEMOTED;
         textures[texturePath] = ptr;
+        texturesByContent[image->contentHash] = ptr;
+        recordLoadEvent(std::move(event));
+        // Cache misses are uploaded as is, so loading never has to wait on the encoder
+        if (engineState->config.compressTextures && !image->blockFormat.has_value() && image->sourceHash != 0)
+            scheduleCompression(ptr, std::move(image.value()));
         return ptr;
     }
 
     std::shared_ptr<Resource::ManagedTexture>
-    ResourceManager::loadCubemap(const std::string& cubemapPath)
+    ResourceManager::createTexture(const std::string& name, const Resource::Loading::Image& image)
+    {
+        SPDLOG_DEBUG("Creating texture: {}", name);
+        const auto existing = texturesByContent.find(image.contentHash);
+        if (existing != texturesByContent.end() && !existing->second.expired()) {
+            auto ptr = existing->second.lock();
+            textures[name] = ptr;
+            stats[ResourceType::TEXTURE].contentShares++;
+            return ptr;
+        }
+
+        const auto uploadStart = std::chrono::steady_clock::now();
+        const std::expected<unsigned int, Error> textureID = Resource::Loading::uploadTexture(image);
+        if (!textureID.has_value()) {
+            reportError(FW_ERROR(textureID.error(), "Failed to create texture \"" + name + "\""));
+            stats[ResourceType::TEXTURE].failures++;
+            return errorTexture;
+        }
+        recordTiming(ResourceType::TEXTURE, LoadStage::UPLOAD, secondsSince(uploadStart));
+
+        auto ptr = std::make_shared<Resource::ManagedTexture>(textureID.value(), GL_TEXTURE_2D);
+        ptr->gpuBytes = Resource::getTextureMemoryUsage(ptr->textureID, ptr->target);
+        ptr->lastUsedFrame = frameIndex;
+        textures[name] = ptr;
+        texturesByContent[image.contentHash] = ptr;
+        return ptr;
+    }
+
+    void ResourceManager::scheduleCompression(const std::shared_ptr<Resource::ManagedTexture>& texture,
+                                              Resource::Loading::Image image)
+    {
+        const auto usage = BlockCompression::guessTextureUsage(texture->sourcePath);
+        pendingCompressions.push_back({texture, texture->textureID, engineState->threadPool.submit(
+            [image = std::move(image), usage]() -> Expected<Resource::Loading::Image> {
+                Expected<Resource::Loading::Image> compressed = Resource::Loading::compressImage(image, usage);
+                if (!compressed.has_value())
+                    return compressed;
+                // The compressed texture is still usable this session even if it can't be cached
+                if (const Expected<void> saved = Resource::Loading::saveToCompressionCache(compressed.value()); !saved.has_value())
+                    reportError(FW_ERROR(saved.error(), "Failed to cache compressed texture"));
+                return compressed;
+            })});
+    }
+
+    void ResourceManager::swapCompressedTextures()
+    {
+        std::erase_if(pendingCompressions, [this](PendingCompression& pending) {
+            if (pending.compressed.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+            const Expected<Resource::Loading::Image> compressed = pending.compressed.get();
+            const auto texture = pending.texture.lock();
+            if (!compressed.has_value()) {
+                reportError(FW_ERROR(compressed.error(), "Failed to compress texture \""
+                    + (texture != nullptr ? texture->sourcePath : std::string("<unloaded>")) + "\""));
+                return true;
+            }
+            if (texture == nullptr || texture->textureID != pending.uncompressedID
+                || texture->residency == Resource::TextureResidency::EVICTED)
+                return true;  // Not worth uploading, the next load finds it in the cache anyway
+
+            // Demoted and partially streamed in textures keep the levels they had
+            const std::expected<unsigned int, Error> textureID = Resource::Loading::uploadTexture(
+                compressed.value(), texture->residentSize);
+            if (!textureID.has_value()) {
+                reportError(FW_ERROR(textureID.error(), "Failed to upload compressed texture \"" + texture->sourcePath + "\""));
+                return true;
+            }
+            const size_t previousBytes = texture->gpuBytes;
+            glDeleteTextures(1, &texture->textureID);
+            texture->textureID = textureID.value();
+            texture->gpuBytes = Resource::getTextureMemoryUsage(texture->textureID, texture->target);
+            texture->residentSize = Resource::Loading::getUploadedSize(compressed.value(), texture->residentSize);
+            SPDLOG_DEBUG("Swapped in compressed texture \"{}\" ({} -> {} bytes)",
+                texture->sourcePath, previousBytes, texture->gpuBytes);
+            return true;
+        });
+    }
+
+    std::shared_ptr<Resource::ManagedTexture>
+    ResourceManager::loadCubemap(const std::string& requestedPath)
     {
+        const std::string cubemapPath = Pack::normalizePath(requestedPath);
         SPDLOG_DEBUG("Loading cubemap: {}", cubemapPath);
         if (errorCubemap == nullptr || errorCubemap->textureID == 0)
             throw std::runtime_error("Error cubemap is uninitialised or invalid. Refusing to proceed.");
@@ -121,19 +361,59 @@ namespace Engine {
         if (textures.contains(cubemapPath)) {
             if (textures[cubemapPath].expired())
                 textures.erase(cubemapPath);
-            else
+            else {
+                stats[ResourceType::CUBEMAP].cacheHits++;
                 return textures[cubemapPath].lock();
+            }
         }
+        stats[ResourceType::CUBEMAP].cacheMisses++;
 
-        std::expected<unsigned int, Error> cubemapID = Resource::Loading::loadCubemap(cubemapPath);
+        recordLoad(ResourceType::CUBEMAP, cubemapPath);
+        LoadEvent event{ResourceType::CUBEMAP, cubemapPath, 0.0, 0.0, false, false};
+        const auto waitStart = std::chrono::steady_clock::now();
+        const Expected<std::array<Resource::Loading::Image, 6>> faces = takePrefetched(prefetchedCubemaps, cubemapPath, event.prefetched,
+            [&] {
+                ScopedLoadTimer timer(*this, ResourceType::CUBEMAP, LoadStage::DECODE);
+                return Resource::Loading::decodeCubemap(cubemapPath);
+            });
+        event.waitSeconds = secondsSince(waitStart);
+        uint64_t contentHash = GL_TEXTURE_CUBE_MAP;  // Never equal to a 2D texture with the same data
+        if (faces.has_value()) {
+            for (const auto& face : faces.value())
+                contentHash = xxh64(&face.contentHash, sizeof(face.contentHash), contentHash);
+            const auto existing = texturesByContent.find(contentHash);
+            if (existing != texturesByContent.end() && !existing->second.expired()) {
+                SPDLOG_DEBUG("Cubemap \"{}\" is identical to an already loaded cubemap, sharing it", cubemapPath);
+                auto ptr = existing->second.lock();
+                textures[cubemapPath] = ptr;
+                stats[ResourceType::CUBEMAP].contentShares++;
+                recordLoadEvent(std::move(event));
+                return ptr;
+            }
+        }
+        const auto uploadStart = std::chrono::steady_clock::now();
+        std::expected<unsigned int, Error> cubemapID = faces.has_value()
+            ? Resource::Loading::uploadCubemap(faces.value())
+            : std::unexpected(faces.error());
+        if (faces.has_value()) {
+            event.uploadSeconds = secondsSince(uploadStart);
+            recordTiming(ResourceType::CUBEMAP, LoadStage::UPLOAD, event.uploadSeconds);
+        }
         if (!cubemapID.has_value()) {
             textures[cubemapPath] = errorCubemap;  // Only error once, then use the error cubemap
             reportError(FW_ERROR(cubemapID.error(), "Failed to load uncached cubemap"));
+            event.failed = true;
+            recordLoadEvent(std::move(event));
             return errorCubemap;
         }
 
-        auto ptr = std::make_shared<Resource::ManagedTexture>(cubemapID.value());
+        auto ptr = std::make_shared<Resource::ManagedTexture>(cubemapID.value(), GL_TEXTURE_CUBE_MAP);
+        ptr->sourcePath = cubemapPath;
+        ptr->gpuBytes = Resource::getTextureMemoryUsage(ptr->textureID, ptr->target);
+        ptr->lastUsedFrame = frameIndex;
         textures[cubemapPath] = ptr;
+        texturesByContent[contentHash] = ptr;
+        recordLoadEvent(std::move(event));
         return ptr;
     }
 
@@ -151,28 +431,89 @@ namespace Engine {
         if (this->shaders.contains(jointPath)) {
             if (this->shaders[jointPath].expired())
                 this->shaders.erase(jointPath);
-            else
+            else {
+                stats[ResourceType::SHADER].cacheHits++;
                 return this->shaders[jointPath].lock();
+            }
         }
+        stats[ResourceType::SHADER].cacheMisses++;
 
+        // One event for the whole program, it only counts as prefetched if every stage was
+        LoadEvent event{ResourceType::SHADER, fmt::format("{}", fmt::join(shaders | std::views::values, " & ")),
+            0.0, 0.0, true, false};
         std::vector<unsigned int> shaderIDs;
         shaderIDs.reserve(shaders.size());
         for (const auto& [type, path] : shaders) {
-            std::expected<unsigned int, Error> shaderID = Resource::Loading::loadGLShaderFile(path, type);
+            recordLoad(ResourceType::SHADER, path);
+            bool stagePrefetched = false;
+            const auto waitStart = std::chrono::steady_clock::now();
+            const Expected<std::string> shaderSrc = takePrefetched(prefetchedShaderSources, path, stagePrefetched,
+                [&] {
+                    ScopedLoadTimer timer(*this, ResourceType::SHADER, LoadStage::DECODE);
+                    return Resource::Loading::loadShaderSourceFile(path);
+                });
+            event.waitSeconds += secondsSince(waitStart);
+            event.prefetched &= stagePrefetched;
+
+            const auto compileStart = std::chrono::steady_clock::now();
+            std::expected<unsigned int, Error> shaderID = shaderSrc.has_value()
+                ? Resource::Loading::compileGLShader(shaderSrc.value(), type)
+                : std::unexpected(shaderSrc.error());
+            event.uploadSeconds += secondsSince(compileStart);
             if (!shaderID.has_value()) {
                 this->shaders[jointPath] = errorShader;  // Only error once, then use the error shader
                 reportError(FW_ERROR(shaderID.error(), "Failed to load uncached shader"));
+                event.failed = true;
+                recordLoadEvent(std::move(event));
                 return errorShader;
             }
             shaderIDs.push_back(shaderID.value());
         }
 
+        const auto linkStart = std::chrono::steady_clock::now();
         auto ptr = std::make_shared<Resource::Shader>(shaderIDs);
+        event.uploadSeconds += secondsSince(linkStart);
+        recordTiming(ResourceType::SHADER, LoadStage::UPLOAD, event.uploadSeconds);
         this->shaders[jointPath] = ptr;
+        recordLoadEvent(std::move(event));
         return ptr;
     }
 
 
+    std::shared_ptr<Resource::MeshBuffers>
+    ResourceManager::loadMeshBuffers(const std::span<const Resource::MeshVertex> vertices, const std::span<const unsigned int> indices)
+    {
+        return loadMeshBuffers(Resource::stageMeshBuffers(vertices, indices, getMeshVertexFormat()));
+    }
+
+    std::shared_ptr<Resource::MeshBuffers> ResourceManager::loadMeshBuffers(const Resource::StagedMeshBuffers& staged)
+    {
+        const auto existing = meshBuffers.find(staged.contentHash);
+        if (existing != meshBuffers.end()) {
+            auto ptr = existing->second.lock();
+            if (ptr && ptr->vertexCount == staged.vertices.size() && ptr->indexCount == staged.indices.size()) {
+                SPDLOG_TRACE("Sharing buffers of identical mesh ({} vertices, {} indices)", staged.vertices.size(), staged.indices.size());
+                stats.meshBuffers.contentShares++;
+                return ptr;
+            }
+        }
+        stats.meshBuffers.cacheMisses++;
+
+        const auto uploadStart = std::chrono::steady_clock::now();
+        auto ptr = std::make_shared<Resource::MeshBuffers>(staged);
+        {
+            std::lock_guard lock(statsMutex);
+            stats.meshBuffers.uploadTime.record(secondsSince(uploadStart));
+        }
+        meshBuffers[staged.contentHash] = ptr;
+        return ptr;
+    }
+
+    Resource::VertexFormat ResourceManager::getMeshVertexFormat()
+    {
+        return engineState->config.packVertices ? Resource::VertexFormat::PACKED : Resource::VertexFormat::FULL;
+    }
+
     std::shared_ptr<Resource::Shader> ResourceManager::loadShader(std::string computePath)
     { return loadShader({
         {Resource::ShaderType::COMPUTE, computePath} }); }
@@ -187,4 +528,469 @@ namespace Engine {
         {Resource::ShaderType::VERTEX, vertexPath},
         {Resource::ShaderType::GEOMETRY, geometryPath},
         {Resource::ShaderType::FRAGMENT, fragmentPath}}); }
+
+    void ResourceManager::setStreamingView(const glm::vec3& cameraPosition, const float pixelsPerUnit)
+    {
+        streamingCameraPosition = cameraPosition;
+        streamingPixelsPerUnit = pixelsPerUnit;
+    }
+
+    int ResourceManager::getRequestedTextureSize(const glm::mat4& modelTransform, const glm::vec3& boundsMin,
+                                                 const glm::vec3& boundsMax, const float uvDensity) const
+    {
+        constexpr int UNKNOWN = std::numeric_limits<int>::max();
+        if (streamingPixelsPerUnit <= 0.0f || uvDensity <= 0.0f)
+            return UNKNOWN;
+        // A bounding sphere is plenty, the result is rounded to a whole mip level anyway
+        const float scale = std::max({
+            glm::length(glm::vec3(modelTransform[0])),
+            glm::length(glm::vec3(modelTransform[1])),
+            glm::length(glm::vec3(modelTransform[2])),
+        });
+        const glm::vec3 center = glm::vec3(modelTransform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        const float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+        const float distance = glm::length(center - streamingCameraPosition) - radius;
+        if (distance <= 0.0f || scale <= 0.0f)
+            return UNKNOWN;
+
+        // One texture coordinate unit spans the whole texture, and this many pixels on screen at the closest point
+        const double pixelsPerUv = static_cast<double>(streamingPixelsPerUnit) * scale / (distance * uvDensity);
+        return static_cast<int>(std::min(std::ceil(pixelsPerUv), static_cast<double>(UNKNOWN)));
+    }
+
+    unsigned int ResourceManager::useTexture(const std::shared_ptr<Resource::ManagedTexture>& texture, const int requestedSize)
+    {
+        if (texture == nullptr)
+            return errorTexture->textureID;
+        // The first use in a frame starts the request over
+        if (texture->lastUsedFrame != frameIndex)
+            texture->requestedSize = 0;
+        texture->lastUsedFrame = frameIndex;
+        texture->requestedSize = std::max(texture->requestedSize, requestedSize);
+        if (texture->residency == Resource::TextureResidency::RESIDENT)
+            return texture->textureID;
+        // endFrame() streams in the levels it is missing, the smaller ones do until then
+        if (texture->residency == Resource::TextureResidency::DEMOTED && engineState->config.textureStreaming
+            && texture->fullSize > 0)
+            return texture->textureID;
+
+        Expected<void> result = reloadTexture(*texture);
+        if (!result.has_value()) {
+            reportError(FW_ERROR(result.error(), "Failed to reload evicted texture"));
+            texture->sourcePath.clear();  // Only error once, then use the error texture
+            texture->residency = Resource::TextureResidency::RESIDENT;
+        }
+        if (texture->textureID == 0)
+            return texture->target == GL_TEXTURE_CUBE_MAP ? errorCubemap->textureID : errorTexture->textureID;
+        return texture->textureID;
+    }
+
+    Expected<void> ResourceManager::reloadTexture(Resource::ManagedTexture& texture) const
+    {
+        SPDLOG_DEBUG("Reloading {} texture: {}",
+            texture.residency == Resource::TextureResidency::EVICTED ? "evicted" : "demoted", texture.sourcePath);
+        if (texture.sourcePath.empty())
+            return std::unexpected(ERROR("Texture has no source path to reload from"));
+
+        std::expected<unsigned int, Error> textureID;
+        Resource::TextureResidency residency = Resource::TextureResidency::RESIDENT;
+        if (texture.target == GL_TEXTURE_CUBE_MAP)
+            textureID = Resource::Loading::loadCubemap(texture.sourcePath);
+        else {
+            // Picks up the compressed copy if the texture finished compressing before it was evicted
+            const Expected<Resource::Loading::Image> image = Resource::Loading::decodeImage(
+                texture.sourcePath, engineState->config.compressTextures);
+            // Streamed textures only come back as large as they were asked to be this frame
+            const int maxSize = engineState->config.textureStreaming && texture.fullSize > 0
+                ? getStreamingTargetSize(texture) : std::numeric_limits<int>::max();
+            textureID = image.has_value()
+                ? Resource::Loading::uploadTexture(image.value(), maxSize)
+                : std::unexpected(image.error());
+            if (textureID.has_value()) {
+                texture.fullSize = std::max(image->width, image->height);
+                texture.residentSize = Resource::Loading::getUploadedSize(image.value(), maxSize);
+                if (texture.residentSize < texture.fullSize)
+                    residency = Resource::TextureResidency::DEMOTED;
+            }
+        }
+        if (!textureID.has_value())
+            return std::unexpected(FW_ERROR(textureID.error(), "Failed to load texture \"" + texture.sourcePath + "\""));
+
+        glDeleteTextures(1, &texture.textureID);
+        texture.textureID = textureID.value();
+        texture.gpuBytes = Resource::getTextureMemoryUsage(texture.textureID, texture.target);
+        texture.residency = residency;
+        return {};
+    }
+
+    void ResourceManager::scheduleStreaming()
+    {
+        std::vector<std::shared_ptr<Resource::ManagedTexture>> candidates;
+        std::unordered_set<const Resource::ManagedTexture*> seen;  // Several paths may share one texture
+        for (const auto& pending : pendingStreams)
+            seen.insert(pending.texture.lock().get());
+        for (const auto& [path, weakTexture] : textures) {
+            auto texture = weakTexture.lock();
+            if (texture->residency != Resource::TextureResidency::DEMOTED || texture->sourcePath.empty()
+                || texture->fullSize == 0 || texture->lastUsedFrame != frameIndex
+                || getStreamingTargetSize(*texture) <= texture->residentSize || !seen.insert(texture.get()).second)
+                continue;
+            candidates.push_back(std::move(texture));
+        }
+        // The textures furthest from the size they were requested at go first
+        std::ranges::sort(candidates, std::ranges::greater{}, [](const auto& texture) {
+            return static_cast<double>(getStreamingTargetSize(*texture)) / texture->residentSize;
+        });
+
+        const size_t budget = engineState->config.textureMemoryBudget;
+        size_t projectedUsage = textureMemoryUsage;
+        for (const auto& texture : candidates) {
+            if (pendingStreams.size() >= MAX_PENDING_STREAMS)
+                return;
+            const int targetSize = getStreamingTargetSize(*texture);
+            // Every level is about four times the size of the one below it
+            const double scale = static_cast<double>(targetSize) / texture->residentSize;
+            const auto projectedBytes = static_cast<size_t>(static_cast<double>(texture->gpuBytes) * scale * scale);
+            if (budget > 0 && projectedUsage - texture->gpuBytes + projectedBytes > budget)
+                continue;  // It would only be shrunk again the next frame
+            projectedUsage += projectedBytes - texture->gpuBytes;
+            SPDLOG_TRACE("Streaming in texture \"{}\" at {}px, from {}px", texture->sourcePath, targetSize, texture->residentSize);
+            pendingStreams.push_back({texture, texture->textureID, targetSize, engineState->threadPool.submit(
+                [path = texture->sourcePath, compressed = engineState->config.compressTextures] {
+                    return Resource::Loading::decodeImage(path, compressed);
+                })});
+        }
+    }
+
+    void ResourceManager::uploadStreamedTextures()
+    {
+        std::erase_if(pendingStreams, [this](PendingStream& pending) {
+            if (pending.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+            const Expected<Resource::Loading::Image> image = pending.image.get();
+            const auto texture = pending.texture.lock();
+            if (!image.has_value()) {
+                reportError(FW_ERROR(image.error(), "Failed to stream in texture \""
+                    + (texture != nullptr ? texture->sourcePath : std::string("<unloaded>")) + "\""));
+                return true;
+            }
+            if (texture == nullptr || texture->textureID != pending.residentID)
+                return true;
+
+            const auto uploadStart = std::chrono::steady_clock::now();
+            const std::expected<unsigned int, Error> textureID = Resource::Loading::uploadTexture(
+                image.value(), pending.targetSize);
+            if (!textureID.has_value()) {
+                reportError(FW_ERROR(textureID.error(), "Failed to upload streamed texture \"" + texture->sourcePath + "\""));
+                return true;
+            }
+            recordTiming(ResourceType::TEXTURE, LoadStage::UPLOAD, secondsSince(uploadStart));
+            // A compression still in progress can swap in over the larger texture just the same
+            for (PendingCompression& compression : pendingCompressions)
+                if (compression.uncompressedID == texture->textureID)
+                    compression.uncompressedID = textureID.value();
+
+            glDeleteTextures(1, &texture->textureID);
+            texture->textureID = textureID.value();
+            texture->gpuBytes = Resource::getTextureMemoryUsage(texture->textureID, texture->target);
+            texture->fullSize = std::max(image->width, image->height);
+            texture->residentSize = Resource::Loading::getUploadedSize(image.value(), pending.targetSize);
+            texture->residency = texture->residentSize < texture->fullSize
+                ? Resource::TextureResidency::DEMOTED : Resource::TextureResidency::RESIDENT;
+            return true;
+        });
+    }
+
+    void ResourceManager::endFrame()
+    {
+        swapCompressedTextures();
+        uploadStreamedTextures();
+        std::erase_if(textures, [](const auto& entry) { return entry.second.expired(); });
+        std::erase_if(texturesByContent, [](const auto& entry) { return entry.second.expired(); });
+        std::erase_if(meshBuffers, [](const auto& entry) { return entry.second.expired(); });
+        textureMemoryUsage = 0;
+        for (const auto& [path, weakTexture] : textures) {
+            const auto texture = weakTexture.lock();
+            if (texture != errorTexture && texture != errorCubemap)  // Several paths may point to the error textures
+                textureMemoryUsage += texture->gpuBytes;
+        }
+
+        if (engineState->config.textureMemoryBudget > 0 && textureMemoryUsage > engineState->config.textureMemoryBudget)
+            enforceTextureBudget(engineState->config.textureMemoryBudget);
+        else
+            warnedOverBudget = false;
+        if (engineState->config.textureStreaming)
+            scheduleStreaming();
+        frameIndex++;
+    }
+
+    void ResourceManager::enforceTextureBudget(const size_t budget)
+    {
+        // Levels larger than anything was drawn at last frame can go before anything that is actually visible
+        if (engineState->config.textureStreaming) {
+            for (const auto& [path, weakTexture] : textures) {
+                if (textureMemoryUsage <= budget)
+                    return;
+                const auto texture = weakTexture.lock();
+                if (texture->sourcePath.empty() || texture->fullSize == 0 || texture->lastUsedFrame != frameIndex
+                    || texture->residency == Resource::TextureResidency::EVICTED)
+                    continue;
+                const int targetSize = getStreamingTargetSize(*texture);
+                const size_t previousBytes = texture->gpuBytes;
+                if (targetSize < texture->residentSize && Resource::demoteTexture(*texture, targetSize)) {
+                    textureMemoryUsage -= previousBytes - texture->gpuBytes;
+                    SPDLOG_TRACE("Shrunk texture \"{}\" to its requested size ({} -> {} bytes)",
+                        texture->sourcePath, previousBytes, texture->gpuBytes);
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<Resource::ManagedTexture>> candidates;
+        for (const auto& [path, weakTexture] : textures) {
+            auto texture = weakTexture.lock();
+            if (texture->sourcePath.empty() || texture->lastUsedFrame >= frameIndex
+                || texture->residency == Resource::TextureResidency::EVICTED)
+                continue;
+            candidates.push_back(std::move(texture));
+        }
+        std::ranges::sort(candidates, {}, &Resource::ManagedTexture::lastUsedFrame);
+
+        // Demoting first keeps something resembling the texture around while freeing most of its memory
+        const int demotionSize = engineState->config.textureDemotionSize;
+        if (demotionSize > 0) {
+            for (const auto& texture : candidates) {
+                if (textureMemoryUsage <= budget)
+                    return;
+                if (texture->residency != Resource::TextureResidency::RESIDENT)
+                    continue;
+                const size_t previousBytes = texture->gpuBytes;
+                if (Resource::demoteTexture(*texture, demotionSize)) {
+                    textureMemoryUsage -= previousBytes - texture->gpuBytes;
+                    SPDLOG_TRACE("Demoted texture \"{}\" ({} -> {} bytes)", texture->sourcePath, previousBytes, texture->gpuBytes);
+                }
+            }
+        }
+
+        for (const auto& texture : candidates) {
+            if (textureMemoryUsage <= budget)
+                return;
+            glDeleteTextures(1, &texture->textureID);
+            texture->textureID = 0;
+            textureMemoryUsage -= texture->gpuBytes;
+            texture->gpuBytes = 0;
+            texture->residency = Resource::TextureResidency::EVICTED;
+            SPDLOG_TRACE("Evicted texture \"{}\"", texture->sourcePath);
+        }
+        if (textureMemoryUsage > budget && !warnedOverBudget) {
+            SPDLOG_WARN("Textures used within a single frame exceed the texture memory budget ({} > {} bytes)",
+                textureMemoryUsage, budget);
+            warnedOverBudget = true;
+        }
+    }
+
+    void ResourceManager::recordTiming(const ResourceType type, const LoadStage stage, const double seconds)
+    {
+        std::lock_guard lock(statsMutex);
+        ResourceTypeStats& typeStats = stats[type];
+        (stage == LoadStage::DECODE ? typeStats.decodeTime : typeStats.uploadTime).record(seconds);
+    }
+
+    void ResourceManager::recordLoadEvent(LoadEvent event)
+    {
+        SPDLOG_TRACE("Loaded {} \"{}\" in {:.2f} ms ({:.2f} ms waiting{}, {:.2f} ms uploading)",
+            resourceTypeNames[static_cast<size_t>(event.type)].second, event.path,
+            (event.waitSeconds + event.uploadSeconds) * 1000.0, event.waitSeconds * 1000.0,
+            event.prefetched ? " on prefetch" : "", event.uploadSeconds * 1000.0);
+        ResourceTypeStats& typeStats = stats[event.type];
+        if (event.prefetched)
+            typeStats.prefetchHits++;
+        if (event.failed)
+            typeStats.failures++;
+
+        std::lock_guard lock(statsMutex);
+        recentLoads.push_back(std::move(event));
+        if (recentLoads.size() > MAX_RECENT_LOADS)
+            recentLoads.pop_front();
+    }
+
+    ResourceStats ResourceManager::getStats() const
+    {
+        ResourceStats snapshot;
+        {
+            std::lock_guard lock(statsMutex);
+            snapshot = stats;
+            snapshot.recentLoads.assign(recentLoads.begin(), recentLoads.end());
+        }
+
+        // Several paths can point to the same object, so only count each one once
+        std::unordered_set<const void*> counted;
+        for (const auto& weakShader : shaders | std::views::values) {
+            const auto shader = weakShader.lock();
+            if (shader == nullptr || shader == errorShader || !counted.insert(shader.get()).second)
+                continue;
+            // Drivers don't expose how much memory a program takes up
+            snapshot[ResourceType::SHADER].liveObjects++;
+        }
+        for (const auto& weakTexture : textures | std::views::values) {
+            const auto texture = weakTexture.lock();
+            if (texture == nullptr || texture == errorTexture || texture == errorCubemap
+                || !counted.insert(texture.get()).second)
+                continue;
+            ResourceTypeStats& typeStats = snapshot[texture->target == GL_TEXTURE_CUBE_MAP
+                ? ResourceType::CUBEMAP : ResourceType::TEXTURE];
+            typeStats.liveObjects++;
+            typeStats.gpuBytes += texture->gpuBytes;
+        }
+        for (const auto& weakScene : scenes | std::views::values) {
+            const auto scene = weakScene.lock();
+            if (scene == nullptr || scene == errorScene || !counted.insert(scene.get()).second)
+                continue;
+            ResourceTypeStats& typeStats = snapshot[ResourceType::SCENE];
+            typeStats.liveObjects++;
+            typeStats.cpuBytes += scene->graph.getAllocatedBytes();
+            // Meshes keep a CPU copy of their geometry, the GPU side is counted under the mesh buffers
+            for (const Resource::Mesh& mesh : scene->meshes)
+                typeStats.cpuBytes += mesh.vertices.capacity() * sizeof(Resource::MeshVertex)
+                    + mesh.indices.capacity() * sizeof(unsigned int);
+        }
+        for (const auto& weakBuffers : meshBuffers | std::views::values) {
+            const auto buffers = weakBuffers.lock();
+            if (buffers == nullptr)
+                continue;
+            snapshot.meshBuffers.liveObjects++;
+            snapshot.meshBuffers.gpuBytes += buffers->gpuBytes;
+        }
+        return snapshot;
+    }
+
+    void ResourceManager::resetStats()
+    {
+        std::lock_guard lock(statsMutex);
+        stats = {};
+        recentLoads.clear();
+    }
+
+    void ResourceManager::recordLoad(const ResourceType type, const std::string& path)
+    {
+        const std::string key = std::to_string(static_cast<int>(type)) + path;
+        if (recordedLoads.insert(key).second)
+            loadOrder.emplace_back(type, path);
+    }
+
+    Expected<void> ResourceManager::saveLoadManifest(const std::string& manifestPath) const
+    {
+        std::ofstream file(manifestPath);
+        if (!file.is_open())
+            return std::unexpected(ERROR("Failed to open load manifest for writing: " + manifestPath));
+        for (const auto& [type, path] : loadOrder) {
+            const auto name = std::ranges::find(resourceTypeNames, type, &std::pair<ResourceType, std::string_view>::first);
+            file << name->second << ' ' << path << '\n';
+        }
+        if (!file)
+            return std::unexpected(ERROR("Failed to write load manifest: " + manifestPath));
+        SPDLOG_DEBUG("Wrote {} entries to load manifest \"{}\"", loadOrder.size(), manifestPath);
+        return {};
+    }
+
+    Expected<void> ResourceManager::prefetch(const std::string& manifestPath)
+    {
+        std::ifstream file(manifestPath);
+        if (!file.is_open())
+            return std::unexpected(ERROR("Failed to open load manifest: " + manifestPath));
+
+        ThreadPool& threadPool = engineState->threadPool;
+        size_t prefetchCount = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            // Format: <type> <path>, where the path may contain spaces
+            const auto separator = line.find(' ');
+            if (separator == std::string::npos)
+                continue;
+            const std::string_view typeName = std::string_view(line).substr(0, separator);
+            std::string path = line.substr(separator + 1);
+            const auto type = std::ranges::find(resourceTypeNames, typeName, &std::pair<ResourceType, std::string_view>::second);
+            if (type == resourceTypeNames.end()) {
+                SPDLOG_WARN("Unknown resource type \"{}\" in load manifest", typeName);
+                continue;
+            }
+
+            switch (type->first) {
+                case ResourceType::SHADER:
+                    if (!prefetchedShaderSources.contains(path))
+                        prefetchedShaderSources[path] = threadPool.submit(
+                            [this, path] {
+                                ScopedLoadTimer timer(*this, ResourceType::SHADER, LoadStage::DECODE);
+                                return Resource::Loading::loadShaderSourceFile(path);
+                            });
+                    break;
+                case ResourceType::TEXTURE:
+                    prefetchTextures({&path, 1});
+                    break;
+                case ResourceType::CUBEMAP:
+                    if (!prefetchedCubemaps.contains(path))
+                        prefetchedCubemaps[path] = threadPool.submit(
+                            [this, path] {
+                                ScopedLoadTimer timer(*this, ResourceType::CUBEMAP, LoadStage::DECODE);
+                                return Resource::Loading::decodeCubemap(path);
+                            });
+                    break;
+                case ResourceType::SCENE:
+                    prefetchScene(path);
+                    break;
+            }
+            prefetchCount++;
+        }
+        SPDLOG_DEBUG("Prefetching {} resources on {} threads", prefetchCount, threadPool.getThreadCount());
+        return {};
+    }
+
+    void ResourceManager::prefetchTextures(const std::span<const std::string> texturePaths)
+    {
+        for (const std::string& path : texturePaths) {
+            if (prefetchedTextures.contains(path))
+                continue;
+            if (const auto loaded = textures.find(path); loaded != textures.end() && !loaded->second.expired())
+                continue;
+            prefetchedTextures[path] = engineState->threadPool.submit(
+                [this, path, compress = engineState->config.compressTextures] {
+                    ScopedLoadTimer timer(*this, ResourceType::TEXTURE, LoadStage::DECODE);
+                    return Resource::Loading::decodeImage(path, compress);
+                });
+        }
+    }
+
+    void ResourceManager::prefetchScene(const std::string& scenePath)
+    {
+        if (prefetchedScenes.contains(scenePath))
+            return;
+        if (const auto loaded = scenes.find(scenePath); loaded != scenes.end() && !loaded->second.expired())
+            return;
+        prefetchedScenes[scenePath] = engineState->threadPool.submit(
+            [this, scenePath] {
+                ScopedLoadTimer timer(*this, ResourceType::SCENE, LoadStage::DECODE);
+                return Resource::Loading::importScene(scenePath);
+            });
+    }
+
+    bool ResourceManager::isSceneReady(const std::string& scenePath) const
+    {
+        if (const auto loaded = scenes.find(scenePath); loaded != scenes.end() && !loaded->second.expired())
+            return true;
+        const auto prefetched = prefetchedScenes.find(scenePath);
+        return prefetched != prefetchedScenes.end()
+            && prefetched->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void ResourceManager::discardScenePrefetch(const std::string& scenePath)
+    {
+        std::erase_if(discardedScenes, [](const auto& future) {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+        const auto prefetched = prefetchedScenes.find(scenePath);
+        if (prefetched == prefetchedScenes.end())
+            return;
+        if (prefetched->second.valid())
+            discardedScenes.push_back(std::move(prefetched->second));
+        prefetchedScenes.erase(prefetched);
+    }
 }
@@ -1,20 +1,126 @@
 #pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "engine/resources/scene.h"
 #include "engine/resources/shader.h"
 #include "engine/resources/texture.h"
 
 namespace Engine {
+    enum class ResourceType {
+        SHADER,
+        TEXTURE,
+        CUBEMAP,
+        SCENE,
+    };
+    constexpr size_t RESOURCE_TYPE_COUNT = 4;
+
+    /*! Histogram of durations with power of two buckets, bucket `i` covering [2^i, 2^(i+1)) microseconds. */
+    struct TimingHistogram {
+        static constexpr size_t BUCKET_COUNT = 24;  // Anything above ~16 seconds ends up in the last bucket
+        std::array<uint32_t, BUCKET_COUNT> buckets{};
+        uint32_t count = 0;
+        double totalSeconds = 0.0;
+        double maxSeconds = 0.0;
+
+        void record(double seconds);
+        [[nodiscard]] double meanSeconds() const { return count > 0 ? totalSeconds / count : 0.0; }
+    };
+
+    struct ResourceTypeStats {
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t prefetchHits = 0;   // Misses where prefetch() had already done the CPU side work
+        uint64_t contentShares = 0;  // Misses that turned out identical to an already loaded resource
+        uint64_t failures = 0;
+        size_t liveObjects = 0;
+        size_t cpuBytes = 0;
+        size_t gpuBytes = 0;
+        TimingHistogram decodeTime{};  // Reading and decoding files, or importing them for scenes
+        TimingHistogram uploadTime{};  // Creating OpenGL objects, or converting the imported data for scenes
+    };
+
+    /*! A single uncached load, as seen from the thread that requested it. */
+    struct LoadEvent {
+        ResourceType type;
+        std::string path;
+        double waitSeconds;    // Time spent decoding, or waiting for a prefetch to finish
+        double uploadSeconds;
+        bool prefetched;
+        bool failed;
+    };
+
+    struct ResourceStats {
+        std::array<ResourceTypeStats, RESOURCE_TYPE_COUNT> types{};
+        ResourceTypeStats meshBuffers{};  // Shared vertex and index buffers, created while converting scenes
+        std::vector<LoadEvent> recentLoads{};  // Oldest first
+
+        [[nodiscard]] ResourceTypeStats& operator[](const ResourceType type) { return types[static_cast<size_t>(type)]; }
+        [[nodiscard]] const ResourceTypeStats& operator[](const ResourceType type) const { return types[static_cast<size_t>(type)]; }
+    };
+
     class ResourceManager {
         // TODO: Hot reloading
     private:
         std::unordered_map<std::string, std::weak_ptr<Resource::Shader>> shaders{};
         std::unordered_map<std::string, std::weak_ptr<Resource::ManagedTexture>> textures{};
         std::unordered_map<std::string, std::weak_ptr<Resource::Scene>> scenes{};
+        // Content hash lookups, so identical data loaded through different paths shares one GPU object
+        std::unordered_map<uint64_t, std::weak_ptr<Resource::ManagedTexture>> texturesByContent{};
+        std::unordered_map<uint64_t, std::weak_ptr<Resource::MeshBuffers>> meshBuffers{};
+
+        template<typename T>
+        using PrefetchMap = std::unordered_map<std::string, std::future<Expected<T>>>;
+        // CPU side work started ahead of time by prefetch(), claimed by the matching load call
+        PrefetchMap<std::string> prefetchedShaderSources{};  // Keyed by the path of a single stage
+        PrefetchMap<Resource::Loading::Image> prefetchedTextures{};
+        PrefetchMap<std::array<Resource::Loading::Image, 6>> prefetchedCubemaps{};
+        PrefetchMap<Resource::Loading::ImportedScene> prefetchedScenes{};
+        // Scene prefetches dropped by discardScenePrefetch(), kept until they finish as they report back to the manager
+        std::vector<std::future<Expected<Resource::Loading::ImportedScene>>> discardedScenes{};
+
+        // Uncompressed textures being block compressed on worker threads, swapped in by endFrame() once done
+        struct PendingCompression {
+            std::weak_ptr<Resource::ManagedTexture> texture;
+            unsigned int uncompressedID;  // Skips the swap if the texture was demoted or reloaded in the meantime
+            std::future<Expected<Resource::Loading::Image>> compressed;
+        };
+        std::vector<PendingCompression> pendingCompressions{};
+        // Demoted textures having their larger mip levels decoded on worker threads, uploaded by endFrame() once done
+        struct PendingStream {
+            std::weak_ptr<Resource::ManagedTexture> texture;
+            unsigned int residentID;  // Skips the upload if the texture was demoted or reloaded in the meantime
+            int targetSize;
+            std::future<Expected<Resource::Loading::Image>> image;
+        };
+        std::vector<PendingStream> pendingStreams{};
+        // What the textures requested during a frame are seen through, see setStreamingView()
+        glm::vec3 streamingCameraPosition{};
+        float streamingPixelsPerUnit = 0.0f;
+
+        // Every resource loaded this session, in the order it was first loaded
+        std::vector<std::pair<ResourceType, std::string>> loadOrder{};
+        std::unordered_set<std::string> recordedLoads{};
+
+        uint64_t frameIndex = 0;
+        size_t textureMemoryUsage = 0;
+        bool warnedOverBudget = false;
+
+        // Decode timings are recorded from worker threads during prefetching
+        mutable std::mutex statsMutex{};
+        ResourceStats stats{};
+        std::deque<LoadEvent> recentLoads{};
     public:
         std::shared_ptr<Resource::Shader> errorShader;
         std::shared_ptr<Resource::ManagedTexture> errorTexture;
@@ -27,6 +133,10 @@ namespace Engine {
          *       You must call \ref populateErrorResources() "populateErrorResources()" to load the error resources.
          */
         ResourceManager();
+        /*! @brief Waits for outstanding prefetches and compressions, as they report back to the manager. */
+        ~ResourceManager();
+        ResourceManager(const ResourceManager&) = delete;
+        ResourceManager& operator=(const ResourceManager&) = delete;
         /*!
          * @brief Loads the error resources into the resource manager.
          * @note This can not be called before the constructor, as it requires an already constructed resource manager to construct some resources.
@@ -49,9 +159,127 @@ namespace Engine {
         loadTexture(const std::string &texturePath);
         [[nodiscard]] std::shared_ptr<Resource::ManagedTexture>
         loadCubemap(const std::string &cubemapPath);
+        /*!
+         * @brief Uploads a texture made at runtime, such as an atlas, and tracks its memory like any loaded texture.
+         * @details Textures with identical content share a single instance.
+         *          They have no source to reload from, so they are never demoted or evicted.
+         * @param name Identifies the texture in logs, must not collide with any file path.
+         */
+        [[nodiscard]] std::shared_ptr<Resource::ManagedTexture>
+        createTexture(const std::string& name, const Resource::Loading::Image& image);
 
         // Scene
         [[nodiscard]] std::shared_ptr<Resource::Scene>
         loadScene(const std::string &scenePath);
+
+        // Mesh
+        /*!
+         * @brief Gets GPU buffers holding the given geometry.
+         * @details Buffers are shared between all meshes with byte-identical vertices and indices.
+         */
+        [[nodiscard]] std::shared_ptr<Resource::MeshBuffers>
+        loadMeshBuffers(std::span<const Resource::MeshVertex> vertices, std::span<const unsigned int> indices);
+        /*! @brief Uploads geometry staged on a worker thread, or shares existing buffers like the overload above. */
+        [[nodiscard]] std::shared_ptr<Resource::MeshBuffers> loadMeshBuffers(const Resource::StagedMeshBuffers& staged);
+        /*! @returns The vertex format new mesh buffers should be staged in, see \ref EngineConfig::packVertices. */
+        [[nodiscard]] static Resource::VertexFormat getMeshVertexFormat();
+
+    public:
+        /*!
+         * @brief Starts decoding all resources listed in a load manifest on worker threads.
+         * @details Later load calls for those resources only have to do the OpenGL work.
+         *          Resources that are never requested again are kept around until the manager is destroyed.
+         * @param manifestPath A manifest written by \ref saveLoadManifest() "saveLoadManifest()" in a previous session.
+         */
+        [[nodiscard]] Expected<void> prefetch(const std::string& manifestPath);
+        /*!
+         * @brief Starts decoding textures on worker threads, so loading them later only has to upload them.
+         * @details Textures that are already loaded or being decoded are skipped.
+         */
+        void prefetchTextures(std::span<const std::string> texturePaths);
+        /*!
+         * @brief Starts importing a scene on a worker thread, so loading it later only has to do the OpenGL work.
+         * @details Does nothing if the scene is already loaded or being imported.
+         */
+        void prefetchScene(const std::string& scenePath);
+        /*! @returns Whether loading the scene would not block on importing it, because it is loaded or its prefetch has finished. */
+        [[nodiscard]] bool isSceneReady(const std::string& scenePath) const;
+        /*! @brief Drops the result of a scene prefetch that is no longer wanted, once it finishes. */
+        void discardScenePrefetch(const std::string& scenePath);
+        /*! @brief Writes every resource loaded so far, in load order, to a manifest for \ref prefetch() "prefetch()". */
+        [[nodiscard]] Expected<void> saveLoadManifest(const std::string& manifestPath) const;
+
+        /*!
+         * @brief Marks a texture as used this frame and returns an OpenGL ID that is safe to bind.
+         * @details Evicted textures are transparently reloaded, as are demoted ones unless texture streaming is enabled.
+         *          If the texture is null or can't be reloaded, the matching error texture is used instead.
+         * @param requestedSize The texture size needed for the draw to look sharp, see \ref getRequestedTextureSize() "getRequestedTextureSize()".
+         *                      Streamed textures have their larger mip levels loaded until they match the largest size requested in a frame.
+         */
+        [[nodiscard]] unsigned int useTexture(const std::shared_ptr<Resource::ManagedTexture>& texture,
+                                              int requestedSize = std::numeric_limits<int>::max());
+        /*!
+         * @brief Sets the camera that texture sizes are requested for during the current frame.
+         * @param pixelsPerUnit How many pixels tall an object one unit tall appears one unit away from the camera,
+         *                      that is the viewport height divided by `2 * tan(verticalFov / 2)`.
+         */
+        void setStreamingView(const glm::vec3& cameraPosition, float pixelsPerUnit);
+        /*!
+         * @brief Works out how large the textures of a mesh need to be for one texel to cover about one pixel.
+         * @param boundsMin, boundsMax The model space bounds of the mesh.
+         * @param uvDensity The texture coordinate units per model space unit, see \ref Resource::Mesh::uvDensity.
+         * @return The larger dimension of the mip level the textures should be sampled at, or the maximum int
+         *         when it can't be known, such as for meshes with no texture coordinates or when the camera is inside of them.
+         */
+        [[nodiscard]] int getRequestedTextureSize(const glm::mat4& modelTransform, const glm::vec3& boundsMin,
+                                                  const glm::vec3& boundsMax, float uvDensity) const;
+        /*! @returns The estimated GPU memory used by all textures loaded through the manager, as of the last frame. */
+        [[nodiscard]] size_t getTextureMemoryUsage() const { return textureMemoryUsage; }
+        /*!
+         * @brief Advances the frame counter and enforces the texture memory budget.
+         * @details Textures used during the frame that just ended are first shrunk to the size requested for them,
+         *          then the least recently used textures are demoted to their smaller mip levels, then evicted entirely.
+         *          Textures used during the frame that just ended are never touched beyond that.
+         *          Also swaps in textures that have finished compressing in the background,
+         *          and starts streaming in the larger mip levels of textures that are requested larger than they are.
+         * @note Should be called once at the end of every frame.
+         */
+        void endFrame();
+
+        /*!
+         * @brief Gets a snapshot of the cache counters, load timings and memory usage of every resource type.
+         * @note Live object and byte counts are gathered on every call, so avoid calling this more than once per frame.
+         */
+        [[nodiscard]] ResourceStats getStats() const;
+        /*! @brief Resets all counters, timings and the list of recent loads. */
+        void resetStats();
+
+    private:
+        enum class LoadStage { DECODE, UPLOAD };
+        /*! Records the duration of a load stage to the stats when it goes out of scope. */
+        class ScopedLoadTimer {
+        public:
+            ScopedLoadTimer(ResourceManager& manager, const ResourceType type, const LoadStage stage)
+                : manager(manager), type(type), stage(stage), start(std::chrono::steady_clock::now()) {}
+            ~ScopedLoadTimer() { manager.recordTiming(type, stage, elapsedSeconds()); }
+            [[nodiscard]] double elapsedSeconds() const {
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        private:
+            ResourceManager& manager;
+            ResourceType type;
+            LoadStage stage;
+            std::chrono::steady_clock::time_point start;
+        };
+        void recordTiming(ResourceType type, LoadStage stage, double seconds);
+        void recordLoadEvent(LoadEvent event);
+
+        void recordLoad(ResourceType type, const std::string& path);
+        Expected<void> reloadTexture(Resource::ManagedTexture& texture) const;
+        void scheduleCompression(const std::shared_ptr<Resource::ManagedTexture>& texture, Resource::Loading::Image image);
+        void swapCompressedTextures();
+        void scheduleStreaming();
+        void uploadStreamedTextures();
+        void enforceTextureBudget(size_t budget);
     };
 }
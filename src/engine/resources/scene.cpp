@@ -1,12 +1,37 @@
 #include "scene.h"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <utility>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_SSE
+#include <xmmintrin.h>
+#endif
+
 #include <assimp/cimport.h>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <engine/state.h>
 
+#include "engine/resources/atlas.h"
 #include "engine/resources/mesh.h"
+#include "engine/resources/mesh_optimizer.h"
+#include "engine/resources/scene_format.h"
+#include "engine/util/file.h"
+#include "engine/util/hash.h"
+#include "engine/util/pack_format.h"
 
 // TODO: Put more consideration into this depending on our needs (for example mesh sorting?)
 //  This is just a super simple first pass set of flags where much consideration hasn't been put in
@@ -16,6 +41,12 @@ constexpr auto ASSIMP_FLAGS = (
     | aiProcess_OptimizeMeshes
     | aiProcess_OptimizeGraph
     );
+constexpr const char* SCENE_CACHE_DIRECTORY = "cache/scenes";
+static_assert(sizeof(Resource::MeshVertex) == SceneFormat::VERTEX_SIZE && std::is_trivially_copyable_v<Resource::MeshVertex>,
+    "Bump SceneFormat::VERSION along with VERTEX_SIZE when changing the vertex format");
+static_assert(sizeof(MeshOptimizer::Meshlet) == SceneFormat::MESHLET_SIZE && std::is_trivially_copyable_v<MeshOptimizer::Meshlet>,
+    "Bump SceneFormat::VERSION along with MESHLET_SIZE when changing the meshlet format");
+static_assert(Resource::PBRMaterial::TEXTURE_SLOT_COUNT == SceneFormat::TEXTURE_SLOT_COUNT);
 
 
 #define UNPACK_MAT4(aiMat) { \
@@ -31,39 +62,153 @@ constexpr auto ASSIMP_FLAGS = (
 
 namespace Resource
 {
-    Expected<void> Scene::DrawNode(const Node& node, const glm::mat4& parentTransform) const { // NOLINT(*-no-recursion)
-        const glm::mat4 transform = parentTransform * node.transform;
-        for (const unsigned int meshIndex : node.meshIndices) {
-            if (meshIndex >= meshes.size())
-                return std::unexpected(ERROR("Mesh index out of bounds"));
-            Expected<void> result = meshes[meshIndex].Draw(transform);
-            if (!result.has_value())
-                return std::unexpected(FW_ERROR(result.error(), "Failed to draw mesh"));
-        }
+    SceneGraph::SceneGraph(const size_t nodeCount, const size_t meshIndexCount) {
+        static_assert(std::is_trivially_destructible_v<Node>, "The arena never runs destructors");
+        const size_t nodeBytes = nodeCount * sizeof(Node), meshIndexBytes = meshIndexCount * sizeof(uint32_t);
+        arena = std::make_unique<std::pmr::monotonic_buffer_resource>(std::max<size_t>(nodeBytes + meshIndexBytes, 1));
+        nodes = std::span(static_cast<Node*>(arena->allocate(nodeBytes, alignof(Node))), nodeCount);
+        std::uninitialized_value_construct(nodes.begin(), nodes.end());
+        meshIndices = std::span(static_cast<uint32_t*>(arena->allocate(meshIndexBytes, alignof(uint32_t))), meshIndexCount);
+        std::uninitialized_value_construct(meshIndices.begin(), meshIndices.end());
+    }
 
-        for (const Node& child : node.children) {
-            Expected<void> result = DrawNode(child, transform);
-            if (!result.has_value())
-                return std::unexpected(FW_ERROR(result.error(), "Failed to draw child node"));
-        }
+    SceneGraph::SceneGraph(SceneGraph&& other) noexcept
+        : nodes(std::exchange(other.nodes, {})), meshIndices(std::exchange(other.meshIndices, {})), arena(std::move(other.arena)) {}
 
-        return {};
+    SceneGraph& SceneGraph::operator=(SceneGraph&& other) noexcept {
+        nodes = std::exchange(other.nodes, {});
+        meshIndices = std::exchange(other.meshIndices, {});
+        arena = std::move(other.arena);
+        return *this;
     }
 
-    Expected<void> Scene::Draw(const glm::mat4& transform) const {
-        return DrawNode(root, transform);
+    Expected<void> Scene::Draw(const glm::mat4& transform, const Culling::View* view) const {
+        // Parents come before their children, so a single pass in order works out every node's transform
+        worldTransforms.resize(graph.nodes.size());
+        MaterialID boundMaterial = NO_MATERIAL;
+        for (size_t i = 0; i < graph.nodes.size(); i++) {
+            const SceneGraph::Node& node = graph.nodes[i];
+            const glm::mat4& parentTransform = node.parent == SceneGraph::NO_NODE ? transform : worldTransforms[node.parent];
+            worldTransforms[i] = parentTransform * node.transform;
+            for (const uint32_t meshIndex : graph.getMeshIndices(node)) {
+                if (meshIndex >= meshes.size())
+                    return std::unexpected(ERROR("Mesh index out of bounds"));
+                const Mesh& mesh = meshes[meshIndex];
+                if (mesh.materialID >= materials.size())
+                    return std::unexpected(ERROR("Mesh material ID out of bounds"));
+                Expected<bool> drawn = mesh.Draw(worldTransforms[i], materials[mesh.materialID], mesh.materialID == boundMaterial, view);
+                if (!drawn.has_value())
+                    return std::unexpected(FW_ERROR(drawn.error(), "Failed to draw mesh"));
+                // Culled meshes never bind their material, so whatever was bound before still is
+                if (drawn.value())
+                    boundMaterial = mesh.materialID;
+            }
+        }
+        return {};
     }
 }
 
 namespace Resource::Loading {
-    Expected<Scene> loadScene(const std::string &path)
+    /*! Read-only assimp stream over a file in a mapped resource pack. */
+    class PackedIOStream final : public Assimp::IOStream {
+        std::span<const unsigned char> data;
+        size_t cursor = 0;
+    public:
+        explicit PackedIOStream(const std::span<const unsigned char> data) : data(data) {}
+
+        size_t Read(void* buffer, const size_t size, const size_t count) override {
+            if (size == 0) return 0;
+            const size_t readCount = std::min(count, (data.size() - cursor) / size);
+            std::memcpy(buffer, data.data() + cursor, readCount * size);
+            cursor += readCount * size;
+            return readCount;
+        }
+        size_t Write(const void*, size_t, size_t) override { return 0; }
+        aiReturn Seek(const size_t offset, const aiOrigin origin) override {
+            size_t target;
+            switch (origin) {
+                case aiOrigin_SET: target = offset; break;
+                case aiOrigin_CUR: target = cursor + offset; break;
+                case aiOrigin_END: target = data.size() - offset; break;
+                default: return AI_FAILURE;
+            }
+            if (target > data.size()) return AI_FAILURE;
+            cursor = target;
+            return AI_SUCCESS;
+        }
+        [[nodiscard]] size_t Tell() const override { return cursor; }
+        [[nodiscard]] size_t FileSize() const override { return data.size(); }
+        void Flush() override {}
+    };
+
+    /*!
+     * Assimp IO handler that serves files from the mounted resource packs, falling back to loose files.
+     * Lets importers resolve secondary files (such as OBJ material libraries) from packs too.
+     */
+    class PackIOSystem final : public Assimp::DefaultIOSystem {
+    public:
+        /*! Every file opened for reading so far, in the order they were first opened. */
+        std::vector<std::string> openedPaths;
+
+        bool Exists(const char* path) const override {
+            return findPackedFile(path).has_value() || DefaultIOSystem::Exists(path);
+        }
+        Assimp::IOStream* Open(const char* path, const char* mode) override {
+            if (std::strchr(mode, 'w') == nullptr) {
+                if (std::ranges::find(openedPaths, path) == openedPaths.end())
+                    openedPaths.emplace_back(path);
+                if (const auto packed = findPackedFile(path))
+                    return new PackedIOStream(packed.value());
+            }
+            return DefaultIOSystem::Open(path, mode);
+        }
+    };
+
+    Expected<ImportedScene> flattenScene(const aiScene& scene);
+    Expected<ImportedScene> loadSceneCache(const std::filesystem::path& cachePath);
+    Expected<void> saveSceneCache(const std::filesystem::path& cachePath, const ImportedScene& scene,
+                                  const std::vector<std::string>& dependencies);
+
+    std::filesystem::path getSceneCachePath(const std::string& path) {
+        return std::filesystem::path(SCENE_CACHE_DIRECTORY) / fmt::format("{:016x}.llgscene", Pack::hashPath(Pack::normalizePath(path)));
+    }
+
+    Expected<ImportedScene> importScene(const std::string& path)
     {
+        const std::filesystem::path cachePath = getSceneCachePath(path);
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(cachePath, ec)) {
+            Expected<ImportedScene> cached = loadSceneCache(cachePath);
+            if (cached.has_value()) {
+                SPDLOG_TRACE("Using cooked scene \"{}\" from the cache", path);
+                return cached;
+            }
+            SPDLOG_DEBUG("Not using scene cache entry for \"{}\": {}", path, stringifyError(cached.error()));
+        }
+
         Assimp::Importer importer;
+        auto* ioSystem = new PackIOSystem();
+        importer.SetIOHandler(ioSystem);  // Importer takes ownership
         const aiScene* loadedScene = importer.ReadFile(path.c_str(), ASSIMP_FLAGS);
         if (!loadedScene || loadedScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !loadedScene->mRootNode)
             return std::unexpected(ERROR(std::string("Failed to load scene file: ") + importer.GetErrorString()));
+        Expected<ImportedScene> imported = flattenScene(*loadedScene);
+        if (!imported.has_value())
+            return std::unexpected(FW_ERROR(imported.error(), "Failed to convert scene \"" + path + "\""));
 
-        Expected<Scene> scene = loadScene(*loadedScene);
+        // Failing to cache only makes the next load slow again
+        if (const Expected<void> saved = saveSceneCache(cachePath, imported.value(), ioSystem->openedPaths); !saved.has_value())
+            reportError(FW_ERROR(saved.error(), "Failed to cache scene \"" + path + "\""));
+        return imported;
+    }
+
+    Expected<Scene> loadScene(const std::string &path)
+    {
+        const Expected<ImportedScene> imported = importScene(path);
+        if (!imported.has_value())
+            return std::unexpected(imported.error());
+
+        Expected<Scene> scene = loadScene(imported.value());
         if (!scene.has_value())
             return std::unexpected(FW_ERROR(scene.error(), "Failed to load scene from file"));
         return scene;
@@ -74,125 +219,790 @@ namespace Resource::Loading {
         const aiScene* loadedScene = importer.ReadFileFromMemory(data, size, ASSIMP_FLAGS);
         if (!loadedScene || loadedScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !loadedScene->mRootNode)
             return std::unexpected(ERROR(std::string("Failed to load scene data: ") + importer.GetErrorString()));
+        const Expected<ImportedScene> imported = flattenScene(*loadedScene);
+        if (!imported.has_value())
+            return std::unexpected(FW_ERROR(imported.error(), "Failed to convert scene data"));
 
-        Expected<Scene> scene = loadScene(*loadedScene);
+        Expected<Scene> scene = loadScene(imported.value());
         if (!scene.has_value())
             return std::unexpected(FW_ERROR(scene.error(), "Failed to load scene from data"));
         return scene;
     }
 
-    Expected<Node> processNode(const aiNode* loadedNode);
-    Expected<PBRMaterial> processMaterial(const aiMaterial* loadedMaterial);
-    Expected<Mesh> processMesh(const aiMesh* loadedMesh, const std::shared_ptr<PBRMaterial>& material);
+#pragma region Texture atlases
+    // Larger textures gain little from sharing a bind, and would fill the pages quickly
+    constexpr int ATLAS_MAX_TEXTURE_SIZE = 256;
+    constexpr int ATLAS_PAGE_SIZE = 2048;
+    // Texture coordinates further outside of [0, 1] would sample the neighbouring textures rather than repeat
+    constexpr float ATLAS_UV_TOLERANCE = 1e-3f;
 
-    Expected<Scene> loadScene(const aiScene &scene) {
-        Scene resultScene;
-        // Materials
-        resultScene.materials.reserve(scene.mNumMaterials);
-        for (unsigned int i = 0; i < scene.mNumMaterials; i++) {
-            Expected<PBRMaterial> material = processMaterial(scene.mMaterials[i]);
-            if (!material.has_value())
-                return std::unexpected(FW_ERROR(material.error(), "Failed to load material "+std::to_string(i)));
-            resultScene.materials.push_back(std::move(material.value()));
-        }
-        // Meshes
-        resultScene.meshes.reserve(scene.mNumMeshes);
+    constexpr std::array<aiTextureType, PBRMaterial::TEXTURE_SLOT_COUNT> materialTextureTypes = {
+        aiTextureType_DIFFUSE, aiTextureType_NORMALS, aiTextureType_SHININESS, aiTextureType_REFLECTION,
+        aiTextureType_AMBIENT_OCCLUSION,
+    };
+    constexpr std::array<BlockCompression::TextureUsage, PBRMaterial::TEXTURE_SLOT_COUNT> materialTextureUsages = {
+        BlockCompression::TextureUsage::ALBEDO, BlockCompression::TextureUsage::NORMAL,
+        BlockCompression::TextureUsage::SPECULAR, BlockCompression::TextureUsage::SPECULAR,
+        BlockCompression::TextureUsage::SPECULAR,
+    };
+
+    /*! The texture file used in every slot of a material, empty for unused slots. */
+    using MaterialTexturePaths = std::array<std::string, PBRMaterial::TEXTURE_SLOT_COUNT>;
+
+    MaterialTexturePaths getMaterialTexturePaths(const aiMaterial* loadedMaterial) {
+        MaterialTexturePaths paths;
+        aiString path;
+        for (size_t slot = 0; slot < paths.size(); slot++)
+            if (loadedMaterial->GetTexture(materialTextureTypes[slot], 0, &path) == AI_SUCCESS)
+                paths[slot] = Pack::normalizePath(path.C_Str());
+        return paths;
+    }
+
+    /*! @returns Whether every mesh using each material keeps its texture coordinates within the texture. */
+    std::vector<bool> getMaterialsWithUnitUVs(const aiScene& scene) {
+        std::vector<bool> result(scene.mNumMaterials, true);
         for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
-            unsigned int matIndex = scene.mMeshes[i]->mMaterialIndex;
-            if (matIndex >= resultScene.materials.size())
-                return std::unexpected(ERROR(
-                    "Encountered invalid mesh material index " + std::to_string(scene.mMeshes[i]->mMaterialIndex)));
-            Expected<Mesh> mesh = processMesh(
-                scene.mMeshes[i],
-                std::make_shared<PBRMaterial>(resultScene.materials[matIndex])
-            );
-            if (!mesh.has_value())
-                return std::unexpected(FW_ERROR(mesh.error(), "Failed to load mesh "+std::to_string(i)));
-            resultScene.meshes.push_back(std::move(mesh.value()));
+            const aiMesh* mesh = scene.mMeshes[i];
+            if (mesh->mTextureCoords[0] == nullptr || mesh->mMaterialIndex >= result.size())
+                continue;
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+                const aiVector3D& uv = mesh->mTextureCoords[0][v];
+                if (uv.x < -ATLAS_UV_TOLERANCE || uv.x > 1.0f + ATLAS_UV_TOLERANCE
+                    || uv.y < -ATLAS_UV_TOLERANCE || uv.y > 1.0f + ATLAS_UV_TOLERANCE) {
+                    result[mesh->mMaterialIndex] = false;
+                    break;
+                }
+            }
         }
-        // Nodes
-        auto rootNode = processNode(scene.mRootNode);
-        if (!rootNode.has_value())
-            return std::unexpected(FW_ERROR(rootNode.error(), "Failed to load scene root node"));
-        resultScene.root = rootNode.value();
+        return result;
+    }
 
-        return resultScene;
+    struct AtlasedMaterial {
+        std::array<std::shared_ptr<ManagedTexture>, PBRMaterial::TEXTURE_SLOT_COUNT> textures;
+        glm::vec4 uvTransform;
+    };
+
+    /*! Expands a decoded image to RGBA, the same way its own texture would be sampled. */
+    std::vector<unsigned char> expandToRGBA(const Image& image) {
+        const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        const unsigned char* pixels = image.pixels.get();
+        if (image.channelCount == 4)
+            return {pixels, pixels + pixelCount * 4};
+        std::vector<unsigned char> rgba(pixelCount * 4);
+        for (size_t i = 0; i < pixelCount; i++) {
+            const unsigned char grey = pixels[i * image.channelCount];
+            rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = grey;
+            rgba[i * 4 + 3] = image.channelCount == 2 ? pixels[i * 2 + 1] : 255;
+        }
+        return rgba;
+    }
+
+    /*! Builds one atlas page for a single texture slot. */
+    Image buildAtlasPage(const Atlas::Size pageSize, const BlockCompression::TextureUsage usage,
+                         const std::vector<std::pair<Atlas::Rect, const Image*>>& contents) {
+        const size_t byteCount = static_cast<size_t>(pageSize.width) * pageSize.height * 4;
+        // Allocated like stb_image does, so it can be freed by the same deleter
+        auto* pixels = static_cast<unsigned char*>(std::calloc(byteCount, 1));
+        if (pixels == nullptr)
+            throw std::bad_alloc();
+        const std::span page(pixels, byteCount);
+        for (const auto& [rect, image] : contents)
+            Atlas::copyWithPadding(page, pageSize.width, rect, expandToRGBA(*image));
+
+        Image result;
+        result.width = pageSize.width;
+        result.height = pageSize.height;
+        result.channelCount = 4;
+        result.pixels = std::unique_ptr<unsigned char, ImageDeleter>(pixels);
+        result.srgb = usage == BlockCompression::TextureUsage::ALBEDO;
+        result.mipData = Mipmap::generateChain(page, pageSize.width, pageSize.height,
+            BlockCompression::getMipmapOptions(usage), [](const size_t count, const std::function<void(size_t)>& body) {
+                engineState->threadPool.parallelFor(count, body);
+            });
+        result.levelCount = Mipmap::getLevelCount(pageSize.width, pageSize.height);
+        const std::array dimensions = {pageSize.width, pageSize.height, 4};
+        result.contentHash = hashTextureUsage(xxh64(pixels, byteCount, xxh64(dimensions.data(), sizeof(dimensions))), usage);
+        return result;
+    }
+
+    /*!
+     * Packs the small textures of materials into shared atlas pages, so their meshes all bind the same textures.
+     * @details Materials are grouped by which slots they use, and every slot in a group gets its own pages with the same layout,
+     *          so a single texture coordinate transform works for all of a material's textures.
+     *          Only materials whose textures are uncooked, equally sized and never repeated are packed.
+     * @return The atlas textures and texture coordinate transform of every material that was packed.
+     */
+    std::vector<std::optional<AtlasedMaterial>> buildMaterialAtlases(const std::vector<MaterialTexturePaths>& materialPaths,
+                                                                     const std::vector<bool>& unitUVs) {
+        std::vector<std::optional<AtlasedMaterial>> result(materialPaths.size());
+
+        // Materials with the same textures share a single place in the atlas
+        std::map<MaterialTexturePaths, std::vector<size_t>> materialsByPaths;
+        for (size_t i = 0; i < materialPaths.size(); i++) {
+            if (!unitUVs[i])
+                continue;
+            std::optional<std::array<int, 2>> size;
+            bool packable = true;
+            for (const std::string& path : materialPaths[i]) {
+                if (path.empty())
+                    continue;
+                const std::optional<std::array<int, 2>> slotSize = getSourceImageSize(path);
+                if (!slotSize.has_value() || (size.has_value() && slotSize != size)
+                    || std::max(slotSize->at(0), slotSize->at(1)) > ATLAS_MAX_TEXTURE_SIZE) {
+                    packable = false;
+                    break;
+                }
+                size = slotSize;
+            }
+            if (packable && size.has_value())
+                materialsByPaths[materialPaths[i]].push_back(i);
+        }
+        std::map<unsigned int, std::vector<const MaterialTexturePaths*>> groups;  // Keyed by a mask of the used slots
+        for (const MaterialTexturePaths& paths : materialsByPaths | std::views::keys) {
+            unsigned int slotMask = 0;
+            for (size_t slot = 0; slot < paths.size(); slot++)
+                slotMask |= paths[slot].empty() ? 0 : 1u << slot;
+            groups[slotMask].push_back(&paths);
+        }
+
+        constexpr size_t SLOT_COUNT = PBRMaterial::TEXTURE_SLOT_COUNT;
+        for (const auto& [slotMask, group] : groups) {
+            if (group.size() < 2)
+                continue;  // Nothing to share a bind with
+
+            std::vector<Expected<Image>> images(group.size() * SLOT_COUNT);
+            engineState->threadPool.parallelFor(images.size(), [&](const size_t i) {
+                const std::string& path = (*group[i / SLOT_COUNT])[i % SLOT_COUNT];
+                if (!path.empty())
+                    images[i] = decodeImage(path);
+            });
+            // Anything that changed since its size was read, or fails to decode, is loaded on its own and reports its error there
+            std::vector<size_t> packed;
+            std::vector<Atlas::Size> sizes;
+            for (size_t entry = 0; entry < group.size(); entry++) {
+                std::optional<Atlas::Size> size;
+                bool packable = true;
+                for (size_t slot = 0; slot < SLOT_COUNT && packable; slot++) {
+                    if (!(slotMask & 1u << slot))
+                        continue;
+                    const Expected<Image>& image = images[entry * SLOT_COUNT + slot];
+                    packable = image.has_value() && !image->blockFormat.has_value()
+                        && (!size.has_value() || (size->width == image->width && size->height == image->height));
+                    if (packable)
+                        size = Atlas::Size{image->width, image->height};
+                }
+                if (packable && std::max(size->width, size->height) <= ATLAS_MAX_TEXTURE_SIZE) {
+                    packed.push_back(entry);
+                    sizes.push_back(size.value());
+                }
+            }
+            if (packed.size() < 2)
+                continue;
+
+            const Atlas::Layout layout = Atlas::pack(sizes, ATLAS_PAGE_SIZE);
+            std::array<std::vector<std::shared_ptr<ManagedTexture>>, SLOT_COUNT> pageTextures;
+            bool failed = false;
+            for (size_t slot = 0; slot < SLOT_COUNT && !failed; slot++) {
+                if (!(slotMask & 1u << slot))
+                    continue;
+                for (size_t page = 0; page < layout.pages.size() && !failed; page++) {
+                    std::vector<std::pair<Atlas::Rect, const Image*>> contents;
+                    for (size_t i = 0; i < packed.size(); i++)
+                        if (layout.placements[i].page == page)
+                            contents.emplace_back(layout.placements[i].rect, &images[packed[i] * SLOT_COUNT + slot].value());
+                    const Image pageImage = buildAtlasPage(layout.pages[page], materialTextureUsages[slot], contents);
+                    std::shared_ptr<ManagedTexture> texture = engineState->resourceManager.createTexture(
+                        fmt::format("<atlas {:016x}>", pageImage.contentHash), pageImage);
+                    if (texture == engineState->resourceManager.errorTexture) {
+                        failed = true;
+                        break;
+                    }
+                    glBindTexture(GL_TEXTURE_2D, texture->textureID);
+                    // Smaller levels would blend neighbouring textures together, and repeating would sample them
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Atlas::MIP_LEVEL_COUNT - 1);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                    pageTextures[slot].push_back(std::move(texture));
+                }
+            }
+            if (failed)
+                continue;
+
+            for (size_t i = 0; i < packed.size(); i++) {
+                const Atlas::Placement& placement = layout.placements[i];
+                const auto pageWidth = static_cast<float>(layout.pages[placement.page].width);
+                const auto pageHeight = static_cast<float>(layout.pages[placement.page].height);
+                AtlasedMaterial atlased{
+                    .textures = {},
+                    .uvTransform = glm::vec4(
+                        static_cast<float>(placement.rect.width) / pageWidth, static_cast<float>(placement.rect.height) / pageHeight,
+                        static_cast<float>(placement.rect.x) / pageWidth, static_cast<float>(placement.rect.y) / pageHeight),
+                };
+                for (size_t slot = 0; slot < SLOT_COUNT; slot++)
+                    if (slotMask & 1u << slot)
+                        atlased.textures[slot] = pageTextures[slot][placement.page];
+                for (const size_t material : materialsByPaths.at(*group[packed[i]]))
+                    result[material] = atlased;
+            }
+            SPDLOG_DEBUG("Packed {} material textures into {} atlas pages per slot", packed.size(), layout.pages.size());
+        }
+        return result;
     }
+#pragma endregion
 
-    Expected<Node> processNode(const aiNode *loadedNode) { // NOLINT(*-no-recursion)
-        Node resultNode;
-        resultNode.transform = UNPACK_MAT4(loadedNode->mTransformation);
+#pragma region Scene cache
+    /*! Size, modification time and hash of a file a scene import read, as stored in the scene cache. */
+    Expected<SceneFormat::Dependency> describeDependency(const std::string& path) {
+        SceneFormat::Dependency dependency{};
+        if (const auto packed = findPackedFile(path)) {
+            dependency.contentHash = xxh64(packed->data(), packed->size());
+            dependency.size = packed->size();
+            return dependency;
+        }
+        const Expected<MappedFile> file = MappedFile::open(path);
+        if (!file.has_value())
+            return std::unexpected(FW_ERROR(file.error(), "Failed to read scene dependency \"" + path + "\""));
+        std::error_code ec;
+        const auto modifiedTime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return std::unexpected(ERROR("Failed to read modification time of \"" + path + "\": " + ec.message()));
+        dependency.contentHash = xxh64(file->bytes().data(), file->bytes().size());
+        dependency.size = file->bytes().size();
+        dependency.modifiedTime = modifiedTime.time_since_epoch().count();
+        return dependency;
+    }
 
-        resultNode.meshIndices.reserve(loadedNode->mNumMeshes);
-        for (unsigned int i = 0; i < loadedNode->mNumMeshes; i++) {
-            resultNode.meshIndices.push_back(loadedNode->mMeshes[i]);
+    /*! @returns Whether a file still matches what the import that wrote the cache read. */
+    bool isDependencyUnchanged(const std::string& path, const SceneFormat::Dependency& recorded) {
+        if (recorded.modifiedTime != 0 && !findPackedFile(path).has_value()) {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(path, ec);
+            if (ec || size != recorded.size)
+                return false;
+            // Most files are untouched, and are trusted without reading them
+            const auto modifiedTime = std::filesystem::last_write_time(path, ec);
+            if (!ec && modifiedTime.time_since_epoch().count() == recorded.modifiedTime)
+                return true;
         }
+        // Touched, or from a pack, so only the contents can tell
+        const Expected<SceneFormat::Dependency> current = describeDependency(path);
+        return current.has_value() && current->size == recorded.size && current->contentHash == recorded.contentHash;
+    }
+
+    /*! Maps a scene cache file and checks that it is complete, consistent and up to date, without copying anything. */
+    Expected<ImportedScene> loadSceneCache(const std::filesystem::path& cachePath) {
+        Expected<MappedFile> file = MappedFile::open(cachePath.generic_string());
+        if (!file.has_value())
+            return std::unexpected(FW_ERROR(file.error(), "Failed to open scene cache entry"));
+        const std::span<const unsigned char> bytes = file->bytes();
+
+        SceneFormat::Header header{};
+        if (bytes.size() < sizeof(header))
+            return std::unexpected(ERROR("Scene cache entry is too small"));
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (std::memcmp(header.magic, SceneFormat::MAGIC, sizeof(header.magic)) != 0 || header.fileSize != bytes.size())
+            return std::unexpected(ERROR("Not a complete scene cache entry"));
+        if (header.version != SceneFormat::VERSION || header.importFlags != static_cast<uint32_t>(ASSIMP_FLAGS))
+            return std::unexpected(ERROR("Scene cache entry was made by a different version"));
 
-        resultNode.children.reserve(loadedNode->mNumChildren);
-        for (unsigned int i = 0; i < loadedNode->mNumChildren; i++) {
-            Expected<Node> result = processNode(loadedNode->mChildren[i]);
-            if (!result.has_value())
-                return std::unexpected(FW_ERROR(result.error(), "Failed to load child node " + std::to_string(i)));
-            resultNode.children.push_back(std::move(result.value()));
+        // Sections are used in place, so they have to be aligned as well as in bounds
+        bool valid = true;
+        const auto getSection = [&]<typename T>(const uint64_t offset, const uint64_t count) -> std::span<const T> {
+            if (offset % SceneFormat::SECTION_ALIGNMENT != 0 || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T)) {
+                valid = false;
+                return {};
+            }
+            return {reinterpret_cast<const T*>(bytes.data() + offset), static_cast<size_t>(count)};
+        };
+        const auto dependencies = getSection.operator()<SceneFormat::Dependency>(header.dependenciesOffset, header.dependencyCount);
+        const auto materials = getSection.operator()<SceneFormat::Material>(header.materialsOffset, header.materialCount);
+        const auto meshes = getSection.operator()<SceneFormat::Mesh>(header.meshesOffset, header.meshCount);
+        const auto nodes = getSection.operator()<SceneFormat::Node>(header.nodesOffset, header.nodeCount);
+        const auto nodeMeshIndices = getSection.operator()<uint32_t>(header.nodeMeshIndicesOffset, header.nodeMeshIndexCount);
+        const auto strings = getSection.operator()<char>(header.stringsOffset, header.stringsSize);
+        const auto vertices = getSection.operator()<MeshVertex>(header.verticesOffset, header.vertexCount);
+        const auto indices = getSection.operator()<unsigned int>(header.indicesOffset, header.indexCount);
+        const auto meshlets = getSection.operator()<MeshOptimizer::Meshlet>(header.meshletsOffset, header.meshletCount);
+        if (!valid)
+            return std::unexpected(ERROR("Scene cache entry has sections out of bounds"));
+        const auto getString = [&](const SceneFormat::StringRef& ref) -> std::string {
+            if (ref.offset > strings.size() || ref.length > strings.size() - ref.offset) {
+                valid = false;
+                return {};
+            }
+            return {strings.data() + ref.offset, ref.length};
+        };
+
+        for (const SceneFormat::Dependency& dependency : dependencies) {
+            const std::string path = getString(dependency.path);
+            if (!valid)
+                return std::unexpected(ERROR("Scene cache entry has a broken dependency path"));
+            if (!isDependencyUnchanged(path, dependency))
+                return std::unexpected(ERROR("\"" + path + "\" has changed since the scene was cached"));
+        }
+
+        ImportedScene scene;
+        scene.materials.reserve(materials.size());
+        for (const SceneFormat::Material& material : materials) {
+            ImportedScene::Material& imported = scene.materials.emplace_back();
+            imported.name = getString(material.name);
+            for (size_t slot = 0; slot < imported.texturePaths.size(); slot++)
+                imported.texturePaths[slot] = getString(material.texturePaths[slot]);
+            imported.unitUVs = material.unitUVs != 0;
+        }
+        scene.meshes.reserve(meshes.size());
+        for (const SceneFormat::Mesh& mesh : meshes) {
+            if (mesh.firstVertex > vertices.size() || mesh.vertexCount > vertices.size() - mesh.firstVertex
+                || mesh.firstIndex > indices.size() || mesh.indexCount > indices.size() - mesh.firstIndex
+                || mesh.firstMeshlet > meshlets.size() || mesh.meshletCount > meshlets.size() - mesh.firstMeshlet)
+                return std::unexpected(ERROR("Scene cache entry has a mesh out of bounds"));
+            const std::span<const MeshOptimizer::Meshlet> meshMeshlets = meshlets.subspan(mesh.firstMeshlet, mesh.meshletCount);
+            for (const MeshOptimizer::Meshlet& meshlet : meshMeshlets)
+                if (meshlet.firstIndex > mesh.indexCount || meshlet.indexCount > mesh.indexCount - meshlet.firstIndex)
+                    return std::unexpected(ERROR("Scene cache entry has a meshlet out of bounds"));
+            scene.meshes.push_back({
+                .vertices = vertices.subspan(mesh.firstVertex, mesh.vertexCount),
+                .indices = indices.subspan(mesh.firstIndex, mesh.indexCount),
+                .materialIndex = mesh.materialIndex,
+                .bounds = {
+                    glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]),
+                    glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]),
+                    mesh.uvDensity,
+                },
+                .meshlets = meshMeshlets,
+            });
         }
+        // A pre-order tree is well formed exactly when every node is someone's child, and no child is missing
+        uint64_t expectedNodes = 1;
+        scene.nodes.reserve(nodes.size());
+        for (const SceneFormat::Node& node : nodes) {
+            if (expectedNodes == 0 || node.firstMeshIndex > nodeMeshIndices.size()
+                || node.meshIndexCount > nodeMeshIndices.size() - node.firstMeshIndex)
+                return std::unexpected(ERROR("Scene cache entry has a broken node tree"));
+            expectedNodes = expectedNodes - 1 + node.childCount;
+            ImportedScene::Node& imported = scene.nodes.emplace_back();
+            std::memcpy(&imported.transform, node.transform, sizeof(node.transform));
+            imported.meshIndices = nodeMeshIndices.subspan(node.firstMeshIndex, node.meshIndexCount);
+            imported.childCount = node.childCount;
+        }
+        if (expectedNodes != 0 || !valid)
+            return std::unexpected(ERROR("Scene cache entry has a broken node tree or string"));
 
-        return resultNode;
+        scene.mapping = std::move(file.value());  // Moving the mapping keeps the spans into it valid
+        return scene;
     }
 
-    Expected<PBRMaterial> processMaterial(const aiMaterial *loadedMaterial) {
-        PBRMaterial resultMaterial{
-            // TODO: Don't hardcode this
-            .shader = engineState->resourceManager.loadShader(
-                "resources/assets/shaders/vert.vert",
-                "resources/assets/shaders/frag.frag"
-            )
+    Expected<void> saveSceneCache(const std::filesystem::path& cachePath, const ImportedScene& scene,
+                                  const std::vector<std::string>& dependencies) {
+        std::string strings;
+        const auto addString = [&](const std::string& string) {
+            const SceneFormat::StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size())};
+            strings += string;
+            return ref;
         };
-        SPDLOG_TRACE("Loading material \"{}\"", loadedMaterial->GetName().C_Str());
 
-        aiString path;
-        if (loadedMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS) {
-            resultMaterial.albedo = engineState->resourceManager.loadTexture(path.C_Str());
+        std::vector<SceneFormat::Dependency> fileDependencies;
+        for (const std::string& path : dependencies) {
+            Expected<SceneFormat::Dependency> dependency = describeDependency(path);
+            if (!dependency.has_value())
+                return std::unexpected(FW_ERROR(dependency.error(), "Can't tell when the cached scene becomes stale"));
+            dependency->path = addString(path);
+            fileDependencies.push_back(dependency.value());
+        }
+        std::vector<SceneFormat::Material> materials;
+        for (const ImportedScene::Material& material : scene.materials) {
+            SceneFormat::Material& written = materials.emplace_back();
+            written.name = addString(material.name);
+            for (size_t slot = 0; slot < material.texturePaths.size(); slot++)
+                written.texturePaths[slot] = addString(material.texturePaths[slot]);
+            written.unitUVs = material.unitUVs ? 1 : 0;
         }
-        if (loadedMaterial->GetTexture(aiTextureType_NORMALS, 0, &path) == AI_SUCCESS) {
-            resultMaterial.normal = engineState->resourceManager.loadTexture(path.C_Str());
+        std::vector<SceneFormat::Mesh> meshes;
+        uint64_t vertexCount = 0, indexCount = 0, meshletCount = 0;
+        for (const ImportedScene::Mesh& mesh : scene.meshes) {
+            SceneFormat::Mesh& written = meshes.emplace_back();
+            written.firstVertex = vertexCount;
+            written.vertexCount = mesh.vertices.size();
+            written.firstIndex = indexCount;
+            written.indexCount = mesh.indices.size();
+            written.firstMeshlet = meshletCount;
+            written.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+            written.materialIndex = mesh.materialIndex;
+            for (int axis = 0; axis < 3; axis++) {
+                written.boundsMin[axis] = mesh.bounds.min[axis];
+                written.boundsMax[axis] = mesh.bounds.max[axis];
+            }
+            written.uvDensity = mesh.bounds.uvDensity;
+            vertexCount += mesh.vertices.size();
+            indexCount += mesh.indices.size();
+            meshletCount += mesh.meshlets.size();
         }
-        if (loadedMaterial->GetTexture(aiTextureType_SHININESS, 0, &path) == AI_SUCCESS) {
-            resultMaterial.roughness = engineState->resourceManager.loadTexture(path.C_Str());
+        std::vector<SceneFormat::Node> nodes;
+        std::vector<uint32_t> nodeMeshIndices;
+        for (const ImportedScene::Node& node : scene.nodes) {
+            SceneFormat::Node& written = nodes.emplace_back();
+            std::memcpy(written.transform, &node.transform, sizeof(written.transform));
+            written.firstMeshIndex = nodeMeshIndices.size();
+            written.meshIndexCount = static_cast<uint32_t>(node.meshIndices.size());
+            written.childCount = node.childCount;
+            nodeMeshIndices.insert(nodeMeshIndices.end(), node.meshIndices.begin(), node.meshIndices.end());
         }
-        if (loadedMaterial->GetTexture(aiTextureType_REFLECTION, 0, &path) == AI_SUCCESS) {
-            resultMaterial.metallic = engineState->resourceManager.loadTexture(path.C_Str());
+
+        SceneFormat::Header header{};
+        std::memcpy(header.magic, SceneFormat::MAGIC, sizeof(header.magic));
+        header.version = SceneFormat::VERSION;
+        header.importFlags = static_cast<uint32_t>(ASSIMP_FLAGS);
+        header.dependencyCount = static_cast<uint32_t>(fileDependencies.size());
+        header.materialCount = static_cast<uint32_t>(materials.size());
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        header.nodeCount = static_cast<uint32_t>(nodes.size());
+        header.nodeMeshIndexCount = nodeMeshIndices.size();
+        header.vertexCount = vertexCount;
+        header.indexCount = indexCount;
+        header.meshletCount = meshletCount;
+        header.stringsSize = strings.size();
+        uint64_t offset = sizeof(header);
+        const auto placeSection = [&](uint64_t& sectionOffset, const uint64_t size) {
+            sectionOffset = SceneFormat::alignSection(offset);
+            offset = sectionOffset + size;
+        };
+        placeSection(header.dependenciesOffset, fileDependencies.size() * sizeof(SceneFormat::Dependency));
+        placeSection(header.materialsOffset, materials.size() * sizeof(SceneFormat::Material));
+        placeSection(header.meshesOffset, meshes.size() * sizeof(SceneFormat::Mesh));
+        placeSection(header.nodesOffset, nodes.size() * sizeof(SceneFormat::Node));
+        placeSection(header.nodeMeshIndicesOffset, nodeMeshIndices.size() * sizeof(uint32_t));
+        placeSection(header.stringsOffset, strings.size());
+        placeSection(header.verticesOffset, vertexCount * sizeof(MeshVertex));
+        placeSection(header.indicesOffset, indexCount * sizeof(unsigned int));
+        placeSection(header.meshletsOffset, meshletCount * sizeof(MeshOptimizer::Meshlet));
+        header.fileSize = offset;
+
+        return writeFileAtomically(cachePath, [&](std::ostream& out) {
+            uint64_t position = 0;
+            const auto writeAt = [&](const uint64_t at, const void* data, const size_t size) {
+                static constexpr char zeros[SceneFormat::SECTION_ALIGNMENT] = {};
+                out.write(zeros, static_cast<std::streamsize>(at - position));
+                out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                position = at + size;
+            };
+            writeAt(0, &header, sizeof(header));
+            writeAt(header.dependenciesOffset, fileDependencies.data(), fileDependencies.size() * sizeof(SceneFormat::Dependency));
+            writeAt(header.materialsOffset, materials.data(), materials.size() * sizeof(SceneFormat::Material));
+            writeAt(header.meshesOffset, meshes.data(), meshes.size() * sizeof(SceneFormat::Mesh));
+            writeAt(header.nodesOffset, nodes.data(), nodes.size() * sizeof(SceneFormat::Node));
+            writeAt(header.nodeMeshIndicesOffset, nodeMeshIndices.data(), nodeMeshIndices.size() * sizeof(uint32_t));
+            writeAt(header.stringsOffset, strings.data(), strings.size());
+            writeAt(header.verticesOffset, nullptr, 0);
+            for (const ImportedScene::Mesh& mesh : scene.meshes)
+                writeAt(position, mesh.vertices.data(), mesh.vertices.size_bytes());
+            writeAt(header.indicesOffset, nullptr, 0);
+            for (const ImportedScene::Mesh& mesh : scene.meshes)
+                writeAt(position, mesh.indices.data(), mesh.indices.size_bytes());
+            writeAt(header.meshletsOffset, nullptr, 0);
+            for (const ImportedScene::Mesh& mesh : scene.meshes)
+                writeAt(position, mesh.meshlets.data(), mesh.meshlets.size_bytes());
+            return static_cast<bool>(out);
+        });
+    }
+#pragma endregion
+
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Vertices are interleaved from single precision assimp vectors");
+    static_assert(offsetof(MeshVertex, Normal) == 3 * sizeof(float) && offsetof(MeshVertex, TexCoords) == 6 * sizeof(float));
+
+    /*! Interleaves a mesh's separate position, normal and texture coordinate arrays into `vertices`. */
+    void interleaveVertices(const aiMesh& mesh, const std::span<MeshVertex> vertices) {
+        if (vertices.empty())
+            return;
+        // Missing attributes are read from zeros rather than checked for every vertex
+        static constexpr float ZERO[4] = {};
+        const float* positions = &mesh.mVertices[0].x;
+        const float* normals = mesh.mNormals ? &mesh.mNormals[0].x : ZERO;
+        const size_t normalStride = mesh.mNormals ? 3 : 0;
+        // We only support a single set of texture coordinates atm
+        const float* texCoords = mesh.mTextureCoords[0] ? &mesh.mTextureCoords[0][0].x : ZERO;
+        const size_t texCoordStride = mesh.mTextureCoords[0] ? 3 : 0;
+
+        size_t v = 0;
+#ifdef SCENE_SSE
+        // Each load reads the first component of the next vertex too, so the last vertex is left to the scalar loop
+        for (; v + 1 < vertices.size(); v++) {
+            const __m128 position = _mm_loadu_ps(positions + v * 3);
+            const __m128 normal = _mm_loadu_ps(normals + v * normalStride);
+            const __m128 texCoord = _mm_loadu_ps(texCoords + v * texCoordStride);
+            const __m128 positionZNormalX = _mm_shuffle_ps(position, normal, _MM_SHUFFLE(0, 0, 2, 2));
+            auto* out = reinterpret_cast<float*>(&vertices[v]);
+            _mm_storeu_ps(out, _mm_shuffle_ps(position, positionZNormalX, _MM_SHUFFLE(2, 0, 1, 0)));
+            _mm_storeu_ps(out + 4, _mm_shuffle_ps(normal, texCoord, _MM_SHUFFLE(1, 0, 2, 1)));
         }
-        if (loadedMaterial->GetTexture(aiTextureType_AMBIENT_OCCLUSION, 0, &path) == AI_SUCCESS) {
-            resultMaterial.ambientOcclusion = engineState->resourceManager.loadTexture(path.C_Str());
+#endif
+        for (; v < vertices.size(); v++) {
+            const float* normal = normals + v * normalStride;
+            const float* texCoord = texCoords + v * texCoordStride;
+            vertices[v].Position = glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+            vertices[v].Normal = glm::vec3(normal[0], normal[1], normal[2]);
+            vertices[v].TexCoords = glm::vec2(texCoord[0], texCoord[1]);
         }
+    }
 
-        return resultMaterial;
+    // Close enough that no vertex attribute can visibly tell the welded vertices apart
+    constexpr float WELD_QUANTUM = 1.0f / 65536.0f;
+    constexpr size_t FLOATS_PER_VERTEX = sizeof(MeshVertex) / sizeof(float);
+    static_assert(sizeof(MeshVertex) == FLOATS_PER_VERTEX * sizeof(float) && offsetof(MeshVertex, Position) == 0,
+        "The mesh optimizer treats vertices as plain floats, starting with the position");
+
+    /*! Welds and reorders a mesh for the vertex cache, overdraw and vertex fetch, in that order. */
+    void optimizeMesh(std::vector<MeshVertex>& vertices, std::vector<unsigned int>& indices) {
+        if (indices.empty())
+            return;
+        const auto floats = [&] {
+            return std::span(reinterpret_cast<float*>(vertices.data()), vertices.size() * FLOATS_PER_VERTEX);
+        };
+        vertices.resize(MeshOptimizer::weldVertices(floats(), FLOATS_PER_VERTEX, indices, WELD_QUANTUM));
+
+        std::vector<size_t> clusterStarts;
+        MeshOptimizer::optimizeVertexCache(indices, vertices.size(), &clusterStarts);
+        MeshOptimizer::optimizeOverdraw(indices, floats(), FLOATS_PER_VERTEX, clusterStarts);
+        vertices.resize(MeshOptimizer::optimizeVertexFetch(floats(), FLOATS_PER_VERTEX, indices));
     }
 
-    Expected<Mesh> processMesh(const aiMesh *loadedMesh, const std::shared_ptr<PBRMaterial>& material) {
-        Mesh resultMesh;
-        resultMesh.material = material;
+    void flattenNode(const aiNode* loadedNode, ImportedScene& scene, std::vector<std::pair<size_t, size_t>>& meshIndexRanges) { // NOLINT(*-no-recursion)
+        ImportedScene::Node& node = scene.nodes.emplace_back();
+        node.transform = UNPACK_MAT4(loadedNode->mTransformation);
+        node.childCount = loadedNode->mNumChildren;
+        meshIndexRanges.emplace_back(scene.nodeMeshIndexStorage.size(), loadedNode->mNumMeshes);
+        scene.nodeMeshIndexStorage.insert(scene.nodeMeshIndexStorage.end(), loadedNode->mMeshes, loadedNode->mMeshes + loadedNode->mNumMeshes);
+        for (unsigned int i = 0; i < loadedNode->mNumChildren; i++)
+            flattenNode(loadedNode->mChildren[i], scene, meshIndexRanges);
+    }
+
+    /*! Converts an assimp scene into plain arrays. Everything a mesh needs is worked out here, off the main thread. */
+    Expected<ImportedScene> flattenScene(const aiScene& scene) {
+        ImportedScene imported;
+        const std::vector<bool> unitUVs = getMaterialsWithUnitUVs(scene);
+        imported.materials.reserve(scene.mNumMaterials);
+        for (unsigned int i = 0; i < scene.mNumMaterials; i++) {
+            imported.materials.push_back({
+                .name = scene.mMaterials[i]->GetName().C_Str(),
+                .texturePaths = getMaterialTexturePaths(scene.mMaterials[i]),
+                .unitUVs = unitUVs[i],
+            });
+        }
 
-        resultMesh.vertices.reserve(loadedMesh->mNumVertices);
-        for (unsigned int i = 0; i < loadedMesh->mNumVertices; i++) {
-            MeshVertex vertex{};
-            vertex.Position = UNPACK_VEC3(loadedMesh->mVertices[i]);
-            vertex.Normal = UNPACK_VEC3(loadedMesh->mNormals[i]);
-            if (loadedMesh->mTextureCoords[0]) {  // We only support a single set of texture coordinates atm
-                vertex.TexCoords = UNPACK_VEC2(loadedMesh->mTextureCoords[0][i]);
+        // Meshes are converted and optimized independently, the largest ones usually dominate
+        struct ConvertedMesh {
+            std::vector<MeshVertex> vertices;
+            std::vector<unsigned int> indices;
+            std::vector<MeshOptimizer::Meshlet> meshlets;
+            MeshBounds bounds;
+            float acmrBefore = 0.0f, acmrAfter = 0.0f;
+        };
+        std::vector<ConvertedMesh> converted(scene.mNumMeshes);
+        engineState->threadPool.parallelFor(scene.mNumMeshes, [&](const size_t i) {
+            const aiMesh& loadedMesh = *scene.mMeshes[i];
+            ConvertedMesh& mesh = converted[i];
+            mesh.vertices.resize(loadedMesh.mNumVertices);
+            interleaveVertices(loadedMesh, mesh.vertices);
+            mesh.indices.reserve(static_cast<size_t>(loadedMesh.mNumFaces) * 3);  // Triangulated
+            for (unsigned int f = 0; f < loadedMesh.mNumFaces; f++) {
+                const aiFace& face = loadedMesh.mFaces[f];
+                if (face.mNumIndices != 3)
+                    continue;  // Points and lines left over by triangulation
+                mesh.indices.insert(mesh.indices.end(), face.mIndices, face.mIndices + 3);
             }
+            mesh.acmrBefore = MeshOptimizer::computeACMR(mesh.indices, mesh.vertices.size());
+            optimizeMesh(mesh.vertices, mesh.indices);
+            mesh.acmrAfter = MeshOptimizer::computeACMR(mesh.indices, mesh.vertices.size());
+            mesh.meshlets = MeshOptimizer::buildMeshlets(mesh.indices,
+                std::span(reinterpret_cast<const float*>(mesh.vertices.data()), mesh.vertices.size() * FLOATS_PER_VERTEX), FLOATS_PER_VERTEX);
+            // Meshes without texture coordinates end up with a UV density of 0, and always get full size textures
+            mesh.bounds = computeMeshBounds(mesh.vertices, mesh.indices);
+        });
 
-            resultMesh.vertices.push_back(vertex);
+        // Every mesh goes into the same arrays, sized up front so the spans into them stay valid
+        std::vector<std::pair<size_t, size_t>> vertexRanges, indexRanges, meshletRanges;
+        size_t vertexCount = 0, indexCount = 0, meshletCount = 0, originalVertexCount = 0;
+        float acmrBefore = 0.0f, acmrAfter = 0.0f;
+        for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
+            const ConvertedMesh& mesh = converted[i];
+            vertexRanges.emplace_back(vertexCount, mesh.vertices.size());
+            indexRanges.emplace_back(indexCount, mesh.indices.size());
+            meshletRanges.emplace_back(meshletCount, mesh.meshlets.size());
+            vertexCount += mesh.vertices.size();
+            indexCount += mesh.indices.size();
+            meshletCount += mesh.meshlets.size();
+            originalVertexCount += scene.mMeshes[i]->mNumVertices;
+            acmrBefore += mesh.acmrBefore * static_cast<float>(mesh.indices.size() / 3);
+            acmrAfter += mesh.acmrAfter * static_cast<float>(mesh.indices.size() / 3);
         }
-        resultMesh.indices.reserve(loadedMesh->mNumFaces * 3); // 3 indices per face, assuming all faces are triangles
-        for (unsigned int i = 0; i < loadedMesh->mNumFaces; i++) {
-            const aiFace &face = loadedMesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                resultMesh.indices.push_back(face.mIndices[j]);
+        if (indexCount > 0) {
+            const float triangleCount = static_cast<float>(indexCount / 3);
+            SPDLOG_DEBUG("Optimized {} meshes: {} of {} vertices kept, ACMR {:.3f} -> {:.3f}", scene.mNumMeshes,
+                vertexCount, originalVertexCount, acmrBefore / triangleCount, acmrAfter / triangleCount);
+        }
+        imported.vertexStorage.resize(vertexCount);
+        imported.indexStorage.resize(indexCount);
+        imported.meshletStorage.resize(meshletCount);
+        engineState->threadPool.parallelFor(scene.mNumMeshes, [&](const size_t i) {
+            std::ranges::copy(converted[i].vertices, imported.vertexStorage.begin() + static_cast<std::ptrdiff_t>(vertexRanges[i].first));
+            std::ranges::copy(converted[i].indices, imported.indexStorage.begin() + static_cast<std::ptrdiff_t>(indexRanges[i].first));
+            std::ranges::copy(converted[i].meshlets, imported.meshletStorage.begin() + static_cast<std::ptrdiff_t>(meshletRanges[i].first));
+        });
+        for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
+            ImportedScene::Mesh& mesh = imported.meshes.emplace_back();
+            mesh.vertices = std::span(imported.vertexStorage).subspan(vertexRanges[i].first, vertexRanges[i].second);
+            mesh.indices = std::span(imported.indexStorage).subspan(indexRanges[i].first, indexRanges[i].second);
+            mesh.materialIndex = scene.mMeshes[i]->mMaterialIndex;
+            mesh.bounds = converted[i].bounds;
+            mesh.meshlets = std::span(imported.meshletStorage).subspan(meshletRanges[i].first, meshletRanges[i].second);
         }
 
-        resultMesh.rebuildGl();
+        std::vector<std::pair<size_t, size_t>> meshIndexRanges;
+        flattenNode(scene.mRootNode, imported, meshIndexRanges);
+        for (size_t i = 0; i < imported.nodes.size(); i++)
+            imported.nodes[i].meshIndices = std::span(imported.nodeMeshIndexStorage)
+                .subspan(meshIndexRanges[i].first, meshIndexRanges[i].second);
+        return imported;
+    }
+
+    Expected<PBRMaterial> processMaterial(const ImportedScene::Material& importedMaterial, const MaterialTexturePaths& texturePaths,
+                                          const std::optional<AtlasedMaterial>& atlased, const std::shared_ptr<Shader>& shader);
+
+    /*! Links up the node tree from its pre-order form, where every node is followed by the subtrees of its children. */
+    SceneGraph buildSceneGraph(const std::vector<ImportedScene::Node>& nodes) {
+        size_t meshIndexCount = 0;
+        for (const ImportedScene::Node& node : nodes)
+            meshIndexCount += node.meshIndices.size();
+        SceneGraph graph(nodes.size(), meshIndexCount);
+
+        struct OpenNode {
+            uint32_t index;
+            uint32_t remainingChildren;
+            uint32_t lastChild = SceneGraph::NO_NODE;
+        };
+        std::vector<OpenNode> open;  // The ancestors still waiting for children
+        uint32_t meshIndexCursor = 0;
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            SceneGraph::Node& node = graph.nodes[i];
+            node.transform = nodes[i].transform;
+            node.firstMeshIndex = meshIndexCursor;
+            node.meshIndexCount = static_cast<uint32_t>(nodes[i].meshIndices.size());
+            std::ranges::copy(nodes[i].meshIndices, graph.meshIndices.begin() + meshIndexCursor);
+            meshIndexCursor += node.meshIndexCount;
 
-        return resultMesh;
+            if (!open.empty()) {
+                OpenNode& parent = open.back();
+                node.parent = parent.index;
+                if (parent.lastChild == SceneGraph::NO_NODE)
+                    graph.nodes[parent.index].firstChild = i;
+                else
+                    graph.nodes[parent.lastChild].nextSibling = i;
+                parent.lastChild = i;
+                parent.remainingChildren--;
+            }
+            if (nodes[i].childCount > 0)
+                open.push_back({i, nodes[i].childCount});
+            while (!open.empty() && open.back().remainingChildren == 0)
+                open.pop_back();
+        }
+        return graph;
+    }
+
+    Expected<Scene> loadScene(const ImportedScene& scene) {
+        Scene resultScene;
+        // Materials
+        std::vector<MaterialTexturePaths> texturePaths;
+        std::vector<bool> unitUVs;
+        texturePaths.reserve(scene.materials.size());
+        for (const ImportedScene::Material& material : scene.materials) {
+            texturePaths.push_back(material.texturePaths);
+            unitUVs.push_back(material.unitUVs);
+        }
+        const std::vector<std::optional<AtlasedMaterial>> atlasedMaterials = engineState->config.atlasSmallTextures
+            ? buildMaterialAtlases(texturePaths, unitUVs)
+            : std::vector<std::optional<AtlasedMaterial>>(scene.materials.size());
+        // Every texture that isn't atlased decodes on the workers while the ones before it are uploaded
+        std::vector<std::string> prefetchPaths;
+        for (size_t i = 0; i < scene.materials.size(); i++)
+            if (!atlasedMaterials[i].has_value())
+                std::ranges::copy_if(texturePaths[i], std::back_inserter(prefetchPaths), [](const std::string& path) { return !path.empty(); });
+        engineState->resourceManager.prefetchTextures(prefetchPaths);
+        // TODO: Don't hardcode this
+        const std::shared_ptr<Shader> shader = engineState->resourceManager.loadShader(
+            "resources/assets/shaders/vert.vert",
+            "resources/assets/shaders/frag.frag"
+        );
+        // Materials that only differ by name would load into identical materials, so they share one ID.
+        // Whether and where a material was atlased is part of the key, as tiling materials with the same textures aren't atlased
+        using AtlasKey = std::optional<std::pair<std::array<float, 4>, std::array<std::shared_ptr<ManagedTexture>, PBRMaterial::TEXTURE_SLOT_COUNT>>>;
+        std::vector<MaterialID> materialIDs(scene.materials.size());
+        std::map<std::pair<MaterialTexturePaths, AtlasKey>, MaterialID> materialsByKey;
+        resultScene.materials.reserve(scene.materials.size());
+        for (size_t i = 0; i < scene.materials.size(); i++) {
+            AtlasKey atlasKey;
+            if (const std::optional<AtlasedMaterial>& atlased = atlasedMaterials[i]; atlased.has_value()) {
+                const glm::vec4& uv = atlased->uvTransform;
+                atlasKey.emplace(std::array{uv.x, uv.y, uv.z, uv.w}, atlased->textures);
+            }
+            const auto [existing, inserted] = materialsByKey.try_emplace({texturePaths[i], std::move(atlasKey)},
+                static_cast<MaterialID>(resultScene.materials.size()));
+            materialIDs[i] = existing->second;
+            if (!inserted)
+                continue;
+            Expected<PBRMaterial> material = processMaterial(scene.materials[i], texturePaths[i], atlasedMaterials[i], shader);
+            if (!material.has_value())
+                return std::unexpected(FW_ERROR(material.error(), "Failed to load material "+std::to_string(i)));
+            resultScene.materials.push_back(std::move(material.value()));
+        }
+        SPDLOG_TRACE("Loaded {} distinct materials out of {}", resultScene.materials.size(), scene.materials.size());
+
+        // Meshes, staged on the workers and then uploaded straight from the imported arrays in one pass
+        for (const ImportedScene::Mesh& importedMesh : scene.meshes)
+            if (importedMesh.materialIndex >= materialIDs.size())
+                return std::unexpected(ERROR(
+                    "Encountered invalid mesh material index " + std::to_string(importedMesh.materialIndex)));
+        std::vector<Mesh> meshes(scene.meshes.size());
+        std::vector<StagedMeshBuffers> stagedBuffers(scene.meshes.size());
+        const VertexFormat vertexFormat = Engine::ResourceManager::getMeshVertexFormat();
+        engineState->threadPool.parallelFor(scene.meshes.size(), [&](const size_t i) {
+            const ImportedScene::Mesh& importedMesh = scene.meshes[i];
+            Mesh& mesh = meshes[i];
+            mesh.vertices.assign(importedMesh.vertices.begin(), importedMesh.vertices.end());
+            mesh.indices.assign(importedMesh.indices.begin(), importedMesh.indices.end());
+            mesh.boundsMin = importedMesh.bounds.min;
+            mesh.boundsMax = importedMesh.bounds.max;
+            mesh.uvDensity = importedMesh.bounds.uvDensity;
+            mesh.meshlets = Culling::MeshletBounds::build(importedMesh.meshlets);
+            stagedBuffers[i] = stageMeshBuffers(importedMesh.vertices, importedMesh.indices, vertexFormat);
+        });
+        resultScene.meshes.reserve(scene.meshes.size());
+        for (size_t i = 0; i < scene.meshes.size(); i++) {
+            meshes[i].materialID = materialIDs[scene.meshes[i].materialIndex];
+            meshes[i].buffers = engineState->resourceManager.loadMeshBuffers(stagedBuffers[i]);
+            resultScene.meshes.push_back(std::move(meshes[i]));
+        }
+        // Nodes
+        if (scene.nodes.empty())
+            return std::unexpected(ERROR("Scene has no root node"));
+        resultScene.graph = buildSceneGraph(scene.nodes);
+
+        return resultScene;
+    }
+
+    Expected<PBRMaterial> processMaterial(const ImportedScene::Material& importedMaterial, const MaterialTexturePaths& texturePaths,
+                                          const std::optional<AtlasedMaterial>& atlased, const std::shared_ptr<Shader>& shader) {
+        PBRMaterial resultMaterial{.shader = shader};
+        SPDLOG_TRACE("Loading material \"{}\"", importedMaterial.name);
+
+        const auto slots = resultMaterial.getTextureSlots();
+        for (size_t slot = 0; slot < slots.size(); slot++) {
+            if (atlased.has_value())
+                *slots[slot] = atlased->textures[slot];
+            else if (!texturePaths[slot].empty())
+                *slots[slot] = engineState->resourceManager.loadTexture(texturePaths[slot]);
+        }
+        if (atlased.has_value())
+            resultMaterial.uvTransform = atlased->uvTransform;
+
+        return resultMaterial;
     }
 }
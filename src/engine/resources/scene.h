@@ -1,5 +1,12 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <expected>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
 #include <valarray>
 #include <vector>
 #include <glm/mat4x4.hpp>
@@ -7,29 +14,63 @@
 #include "engine/resources/material.h"
 #include "engine/resources/mesh.h"
 #include "engine/util/error.h"
+#include "engine/util/resource_pack.h"
 
 
-struct aiScene;
-
 namespace Resource
 {
-    struct Node {
-        std::vector<Node> children;
-        glm::mat4x4 transform;
+    /*!
+     * The node tree of a scene, as flat arrays in pre-order so parents always come before their children.
+     * @details Both arrays are allocated together from one arena owned by the graph, so loading a scene doesn't allocate per node.
+     */
+    class SceneGraph {
+    public:
+        static constexpr uint32_t NO_NODE = ~0u;
+
+        struct Node {
+            glm::mat4x4 transform;
+            uint32_t parent = NO_NODE;
+            uint32_t firstChild = NO_NODE;
+            uint32_t nextSibling = NO_NODE;
+            /*! Range of \ref meshIndices holding the meshes drawn by this node. */
+            uint32_t firstMeshIndex = 0, meshIndexCount = 0;
+        };
+
+        std::span<Node> nodes;
+        std::span<uint32_t> meshIndices;
+
+        SceneGraph() = default;
+        /*! Allocates room for exactly this many nodes and mesh indices, default initialised. */
+        SceneGraph(size_t nodeCount, size_t meshIndexCount);
+
+        [[nodiscard]] std::span<const uint32_t> getMeshIndices(const Node& node) const {
+            return meshIndices.subspan(node.firstMeshIndex, node.meshIndexCount);
+        }
+        [[nodiscard]] size_t getAllocatedBytes() const { return nodes.size_bytes() + meshIndices.size_bytes(); }
+
+        // Non-copyable
+        SceneGraph(const SceneGraph&) = delete;
+        SceneGraph& operator=(const SceneGraph&) = delete;
+        // Moveable, the arena stays where it is
+        SceneGraph(SceneGraph&& other) noexcept;
+        SceneGraph& operator=(SceneGraph&& other) noexcept;
 
-        std::vector<unsigned int> meshIndices;
+    private:
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
     };
 
     class Scene {
     public:
-        Node root = {};
+        SceneGraph graph;
         std::vector<Mesh> meshes;
+        /*! Every material of the scene, once, indexed by the meshes' \ref MaterialID. */
         std::vector<PBRMaterial> materials;
 
-        Expected<void> Draw(const glm::mat4& transform = glm::mat4(1.0)) const;
+        /*! @param view If given, meshes and their meshlets outside of it are skipped. */
+        Expected<void> Draw(const glm::mat4& transform = glm::mat4(1.0), const Culling::View* view = nullptr) const;
 
     private:
-        Expected<void> DrawNode(const Node& node, const glm::mat4& parentTransform) const;
+        mutable std::vector<glm::mat4> worldTransforms;  // Scratch space for Draw()
 
     public:
         // // Non-copyable
@@ -43,7 +84,51 @@ namespace Resource
 
 namespace Resource::Loading
 {
+    /*!
+     * A scene imported from a file, flattened into plain arrays but not yet converted into engine resources.
+     * @details Comes either from an assimp import, or straight from a mapped scene cache file.
+     */
+    struct ImportedScene {
+        struct Material {
+            std::string name;
+            std::array<std::string, PBRMaterial::TEXTURE_SLOT_COUNT> texturePaths;  // Empty for unused slots
+            /*! Whether every mesh using the material keeps its texture coordinates within its textures. */
+            bool unitUVs = true;
+        };
+        struct Mesh {
+            std::span<const MeshVertex> vertices;
+            std::span<const unsigned int> indices;
+            unsigned int materialIndex = 0;
+            MeshBounds bounds;
+            std::span<const MeshOptimizer::Meshlet> meshlets;
+        };
+        /*! A node of the tree in pre-order, followed by its children. */
+        struct Node {
+            glm::mat4x4 transform;
+            std::span<const uint32_t> meshIndices;
+            uint32_t childCount = 0;
+        };
+
+        std::vector<Material> materials;
+        std::vector<Mesh> meshes;
+        std::vector<Node> nodes;
+
+        /*! Backs the spans above: the mapped cache file, or the geometry converted from assimp. */
+        std::optional<MappedFile> mapping;
+        std::vector<MeshVertex> vertexStorage;
+        std::vector<unsigned int> indexStorage;
+        std::vector<uint32_t> nodeMeshIndexStorage;
+        std::vector<MeshOptimizer::Meshlet> meshletStorage;
+    };
+    /*!
+     * Imports a scene file, through the scene cache.
+     * @details The first import of a file runs assimp and writes the result to `cache/scenes`.
+     *          Later imports map that file and use it in place, as long as none of the files the import read have changed.
+     * @note Does not touch OpenGL or the resource manager, so it is safe to call from any thread.
+     */
+    [[nodiscard]] Expected<ImportedScene> importScene(const std::string& path);
+
     [[nodiscard]] Expected<Scene> loadScene(const std::string& path);
     [[nodiscard]] Expected<Scene> loadScene(const unsigned char* data, int size);
-    [[nodiscard]] Expected<Scene> loadScene(const aiScene& scene);
+    [[nodiscard]] Expected<Scene> loadScene(const ImportedScene& scene);
 }
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+
+/*
+ * On-disk layout of a cooked scene, written to the scene cache after a scene is first imported (all values little-endian):
+ *   SceneFormat::Header
+ *   SceneFormat::Dependency[dependencyCount]  (every file the import read, to tell when the cache is stale)
+ *   SceneFormat::Material[materialCount]
+ *   SceneFormat::Mesh[meshCount]
+ *   SceneFormat::Node[nodeCount]              (the node tree flattened in pre-order)
+ *   uint32_t[nodeMeshIndexCount]              (the meshes drawn by each node)
+ *   char[]                                    (string table, not null-terminated)
+ *   vertices                                  (VERTEX_SIZE bytes each, laid out exactly like Resource::MeshVertex)
+ *   uint32_t[]                                (indices, relative to the first vertex of their mesh)
+ *   SceneFormat::Meshlet[meshletCount]        (laid out exactly like MeshOptimizer::Meshlet)
+ *
+ * Every section starts at a multiple of SECTION_ALIGNMENT, so a mapped file can be used in place.
+ */
+namespace SceneFormat {
+    constexpr char MAGIC[8] = {'L', 'L', 'G', 'S', 'C', 'E', 'N', 'E'};
+    // Bump whenever the layout, the vertex format or the way scenes are converted changes
+    constexpr uint32_t VERSION = 3;
+    constexpr uint64_t SECTION_ALIGNMENT = 16;
+    constexpr uint32_t VERTEX_SIZE = 32;
+    constexpr uint32_t TEXTURE_SLOT_COUNT = 5;
+    constexpr uint32_t MESHLET_SIZE = 40;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t importFlags;  // The assimp post processing steps used
+        uint32_t dependencyCount;
+        uint32_t materialCount;
+        uint32_t meshCount;
+        uint32_t nodeCount;
+        uint64_t nodeMeshIndexCount;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t meshletCount;
+        uint64_t dependenciesOffset;
+        uint64_t materialsOffset;
+        uint64_t meshesOffset;
+        uint64_t nodesOffset;
+        uint64_t nodeMeshIndicesOffset;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint64_t verticesOffset;
+        uint64_t indicesOffset;
+        uint64_t meshletsOffset;
+        uint64_t fileSize;
+    };
+    static_assert(sizeof(Header) == 152);
+
+    struct StringRef {
+        uint32_t offset;  // Relative to the start of the string table
+        uint32_t length;
+    };
+    static_assert(sizeof(StringRef) == 8);
+
+    struct Dependency {
+        uint64_t contentHash;
+        uint64_t size;
+        int64_t modifiedTime;  // 0 for files read from a resource pack, which are checked by hash alone
+        StringRef path;
+    };
+    static_assert(sizeof(Dependency) == 32);
+
+    struct Material {
+        StringRef name;
+        StringRef texturePaths[TEXTURE_SLOT_COUNT];  // Empty for unused slots
+        uint32_t unitUVs;  // Whether every mesh using it keeps its texture coordinates within [0, 1]
+        uint32_t padding;
+    };
+    static_assert(sizeof(Material) == 56);
+
+    struct Mesh {
+        uint64_t firstVertex;
+        uint64_t vertexCount;
+        uint64_t firstIndex;
+        uint64_t indexCount;
+        uint64_t firstMeshlet;
+        uint32_t meshletCount;
+        uint32_t materialIndex;
+        float boundsMin[3];
+        float boundsMax[3];
+        float uvDensity;
+        uint32_t padding;
+    };
+    static_assert(sizeof(Mesh) == 80);
+
+    struct Node {
+        float transform[16];  // Column major, like glm
+        uint64_t firstMeshIndex;
+        uint32_t meshIndexCount;
+        uint32_t childCount;  // Its children follow it, each with their own subtree
+    };
+    static_assert(sizeof(Node) == 80);
+
+    constexpr uint64_t alignSection(const uint64_t offset) {
+        return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+}
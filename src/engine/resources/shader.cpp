@@ -130,13 +130,24 @@ namespace Resource::Loading
         const std::string& filePath,
         const ShaderType shaderType
     ) {
+        const Expected<std::string> shaderSrc = loadShaderSourceFile(filePath);
+        if (!shaderSrc.has_value())
+            return std::unexpected(shaderSrc.error());
+        return compileSingleShader(shaderSrc.value().c_str(), shaderType);
+    }
+
+    Expected<std::string> loadShaderSourceFile(const std::string& filePath) {
         std::expected<std::string, Error> shaderSrc = readTextFile(filePath);
         if (!shaderSrc.has_value())
             return std::unexpected(FW_ERROR(shaderSrc.error(), "Failed to read shader file"));
-        shaderSrc = preprocessShaderSource(shaderSrc.value());
+        shaderSrc = preprocessShaderSource(std::move(shaderSrc.value()));
         if (!shaderSrc.has_value())
             return std::unexpected(FW_ERROR(shaderSrc.error(), std::string("Failed to preprocess shader source")));
-        return compileSingleShader(shaderSrc.value().c_str(), shaderType);
+        return shaderSrc;
+    }
+
+    Expected<unsigned int> compileGLShader(const std::string& preprocessedSrc, const ShaderType shaderType) {
+        return compileSingleShader(preprocessedSrc.c_str(), shaderType);
     }
 
     std::expected<unsigned int, Error> loadGLShaderSource(const std::string& shaderSrc, const ShaderType shaderType) {
@@ -97,4 +97,19 @@ namespace Resource::Loading
      *       Pass the resulting shader ID(s) to the Shader constructor to link them into a program.
      */
     [[nodiscard]] std::expected<unsigned int, Error> loadGLShaderSource(const std::string& shaderSrc, ShaderType shaderType);
+
+    /*!
+     * Reads and preprocesses a GLSL shader file, without compiling it.
+     * @param filePath The path to the GLSL shader file.
+     * @return The preprocessed source if successful, or an error.
+     * @note Does not touch OpenGL, so it is safe to call from any thread.
+     */
+    [[nodiscard]] Expected<std::string> loadShaderSourceFile(const std::string& filePath);
+    /*!
+     * Compiles an already preprocessed GLSL shader source.
+     * @param preprocessedSrc The source, as returned by \ref loadShaderSourceFile() "loadShaderSourceFile".
+     * @param shaderType The type of shader to compile (for example vertex or fragment).
+     * @return The shader ID if successful, or an error.
+     */
+    [[nodiscard]] Expected<unsigned int> compileGLShader(const std::string& preprocessedSrc, ShaderType shaderType);
 }
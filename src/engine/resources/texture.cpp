@@ -1,16 +1,138 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+// SSSE3 isn't part of the x86-64 baseline, so it is picked at runtime rather than at compile time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTURE_SSSE3_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include "engine/resources/dds.h"
+#include "engine/resources/environment.h"
+#include "engine/resources/mipmap.h"
+#include "engine/state.h"
 #include "engine/util/error.h"
+#include "engine/util/file.h"
+#include "engine/util/hash.h"
 #include "engine/util/logging.h"
+#include "engine/util/resource_pack.h"
 
 namespace Resource {
-    ManagedTexture::ManagedTexture(const unsigned int textureID): textureID(textureID) {}
+    ManagedTexture::ManagedTexture(const unsigned int textureID, const GLenum target)
+        : textureID(textureID), target(target) {}
     ManagedTexture::~ManagedTexture() {
         glDeleteTextures(1, &textureID);
     }
+
+    size_t getTextureMemoryUsage(const unsigned int textureID, const GLenum target) {
+        if (textureID == 0)
+            return 0;
+        glBindTexture(target, textureID);
+        // Cubemap faces have to be queried individually, but they all share the same format and size
+        const GLenum levelTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        const size_t faceCount = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+
+        size_t totalBytes = 0;
+        GLint maxLevel = 1000;
+        glGetTexParameteriv(target, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        for (GLint level = 0; level <= maxLevel; level++) {
+            GLint width = 0, height = 0;
+            glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_HEIGHT, &height);
+            if (width == 0 || height == 0)
+                break;  // Past the last allocated level
+
+            GLint isCompressed = GL_FALSE;
+            glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_COMPRESSED, &isCompressed);
+            if (isCompressed) {
+                GLint compressedSize = 0;
+                glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+                totalBytes += static_cast<size_t>(compressedSize) * faceCount;
+                continue;
+            }
+
+            GLint texelBits = 0;
+            for (const GLenum sizeQuery : {
+                GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE
+            }) {
+                GLint componentBits = 0;
+                glGetTexLevelParameteriv(levelTarget, level, sizeQuery, &componentBits);
+                texelBits += componentBits;
+            }
+            totalBytes += static_cast<size_t>(width) * height * ((texelBits + 7) / 8) * faceCount;
+        }
+        return totalBytes;
+    }
+
+    bool demoteTexture(ManagedTexture& texture, const int maxSize) {
+        if (texture.textureID == 0 || texture.target != GL_TEXTURE_2D)
+            return false;
+        glBindTexture(GL_TEXTURE_2D, texture.textureID);
+
+        GLint width = 0, height = 0, internalFormat = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+
+        // Find the first mip level that fits, and how many levels there are in total
+        GLint firstLevel = 0;
+        while (std::max(width >> firstLevel, height >> firstLevel) > maxSize)
+            firstLevel++;
+        if (firstLevel == 0)
+            return false;  // Already small enough
+        GLint levelCount = 0;
+        for (GLint level = firstLevel; ; level++) {
+            GLint levelWidth = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &levelWidth);
+            if (levelWidth == 0) break;
+            levelCount++;
+        }
+        if (levelCount == 0)
+            return false;  // No mipmaps, nothing smaller to keep
+
+        GLint wrapS, wrapT, minFilter, magFilter;
+        std::array<GLint, 4> swizzle{};
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrapS);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrapT);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &magFilter);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());  // Greyscale textures sample as grey
+
+        unsigned int demotedID;
+        glGenTextures(1, &demotedID);
+        glBindTexture(GL_TEXTURE_2D, demotedID);
+        glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat,
+            std::max(width >> firstLevel, 1), std::max(height >> firstLevel, 1));
+        // Copy on the GPU, the pixel data never has to make a round trip through the CPU
+        for (GLint level = 0; level < levelCount; level++) {
+            glCopyImageSubData(
+                texture.textureID, GL_TEXTURE_2D, firstLevel + level, 0, 0, 0,
+                demotedID, GL_TEXTURE_2D, level, 0, 0, 0,
+                std::max(width >> (firstLevel + level), 1), std::max(height >> (firstLevel + level), 1), 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+
+        glDeleteTextures(1, &texture.textureID);
+        texture.textureID = demotedID;
+        texture.gpuBytes = getTextureMemoryUsage(demotedID, GL_TEXTURE_2D);
+        texture.residentSize = std::max(std::max(width >> firstLevel, 1), std::max(height >> firstLevel, 1));
+        texture.residency = TextureResidency::DEMOTED;
+        return true;
+    }
 }
 
 namespace Resource::Loading {
@@ -24,7 +146,11 @@ namespace Resource::Loading {
     */
     Expected<ImageData> loadImage(const char *filePath) {
         int width, height, channelCount;
-        stbi_uc *imgData = stbi_load(filePath, &width, &height, &channelCount, 0);
+        stbi_uc *imgData;
+        if (const auto packed = findPackedFile(filePath))  // Decode straight from the mapped pack
+            imgData = stbi_load_from_memory(packed->data(), static_cast<int>(packed->size()), &width, &height, &channelCount, 0);
+        else
+            imgData = stbi_load(filePath, &width, &height, &channelCount, 0);
         if (!imgData) {
             stbi_image_free(imgData);
             return std::unexpected(ERROR(
@@ -43,27 +169,90 @@ namespace Resource::Loading {
         return ImageData{width, height, channelCount, imgData};
     }
 
-    GLint getGLChannels(const int channelCount) {
+    void expandRGBToRGBAScalar(const unsigned char* rgb, unsigned char* rgba, const size_t pixelCount) {
+        for (size_t i = 0; i < pixelCount; i++) {
+            rgba[i * 4 + 0] = rgb[i * 3 + 0];
+            rgba[i * 4 + 1] = rgb[i * 3 + 1];
+            rgba[i * 4 + 2] = rgb[i * 3 + 2];
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+#ifdef TEXTURE_SSSE3_DISPATCH
+    __attribute__((target("ssse3")))
+    void expandRGBToRGBASSSE3(const unsigned char* rgb, unsigned char* rgba, const size_t pixelCount) {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        size_t i = 0;
+        // Every load reads 16 bytes to use 12 of them, so leave enough pixels at the end to never read past the buffer
+        for (; i + 6 <= pixelCount; i += 4) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+        }
+        expandRGBToRGBAScalar(rgb + i * 3, rgba + i * 4, pixelCount - i);
+    }
+#endif
+    /*! Adds an opaque alpha channel to tightly packed RGB pixels. */
+    void expandRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, const size_t pixelCount) {
+#ifdef TEXTURE_SSSE3_DISPATCH
+        static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+        if (hasSSSE3)
+            return expandRGBToRGBASSSE3(rgb, rgba, pixelCount);
+#endif
+        expandRGBToRGBAScalar(rgb, rgba, pixelCount);
+    }
+
+    struct GLPixelFormat {
+        GLenum internalFormat;
+        GLenum format;
+    };
+    GLPixelFormat getGLPixelFormat(const int channelCount, const bool srgb) {
         switch (channelCount) {
-            case 1: return GL_RED;
-            case 3: return GL_RGB;
-            case 4: return GL_RGBA;
-            default: {
-                SPDLOG_WARN("Unknown channel count %d, defaulting to single channel", channelCount);
-                return GL_RED;  // Least likely to segfault :+1:
-            }
+            case 1: return {GL_R8, GL_RED};
+            case 2: return {GL_RG8, GL_RG};
+            case 4:
+            default: return {static_cast<GLenum>(srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8), GL_RGBA};
         }
     }
 
-    std::expected<unsigned int, Error> loadTexture(const ImageData& imgData) {
-        const GLint format = getGLChannels(imgData.channelCount);
+    /*! @param mipData Levels generated on the CPU, see \ref Image::mipData. Empty to have the driver generate them. */
+    std::expected<unsigned int, Error> loadTexture(const ImageData& imgData, const bool srgb,
+                                                   const std::span<const unsigned char> mipData = {}) {
+        if (imgData.channelCount < 1 || imgData.channelCount > 4)
+            return std::unexpected(ERROR("Unsupported channel count: " + std::to_string(imgData.channelCount)));
+        // RGB rows are rarely 4 byte aligned and most drivers repack them on upload, RGBA can be copied as is
+        const unsigned char* pixels = imgData.imgData;
+        int channelCount = imgData.channelCount;
+        std::vector<unsigned char> expanded;
+        if (channelCount == 3) {
+            expanded.resize(static_cast<size_t>(imgData.width) * imgData.height * 4);
+            expandRGBToRGBA(pixels, expanded.data(), static_cast<size_t>(imgData.width) * imgData.height);
+            pixels = expanded.data();
+            channelCount = 4;
+        }
+        const auto [internalFormat, format] = getGLPixelFormat(channelCount, srgb);
 
         unsigned int textureID;
         glGenTextures(1, &textureID);
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, imgData.width, imgData.height, 0, format, GL_UNSIGNED_BYTE, imgData.imgData);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexStorage2D(GL_TEXTURE_2D, Mipmap::getLevelCount(imgData.width, imgData.height), internalFormat,
+            imgData.width, imgData.height);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, channelCount == 4 ? 4 : 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imgData.width, imgData.height, format, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (!mipData.empty() && channelCount == 4) {
+            size_t offset = 0;
+            for (int level = 1; level < Mipmap::getLevelCount(imgData.width, imgData.height); level++) {
+                const int width = std::max(imgData.width >> level, 1), height = std::max(imgData.height >> level, 1);
+                glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, mipData.data() + offset);
+                offset += static_cast<size_t>(width) * height * 4;
+            }
+        } else
+            glGenerateMipmap(GL_TEXTURE_2D);
+        if (channelCount <= 2) {  // Sample greyscale as grey rather than red
+            const std::array<GLint, 4> swizzle = {GL_RED, GL_RED, GL_RED, channelCount == 2 ? GL_GREEN : GL_ONE};
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+        }
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);  // TODO: GL_CLAMP_TO_EDGE to better support alpha textures?
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -73,14 +262,358 @@ namespace Resource::Loading {
         return textureID;
     }
 
+    void ImageDeleter::operator()(unsigned char* pixels) const {
+        stbi_image_free(pixels);
+    }
+
+    constexpr const char* COMPRESSION_CACHE_DIRECTORY = "cache/textures";
+    // Bump whenever the runtime encoders change, so entries made by older versions are never used
+    constexpr uint64_t COMPRESSION_CACHE_VERSION = 1;
+
+    std::filesystem::path getCompressionCachePath(const uint64_t sourceHash) {
+        return std::filesystem::path(COMPRESSION_CACHE_DIRECTORY) / fmt::format("{:016x}.dds", sourceHash);
+    }
+
+    GLenum getGLCompressedFormat(const BlockCompression::BlockFormat format, const bool srgb) {
+        switch (format) {
+            case BlockCompression::BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BlockCompression::BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BlockCompression::BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+            case BlockCompression::BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+            case BlockCompression::BlockFormat::BC7:
+            default: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+    }
+
+    uint64_t hashCompressedImage(const Image& image) {
+        const std::array<int, 4> description = {image.width, image.height, static_cast<int>(image.blockFormat.value()), image.levelCount};
+        return xxh64(image.compressedData.data(), image.compressedData.size(), xxh64(description.data(), sizeof(description)));
+    }
+
+    Expected<Image> parseDds(const std::span<const unsigned char> bytes) {
+        uint32_t magic = 0;
+        Dds::Header header{};
+        if (bytes.size() < sizeof(magic) + sizeof(header))
+            return std::unexpected(ERROR("File is too small to be a DDS file"));
+        std::memcpy(&magic, bytes.data(), sizeof(magic));
+        std::memcpy(&header, bytes.data() + sizeof(magic), sizeof(header));
+        if (magic != Dds::MAGIC || header.size != sizeof(header))
+            return std::unexpected(ERROR("Not a DDS file"));
+        size_t offset = sizeof(magic) + sizeof(header);
+
+        std::optional<BlockCompression::BlockFormat> format;
+        if (header.pixelFormat.flags & Dds::PIXELFORMAT_FOURCC && header.pixelFormat.fourCC == Dds::FOURCC_DX10) {
+            Dds::HeaderDX10 headerDX10{};
+            if (bytes.size() < offset + sizeof(headerDX10))
+                return std::unexpected(ERROR("DDS file is truncated"));
+            std::memcpy(&headerDX10, bytes.data() + offset, sizeof(headerDX10));
+            offset += sizeof(headerDX10);
+            if (headerDX10.resourceDimension != Dds::DIMENSION_TEXTURE2D || headerDX10.arraySize != 1)
+                return std::unexpected(ERROR("Only single 2D DDS textures are supported"));
+            format = Dds::fromDxgiFormat(headerDX10.dxgiFormat);
+        } else if (header.pixelFormat.flags & Dds::PIXELFORMAT_FOURCC)
+            format = Dds::fromFourCC(header.pixelFormat.fourCC);
+        if (!format.has_value())
+            return std::unexpected(ERROR("Unsupported DDS pixel format, only BC1, BC3, BC4, BC5 and BC7 are supported"));
+
+        const int width = static_cast<int>(header.width), height = static_cast<int>(header.height);
+        const int levelCount = header.flags & Dds::FLAG_MIPMAPCOUNT ? std::max<int>(static_cast<int>(header.mipMapCount), 1) : 1;
+        if (width <= 0 || height <= 0 || levelCount > static_cast<int>(std::bit_width(static_cast<unsigned int>(std::max(width, height)))))
+            return std::unexpected(ERROR("DDS file has invalid dimensions"));
+        size_t dataSize = 0;
+        for (int level = 0; level < levelCount; level++)
+            dataSize += BlockCompression::getCompressedSize(format.value(), std::max(width >> level, 1), std::max(height >> level, 1));
+        if (bytes.size() < offset + dataSize)
+            return std::unexpected(ERROR("DDS file is truncated"));
+
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.channelCount = BlockCompression::getChannelCount(format.value());
+        image.blockFormat = format;
+        image.levelCount = levelCount;
+        image.compressedData.assign(bytes.begin() + static_cast<std::ptrdiff_t>(offset),
+            bytes.begin() + static_cast<std::ptrdiff_t>(offset + dataSize));
+        image.contentHash = hashCompressedImage(image);
+        return image;
+    }
+
+    /*!
+     * Loads the cooked version of an image, as written by the `texcook` tool next to the source image.
+     * @return Nothing if there is no usable cooked version.
+     */
+    std::optional<Expected<Image>> decodeCookedImage(const std::string& filePath) {
+        std::filesystem::path cookedPath(filePath);
+        cookedPath.replace_extension(".dds");
+        const std::string cookedPathString = cookedPath.generic_string();
+        if (const auto packed = findPackedFile(cookedPathString))
+            return parseDds(packed.value());
+
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(cookedPath, ec))
+            return std::nullopt;
+        // A stale cook would silently hide any edits made to the source image
+        if (cookedPathString != filePath && std::filesystem::exists(filePath, ec)
+            && std::filesystem::last_write_time(filePath, ec) > std::filesystem::last_write_time(cookedPath, ec)) {
+            SPDLOG_WARN("Ignoring cooked texture \"{}\" as it is older than its source image", cookedPathString);
+            return std::nullopt;
+        }
+        const Expected<MappedFile> file = MappedFile::open(cookedPathString);
+        if (!file.has_value())
+            return std::unexpected(FW_ERROR(file.error(), "Failed to open cooked texture"));
+        return parseDds(file->bytes());
+    }
+
+    /*! Uploads the mip levels of a cooked image from `firstLevel` down to already allocated storage. */
+    void uploadCompressedLevels(const GLenum target, const Image& image, const GLenum format, const int firstLevel = 0) {
+        size_t offset = 0;
+        for (int level = 0; level < image.levelCount; level++) {
+            const int width = std::max(image.width >> level, 1), height = std::max(image.height >> level, 1);
+            const size_t size = BlockCompression::getCompressedSize(image.blockFormat.value(), width, height);
+            if (level >= firstLevel)
+                glCompressedTexSubImage2D(target, level - firstLevel, 0, 0, width, height, format,
+                    static_cast<GLsizei>(size), image.compressedData.data() + offset);
+            offset += size;
+        }
+    }
+
+    Expected<unsigned int> uploadCompressedTexture(const Image& image, const int firstLevel) {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const GLenum format = getGLCompressedFormat(image.blockFormat.value(), image.srgb);
+        glTexStorage2D(GL_TEXTURE_2D, image.levelCount - firstLevel, format,
+            std::max(image.width >> firstLevel, 1), std::max(image.height >> firstLevel, 1));
+        uploadCompressedLevels(GL_TEXTURE_2D, image, format, firstLevel);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        return textureID;
+    }
+
+    /*! Takes ownership of decoded pixels, expanding RGB to RGBA while still on the decoding thread. */
+    Image makeImage(ImageData imgData) {
+        if (imgData.channelCount == 3) {
+            const size_t pixelCount = static_cast<size_t>(imgData.width) * imgData.height;
+            // stb_image allocates with malloc, so the expanded copy can be freed by the same deleter
+            auto* expanded = static_cast<unsigned char*>(std::malloc(pixelCount * 4));
+            if (expanded != nullptr) {
+                expandRGBToRGBA(imgData.imgData, expanded, pixelCount);
+                stbi_image_free(imgData.imgData);
+                imgData.imgData = expanded;
+                imgData.channelCount = 4;
+            }
+        }
+        const std::array<int, 3> dimensions = {imgData.width, imgData.height, imgData.channelCount};
+        const uint64_t contentHash = xxh64(imgData.imgData,
+            static_cast<size_t>(imgData.width) * imgData.height * imgData.channelCount,
+            xxh64(dimensions.data(), sizeof(dimensions)));
+        Image image;
+        image.width = imgData.width;
+        image.height = imgData.height;
+        image.channelCount = imgData.channelCount;
+        image.pixels = std::unique_ptr<unsigned char, ImageDeleter>(imgData.imgData);
+        image.contentHash = contentHash;
+        return image;
+    }
+
+    /*! Loads a source image through the compression cache, hashing the encoded file so a cache hit never has to decode it. */
+    Expected<Image> decodeCachedImage(const std::string& filePath) {
+        std::optional<MappedFile> mappedFile;
+        std::span<const unsigned char> bytes;
+        if (const auto packed = findPackedFile(filePath))
+            bytes = packed.value();
+        else {
+            Expected<MappedFile> file = MappedFile::open(filePath);
+            if (!file.has_value())
+                return std::unexpected(FW_ERROR(file.error(), "Failed to open texture \"" + filePath + "\""));
+            mappedFile = std::move(file.value());
+            bytes = mappedFile->bytes();
+        }
+        // The usage picks the format, so the same file used in different ways gets separate entries
+        const BlockCompression::TextureUsage usage = BlockCompression::guessTextureUsage(filePath);
+        const uint64_t sourceHash = xxh64(bytes.data(), bytes.size(), COMPRESSION_CACHE_VERSION << 8 | static_cast<uint64_t>(usage));
+
+        const std::filesystem::path cachePath = getCompressionCachePath(sourceHash);
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(cachePath, ec)) {
+            const Expected<MappedFile> cacheFile = MappedFile::open(cachePath.generic_string());
+            Expected<Image> cached = cacheFile.has_value()
+                ? parseDds(cacheFile->bytes())
+                : std::unexpected(cacheFile.error());
+            if (cached.has_value()) {
+                cached->sourceHash = sourceHash;
+                SPDLOG_TRACE("Using compressed texture \"{}\" from the cache", filePath);
+                return cached;
+            }
+            reportError(FW_ERROR(cached.error(), "Ignoring broken compression cache entry \"" + cachePath.generic_string() + "\""));
+        }
+
+        Expected<ImageData> imgData = loadImageMemory(bytes.data(), static_cast<int>(bytes.size()));
+        if (!imgData)
+            return std::unexpected(FW_ERROR(imgData.error(), "Failed to decode image \"" + filePath + "\""));
+        Image image = makeImage(imgData.value());
+        image.sourceHash = sourceHash;
+        return image;
+    }
+
+    Expected<Image> decodeSourceImage(const std::string& filePath, const bool useCompressionCache) {
+        if (std::optional<Expected<Image>> cooked = decodeCookedImage(filePath)) {
+            if (cooked->has_value())
+                return std::move(cooked->value());
+            reportError(FW_ERROR(cooked->error(), "Failed to load cooked texture for \"" + filePath + "\", using the source image"));
+        }
+        if (useCompressionCache)
+            return decodeCachedImage(filePath);
+
+        Expected<ImageData> imgData = loadImage(filePath.c_str());
+        if (!imgData)
+            return std::unexpected(FW_ERROR(imgData.error(), "Failed to decode image"));
+        return makeImage(imgData.value());
+    }
+
+    std::optional<std::array<int, 2>> getSourceImageSize(const std::string& filePath) {
+        std::filesystem::path cookedPath(filePath);
+        cookedPath.replace_extension(".dds");
+        std::error_code ec;
+        if (findPackedFile(cookedPath.generic_string()).has_value() || std::filesystem::is_regular_file(cookedPath, ec))
+            return std::nullopt;
+
+        int width, height, channelCount;
+        const bool found = [&] {
+            if (const auto packed = findPackedFile(filePath))
+                return stbi_info_from_memory(packed->data(), static_cast<int>(packed->size()), &width, &height, &channelCount) != 0;
+            return stbi_info(filePath.c_str(), &width, &height, &channelCount) != 0;
+        }();
+        if (!found)
+            return std::nullopt;
+        return std::array{width, height};
+    }
+
+    /*! Splits large mip levels over the thread pool. Safe to use from within pool tasks. */
+    void parallelForMipmap(const size_t count, const std::function<void(size_t)>& body) {
+        if (engineState == nullptr) {
+            for (size_t i = 0; i < count; i++)
+                body(i);
+            return;
+        }
+        engineState->threadPool.parallelFor(count, body);
+    }
+
+    uint64_t hashTextureUsage(const uint64_t contentHash, const BlockCompression::TextureUsage usage) {
+        return xxh64(&usage, sizeof(usage), contentHash);
+    }
+
+    Expected<Image> decodeImage(const std::string& filePath, const bool useCompressionCache) {
+        Expected<Image> image = decodeSourceImage(filePath, useCompressionCache);
+        if (!image.has_value())
+            return image;
+        const BlockCompression::TextureUsage usage = BlockCompression::guessTextureUsage(filePath);
+        image->srgb = usage == BlockCompression::TextureUsage::ALBEDO;
+        image->contentHash = hashTextureUsage(image->contentHash, usage);
+        // Done here rather than by the driver, so it happens off the render thread and in the right colour space
+        if (!image->blockFormat.has_value() && image->channelCount == 4) {
+            image->mipData = Mipmap::generateChain(
+                std::span(image->pixels.get(), static_cast<size_t>(image->width) * image->height * 4),
+                image->width, image->height, BlockCompression::getMipmapOptions(usage), parallelForMipmap);
+            image->levelCount = Mipmap::getLevelCount(image->width, image->height);
+        }
+        return image;
+    }
+
+    Expected<Image> compressImage(const Image& image, const BlockCompression::TextureUsage usage) {
+        if (image.blockFormat.has_value())
+            return std::unexpected(ERROR("Image is already compressed"));
+        if (image.pixels == nullptr || image.channelCount < 1 || image.channelCount > 4)
+            return std::unexpected(ERROR("Image has no pixels, or an unsupported channel count"));
+
+        // The encoders only take RGBA, expand greyscale the same way OpenGL samples it
+        const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        const int channelCount = image.channelCount;
+        std::vector<unsigned char> rgba(pixelCount * 4);
+        bool hasAlpha = false;
+        for (size_t i = 0; i < pixelCount; i++) {
+            const unsigned char* source = image.pixels.get() + i * channelCount;
+            unsigned char* target = rgba.data() + i * 4;
+            if (channelCount <= 2)
+                target[0] = target[1] = target[2] = source[0];
+            else
+                std::memcpy(target, source, 3);
+            target[3] = channelCount == 2 || channelCount == 4 ? source[channelCount - 1] : 255;
+            hasAlpha |= target[3] != 255;
+        }
+
+        const BlockCompression::BlockFormat format = BlockCompression::getFastBlockFormat(usage, hasAlpha);
+        Image compressed;
+        compressed.width = image.width;
+        compressed.height = image.height;
+        compressed.channelCount = BlockCompression::getChannelCount(format);
+        compressed.blockFormat = format;
+        compressed.levelCount = Mipmap::getLevelCount(image.width, image.height);
+        compressed.compressedData = BlockCompression::compressMipChain(format, rgba, image.width, image.height,
+            BlockCompression::getMipmapOptions(usage), parallelForMipmap);
+        compressed.contentHash = hashCompressedImage(compressed);
+        compressed.sourceHash = image.sourceHash;
+        compressed.srgb = image.srgb;
+        return compressed;
+    }
+
+    Expected<void> saveToCompressionCache(const Image& image) {
+        if (!image.blockFormat.has_value() || image.sourceHash == 0)
+            return std::unexpected(ERROR("Only images compressed from a source file can be cached"));
+        const Expected<void> written = writeFileAtomically(getCompressionCachePath(image.sourceHash), [&](std::ostream& out) {
+            return Dds::writeFile(out, image.blockFormat.value(), image.width, image.height, image.levelCount, image.compressedData);
+        });
+        if (!written.has_value())
+            return std::unexpected(FW_ERROR(written.error(), "Failed to save texture to the compression cache"));
+        return {};
+    }
+
+    /*! @returns The largest mip level no bigger than `maxSize`, if the image has all of its levels in memory. */
+    int getFirstUploadedLevel(const Image& image, const int maxSize) {
+        if (!image.blockFormat.has_value() && image.mipData.empty())
+            return 0;  // The driver generates the smaller levels from the full size one
+        int level = 0;
+        while (level + 1 < image.levelCount && std::max(image.width >> level, image.height >> level) > maxSize)
+            level++;
+        return level;
+    }
+
+    int getUploadedSize(const Image& image, const int maxSize) {
+        const int level = getFirstUploadedLevel(image, maxSize);
+        return std::max({image.width >> level, image.height >> level, 1});
+    }
+
+    Expected<unsigned int> uploadTexture(const Image& image, const int maxSize) {
+        const int firstLevel = getFirstUploadedLevel(image, maxSize);
+        if (image.blockFormat.has_value())
+            return uploadCompressedTexture(image, firstLevel);
+        if (firstLevel == 0)
+            return loadTexture(ImageData{image.width, image.height, image.channelCount, image.pixels.get()}, image.srgb,
+                image.mipData);
+
+        // The level becomes the base of a smaller texture, with the levels after it as its mip chain
+        size_t offset = 0;
+        for (int level = 1; level < firstLevel; level++)
+            offset += static_cast<size_t>(std::max(image.width >> level, 1)) * std::max(image.height >> level, 1) * 4;
+        const int width = std::max(image.width >> firstLevel, 1), height = std::max(image.height >> firstLevel, 1);
+        const size_t levelSize = static_cast<size_t>(width) * height * 4;
+        // Only ever read from, ImageData just isn't const because it also owns decoded pixels
+        auto* levelPixels = const_cast<unsigned char*>(image.mipData.data() + offset);
+        return loadTexture(ImageData{width, height, 4, levelPixels}, image.srgb,
+            std::span(image.mipData).subspan(offset + levelSize));
+    }
+
     std::expected<unsigned int, Error> loadTexture(const char* filePath)
     {
-        Expected<ImageData> imgData = loadImage(filePath);
-        if (!imgData)
-            return std::unexpected(FW_ERROR(imgData.error(), "Failed to load texture"));
-        const std::expected<unsigned int, Error> texture = loadTexture(imgData.value());
-        SPDLOG_TRACE("Loaded texture \"{}\" with dimensions {}x{}", filePath, imgData->width, imgData->height);
-        stbi_image_free(imgData->imgData);
+        Expected<Image> image = decodeImage(filePath);
+        if (!image)
+            return std::unexpected(FW_ERROR(image.error(), "Failed to load texture"));
+        const std::expected<unsigned int, Error> texture = uploadTexture(image.value());
+        SPDLOG_TRACE("Loaded texture \"{}\" with dimensions {}x{}", filePath, image->width, image->height);
         return texture;
     }
 
@@ -89,174 +622,301 @@ namespace Resource::Loading {
         Expected<ImageData> imgData = loadImageMemory(data, size);
         if (!imgData)
             return std::unexpected(FW_ERROR(imgData.error(), "Failed to load texture from memory"));
-        const std::expected<unsigned int, Error> texture = loadTexture(imgData.value());
+        const std::expected<unsigned int, Error> texture = loadTexture(imgData.value(), true);
         SPDLOG_TRACE("Loaded texture from memory with dimensions {}x{}", imgData->width, imgData->height);
         stbi_image_free(imgData->imgData);
         return texture;
     }
 
-    constexpr std::array<std::string, 6> cubemapFaces = {"right", "left", "top", "bottom", "front", "back"};
-
-    std::expected<unsigned int, Error> loadCubemap(const std::string& filePath) {
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+#pragma region Environment maps
+    constexpr const char* ENVIRONMENT_CACHE_DIRECTORY = "cache/environments";
+    // Bump whenever the prefiltering changes, so entries made by older versions are never used
+    constexpr uint64_t ENVIRONMENT_CACHE_VERSION = 1;
 
-        const auto extension_index = filePath.find_last_of('.');
-        const auto pathPrefix = filePath.substr(0, extension_index) + "_";
-
-        ImageData firstData = {};
-        for (int i = 0; i < 6; i++) {
-            const std::string path = pathPrefix + cubemapFaces[i] + filePath.substr(extension_index);
-
-            Expected<ImageData> imgData = loadImage(path.c_str());
-            if (!imgData) {
-                glDeleteTextures(1, &textureID);
-                return std::unexpected(FW_ERROR(imgData.error(), "Failed to load cubemap texture"));
-            }
-            if (imgData->width != imgData->height) {
-                glDeleteTextures(1, &textureID);
-                stbi_image_free(imgData->imgData);
-                return std::unexpected(ERROR("Cubemap texture must be square"));
-            }
-            if (i == 0)
-                firstData = imgData.value();
-            else if (imgData->width != firstData.width || imgData->channelCount != firstData.channelCount) {
-                glDeleteTextures(1, &textureID);
-                stbi_image_free(imgData->imgData);
-                return std::unexpected(ERROR("Cubemap texture faces must have the same dimensions and channel counts"));
-            }
-            SPDLOG_DEBUG("Loaded cubemap %s texture \"%s\" with dimensions %dx%d",
-                cubemapFaces[i].c_str(), path.c_str(), imgData->width, imgData->height);
+    bool isEnvironmentMapPath(std::string_view filePath) {
+        if (filePath.ends_with(IRRADIANCE_MAP_SUFFIX))
+            filePath.remove_suffix(IRRADIANCE_MAP_SUFFIX.size());
+        return filePath.ends_with(".hdr");
+    }
 
-            const GLint faceDir = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-            assert(faceDir >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && faceDir <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
+    std::filesystem::path getEnvironmentCachePath(const uint64_t sourceHash, const bool irradiance) {
+        return std::filesystem::path(ENVIRONMENT_CACHE_DIRECTORY)
+            / fmt::format("{:016x}_{}.dds", sourceHash, irradiance ? "irradiance" : "specular");
+    }
 
-            const GLint format = getGLChannels(imgData->channelCount);
-            glTexImage2D(faceDir,
-                0, format, imgData->width, imgData->height, 0, format, GL_UNSIGNED_BYTE, imgData->imgData);
-            stbi_image_free(imgData->imgData);
+    /*! Splits the texels of a whole RGBA16F cubemap, stored face by face, into one image per face. */
+    std::array<Image, 6> makeHalfCubemap(const int faceSize, const int levelCount, const std::span<const uint16_t> texels) {
+        const size_t faceStride = texels.size() / 6;
+        std::array<Image, 6> faces;
+        for (size_t i = 0; i < 6; i++) {
+            Image& face = faces[i];
+            face.width = face.height = faceSize;
+            face.channelCount = 4;
+            face.levelCount = levelCount;
+            face.halfData.assign(texels.begin() + static_cast<std::ptrdiff_t>(i * faceStride),
+                texels.begin() + static_cast<std::ptrdiff_t>((i + 1) * faceStride));
+            const std::array<int, 2> description = {faceSize, levelCount};
+            face.contentHash = xxh64(face.halfData.data(), face.halfData.size() * sizeof(uint16_t),
+                xxh64(description.data(), sizeof(description)));
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return faces;
+    }
 
-        return textureID;
+    /*! Parses a cubemap written by \ref Dds::writeHalfCubemapFile() "writeHalfCubemapFile()". */
+    Expected<std::array<Image, 6>> parseHalfCubemapDds(const std::span<const unsigned char> bytes) {
+        uint32_t magic = 0;
+        Dds::Header header{};
+        Dds::HeaderDX10 headerDX10{};
+        const size_t offset = sizeof(magic) + sizeof(header) + sizeof(headerDX10);
+        if (bytes.size() < offset)
+            return std::unexpected(ERROR("File is too small to be a DDS cubemap"));
+        std::memcpy(&magic, bytes.data(), sizeof(magic));
+        std::memcpy(&header, bytes.data() + sizeof(magic), sizeof(header));
+        std::memcpy(&headerDX10, bytes.data() + sizeof(magic) + sizeof(header), sizeof(headerDX10));
+        if (magic != Dds::MAGIC || header.size != sizeof(header) || header.pixelFormat.fourCC != Dds::FOURCC_DX10)
+            return std::unexpected(ERROR("Not a DX10 DDS file"));
+        if (headerDX10.dxgiFormat != Dds::DXGI_FORMAT_R16G16B16A16_FLOAT || !(headerDX10.miscFlag & Dds::MISC_TEXTURECUBE))
+            return std::unexpected(ERROR("Only RGBA16F DDS cubemaps are supported"));
+
+        const int faceSize = static_cast<int>(header.width);
+        const int levelCount = std::max<int>(static_cast<int>(header.mipMapCount), 1);
+        if (faceSize <= 0 || header.height != header.width
+            || levelCount > static_cast<int>(std::bit_width(static_cast<unsigned int>(faceSize))))
+            return std::unexpected(ERROR("DDS cubemap has invalid dimensions"));
+        size_t faceTexels = 0;
+        for (int level = 0; level < levelCount; level++)
+            faceTexels += static_cast<size_t>(std::max(faceSize >> level, 1)) * std::max(faceSize >> level, 1) * 4;
+        if (bytes.size() < offset + faceTexels * 6 * sizeof(uint16_t))
+            return std::unexpected(ERROR("DDS cubemap is truncated"));
+
+        std::vector<uint16_t> texels(faceTexels * 6);
+        std::memcpy(texels.data(), bytes.data() + offset, texels.size() * sizeof(uint16_t));
+        return makeHalfCubemap(faceSize, levelCount, texels);
     }
-    std::expected<unsigned int, Error> loadCubemap(const std::array<const unsigned char*, 6>& data, const std::array<int, 6>& sizes)
-    {
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-        ImageData firstData = {};
-        for (int i = 0; i < 6; i++) {
-            Expected<ImageData> imgData = loadImageMemory(data[i], sizes[i]);
-            if (!imgData) {
-                glDeleteTextures(1, &textureID);
-                return std::unexpected(FW_ERROR(imgData.error(), "Failed to load cubemap texture"));
-            }
-            if (imgData->width != imgData->height) {
-                glDeleteTextures(1, &textureID);
-                stbi_image_free(imgData->imgData);
-                return std::unexpected(ERROR("Cubemap texture must be square"));
-            }
-            if (i == 0)
-                firstData = imgData.value();
-            else if (imgData->width != firstData.width || imgData->channelCount != firstData.channelCount) {
-                glDeleteTextures(1, &textureID);
-                stbi_image_free(imgData->imgData);
-                return std::unexpected(ERROR("Cubemap texture faces must have the same dimensions and channel counts"));
+    /*!
+     * Converts an equirectangular HDR image into prefiltered cubemaps, or loads them from the cache.
+     * @details Both the specular and the irradiance cubemap are made and cached at once, as converting is most of the work.
+     */
+    Expected<std::array<Image, 6>> decodeEnvironmentMap(const std::string& filePath) {
+        const bool irradiance = filePath.ends_with(IRRADIANCE_MAP_SUFFIX);
+        const std::string sourcePath = irradiance ? filePath.substr(0, filePath.size() - IRRADIANCE_MAP_SUFFIX.size()) : filePath;
+
+        std::optional<MappedFile> mappedFile;
+        std::span<const unsigned char> bytes;
+        if (const auto packed = findPackedFile(sourcePath))
+            bytes = packed.value();
+        else {
+            Expected<MappedFile> file = MappedFile::open(sourcePath);
+            if (!file.has_value())
+                return std::unexpected(FW_ERROR(file.error(), "Failed to open environment map \"" + sourcePath + "\""));
+            mappedFile = std::move(file.value());
+            bytes = mappedFile->bytes();
+        }
+        const uint64_t sourceHash = xxh64(bytes.data(), bytes.size(), ENVIRONMENT_CACHE_VERSION);
+
+        const std::filesystem::path cachePath = getEnvironmentCachePath(sourceHash, irradiance);
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(cachePath, ec)) {
+            const Expected<MappedFile> cacheFile = MappedFile::open(cachePath.generic_string());
+            Expected<std::array<Image, 6>> cached = cacheFile.has_value()
+                ? parseHalfCubemapDds(cacheFile->bytes())
+                : std::unexpected(cacheFile.error());
+            if (cached.has_value()) {
+                SPDLOG_TRACE("Using prefiltered environment map \"{}\" from the cache", filePath);
+                return cached;
             }
-            SPDLOG_DEBUG("Loaded cubemap %d texture with dimensions %dx%d",
-                cubemapFaces[i].c_str(), imgData->width, imgData->height);
-
-            const GLint faceDir = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-            assert(faceDir >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && faceDir <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-
-            const GLint format = getGLChannels(imgData->channelCount);
-            glTexImage2D(faceDir,
-                0, format, imgData->width, imgData->height, 0, format, GL_UNSIGNED_BYTE, imgData->imgData);
-            stbi_image_free(imgData->imgData);
+            reportError(FW_ERROR(cached.error(), "Ignoring broken environment cache entry \"" + cachePath.generic_string() + "\""));
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        return textureID;
+        int width, height, channelCount;
+        const std::unique_ptr<float, void(*)(void*)> pixels(
+            stbi_loadf_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channelCount, 4),
+            stbi_image_free);
+        if (pixels == nullptr)
+            return std::unexpected(ERROR(fmt::format("Failed to decode environment map \"{}\": {}", sourcePath, stbi_failure_reason())));
+
+        SPDLOG_INFO("Prefiltering environment map \"{}\", this only happens once", sourcePath);
+        const Environment::Cubemap radiance = Environment::fromEquirectangular(
+            std::span(pixels.get(), static_cast<size_t>(width) * height * 4), width, height,
+            Environment::getFaceSize(width), parallelForMipmap);
+        std::optional<std::array<Image, 6>> requested;
+        for (const bool makeIrradiance : {false, true}) {
+            const Environment::Cubemap cubemap = makeIrradiance
+                ? Environment::convolveIrradiance(radiance, Environment::IRRADIANCE_FACE_SIZE, parallelForMipmap)
+                : Environment::prefilterSpecular(radiance, Environment::SPECULAR_LEVEL_COUNT, parallelForMipmap);
+            const std::vector<uint16_t> texels = Environment::toHalf(cubemap.texels);
+            // Failing to cache only makes the next load slow again
+            if (const Expected<void> written = writeFileAtomically(getEnvironmentCachePath(sourceHash, makeIrradiance),
+                    [&](std::ostream& out) { return Dds::writeHalfCubemapFile(out, cubemap.faceSize, cubemap.levelCount, texels); });
+                !written.has_value())
+                reportError(FW_ERROR(written.error(), "Failed to cache prefiltered environment map"));
+            if (makeIrradiance == irradiance)
+                requested = makeHalfCubemap(cubemap.faceSize, cubemap.levelCount, texels);
+        }
+        return std::move(requested.value());
     }
+#pragma endregion
 
-    std::expected<unsigned int, Error> loadCubemapSingle(const std::string& filePath)
-    {
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+#pragma region Cubemaps
+    constexpr std::array<std::string, 6> cubemapFaces = {"right", "left", "top", "bottom", "front", "back"};
 
-        Expected<ImageData> imgData = loadImage(filePath.c_str());
-        if (!imgData) {
-            glDeleteTextures(1, &textureID);
-            return std::unexpected(FW_ERROR(imgData.error(), "Failed to load cubemap texture"));
-        }
-        if (imgData->width != imgData->height) {
-            glDeleteTextures(1, &textureID);
-            stbi_image_free(imgData->imgData);
+    /*! Checks that a decoded face can be part of a cubemap whose first face is `first`. */
+    Expected<void> validateCubemapFace(const Image& face, const Image& first) {
+        if (face.width != face.height)
             return std::unexpected(ERROR("Cubemap texture must be square"));
+        if (face.width != first.width || face.channelCount != first.channelCount)
+            return std::unexpected(ERROR("Cubemap texture faces must have the same dimensions and channel counts"));
+        if (face.blockFormat != first.blockFormat || face.levelCount != first.levelCount)
+            return std::unexpected(ERROR("Cubemap texture faces must either all be cooked the same way, or not at all"));
+        return {};
+    }
+
+    /*! Decodes all six faces at once over the thread pool, then checks that they fit together. */
+    Expected<std::array<Image, 6>> decodeCubemapFaces(const std::function<Expected<Image>(size_t)>& decodeFace) {
+        std::array<Expected<Image>, 6> decoded;
+        parallelForMipmap(decoded.size(), [&](const size_t i) { decoded[i] = decodeFace(i); });
+
+        std::array<Image, 6> faces;
+        for (size_t i = 0; i < 6; i++) {
+            if (!decoded[i].has_value())
+                return std::unexpected(FW_ERROR(decoded[i].error(), "Failed to load cubemap " + cubemapFaces[i] + " texture"));
+            if (const Expected<void> valid = validateCubemapFace(decoded[i].value(), i == 0 ? decoded[i].value() : faces[0]);
+                !valid.has_value())
+                return std::unexpected(valid.error());
+            faces[i] = std::move(decoded[i].value());
         }
+        return faces;
+    }
 
-        const GLint format = getGLChannels(imgData->channelCount);
-        for (int i = 0; i < 6; i++) {
-            const GLint faceDir = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-            assert(faceDir >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && faceDir <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-            glTexImage2D(faceDir,
-                0, format, imgData->width, imgData->height, 0, format, GL_UNSIGNED_BYTE, imgData->imgData);
+    Expected<std::array<Image, 6>> decodeCubemap(const std::string& filePath) {
+        if (isEnvironmentMapPath(filePath))
+            return decodeEnvironmentMap(filePath);
+
+        const auto extension_index = filePath.find_last_of('.');
+        const auto pathPrefix = filePath.substr(0, extension_index) + "_";
+        return decodeCubemapFaces([&](const size_t i) -> Expected<Image> {
+            const std::string path = pathPrefix + cubemapFaces[i] + filePath.substr(extension_index);
+            Expected<Image> face = decodeSourceImage(path, false);  // Cubemaps are neither mipmapped nor sRGB
+            if (face.has_value())
+                SPDLOG_DEBUG("Loaded cubemap {} texture \"{}\" with dimensions {}x{}",
+                    cubemapFaces[i], path, face->width, face->height);
+            return face;
+        });
+    }
+
+    /*! Allocates immutable storage for a cubemap whose faces are all shaped like `face`. */
+    void allocateCubemapStorage(const Image& face) {
+        // The skybox is drawn without lighting, so cubemaps stay in the sRGB encoded space they are stored in.
+        // Environment maps are the exception, they hold linear HDR radiance
+        GLenum internalFormat;
+        if (!face.halfData.empty())
+            internalFormat = GL_RGBA16F;
+        else if (face.blockFormat.has_value())
+            internalFormat = getGLCompressedFormat(face.blockFormat.value(), false);
+        else
+            internalFormat = getGLPixelFormat(face.channelCount, false).internalFormat;
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, face.levelCount, internalFormat, face.width, face.height);
+    }
+
+    /*! Uploads every level of one face to storage made by \ref allocateCubemapStorage(). */
+    void uploadCubemapFace(const GLenum target, const Image& face) {
+        if (!face.halfData.empty()) {
+            size_t offset = 0;
+            for (int level = 0; level < face.levelCount; level++) {
+                const int size = std::max(face.width >> level, 1);
+                glTexSubImage2D(target, level, 0, 0, size, size, GL_RGBA, GL_HALF_FLOAT, face.halfData.data() + offset);
+                offset += static_cast<size_t>(size) * size * 4;
+            }
+        } else if (face.blockFormat.has_value())
+            uploadCompressedLevels(target, face, getGLCompressedFormat(face.blockFormat.value(), false));
+        else {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, face.channelCount == 4 ? 4 : 1);
+            glTexSubImage2D(target, 0, 0, 0, face.width, face.height, getGLPixelFormat(face.channelCount, false).format,
+                GL_UNSIGNED_BYTE, face.pixels.get());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
         }
-        stbi_image_free(imgData->imgData);
+    }
 
+    void setCubemapParameters(const Image& face) {
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        // Each level of a prefiltered environment map is a different roughness, picked between with textureLod
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+            static_cast<GLint>(face.halfData.empty() || face.levelCount == 1 ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR));
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
 
+    Expected<unsigned int> uploadCubemap(const std::array<Image, 6>& faces) {
+        if (faces[0].channelCount < 1 || faces[0].channelCount > 4 || faces[0].channelCount == 3)
+            return std::unexpected(ERROR("Unsupported cubemap channel count: " + std::to_string(faces[0].channelCount)));
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        allocateCubemapStorage(faces[0]);
+        for (int i = 0; i < 6; i++)
+            uploadCubemapFace(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i]);
+        setCubemapParameters(faces[0]);
         return textureID;
     }
 
-    std::expected<unsigned int, Error> loadCubemapSingle(const unsigned char* data, int size)
-    {
+    /*! Uploads one image to all six sides of a cubemap. */
+    Expected<unsigned int> uploadCubemap(const Image& face) {
+        if (const Expected<void> valid = validateCubemapFace(face, face); !valid.has_value())
+            return std::unexpected(valid.error());
+        if (face.channelCount < 1 || face.channelCount > 4 || face.channelCount == 3)
+            return std::unexpected(ERROR("Unsupported cubemap channel count: " + std::to_string(face.channelCount)));
         unsigned int textureID;
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-        Expected<ImageData> imgData = loadImageMemory(data, size);
-        if (!imgData) {
-            glDeleteTextures(1, &textureID);
-            return std::unexpected(FW_ERROR(imgData.error(), "Failed to load cubemap texture"));
-        }
-        if (imgData->width != imgData->height) {
-            glDeleteTextures(1, &textureID);
-            stbi_image_free(imgData->imgData);
-            return std::unexpected(ERROR("Cubemap texture must be square"));
+        allocateCubemapStorage(face);
+        uploadCubemapFace(GL_TEXTURE_CUBE_MAP_POSITIVE_X, face);
+        // The other sides are copied on the GPU, rather than sending the same pixels over the bus six times.
+        // Cubemaps count as six layers here, one per face
+        for (int level = 0; level < face.levelCount; level++) {
+            const int size = std::max(face.width >> level, 1);
+            for (int layer = 1; layer < 6; layer++)
+                glCopyImageSubData(textureID, GL_TEXTURE_CUBE_MAP, level, 0, 0, 0,
+                                   textureID, GL_TEXTURE_CUBE_MAP, level, 0, 0, layer, size, size, 1);
         }
+        setCubemapParameters(face);
+        return textureID;
+    }
 
-        const GLint format = getGLChannels(imgData->channelCount);
-        for (int i = 0; i < 6; i++) {
-            const GLint faceDir = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-            assert(faceDir >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && faceDir <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-            glTexImage2D(faceDir,
-                0, format, imgData->width, imgData->height, 0, format, GL_UNSIGNED_BYTE, imgData->imgData);
-        }
-        stbi_image_free(imgData->imgData);
+    std::expected<unsigned int, Error> loadCubemap(const std::string& filePath) {
+        Expected<std::array<Image, 6>> faces = decodeCubemap(filePath);
+        if (!faces)
+            return std::unexpected(FW_ERROR(faces.error(), "Failed to decode cubemap"));
+        return uploadCubemap(faces.value());
+    }
+    std::expected<unsigned int, Error> loadCubemap(const std::array<const unsigned char*, 6>& data, const std::array<int, 6>& sizes)
+    {
+        Expected<std::array<Image, 6>> faces = decodeCubemapFaces([&](const size_t i) -> Expected<Image> {
+            Expected<ImageData> imgData = loadImageMemory(data[i], sizes[i]);
+            if (!imgData)
+                return std::unexpected(imgData.error());
+            return makeImage(imgData.value());
+        });
+        if (!faces)
+            return std::unexpected(FW_ERROR(faces.error(), "Failed to decode cubemap from memory"));
+        return uploadCubemap(faces.value());
+    }
 
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    std::expected<unsigned int, Error> loadCubemapSingle(const std::string& filePath)
+    {
+        Expected<Image> face = decodeSourceImage(filePath, false);
+        if (!face)
+            return std::unexpected(FW_ERROR(face.error(), "Failed to load cubemap texture"));
+        return uploadCubemap(face.value());
+    }
 
-        return textureID;
+    std::expected<unsigned int, Error> loadCubemapSingle(const unsigned char* data, const int size)
+    {
+        Expected<ImageData> imgData = loadImageMemory(data, size);
+        if (!imgData)
+            return std::unexpected(FW_ERROR(imgData.error(), "Failed to load cubemap texture"));
+        return uploadCubemap(makeImage(imgData.value()));
     }
-}
\ No newline at end of file
+#pragma endregion
+}
@@ -1,24 +1,165 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <expected>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <GL/glew.h>
 
+#include "engine/resources/block_compression.h"
 #include "engine/util/error.h"
 
 namespace Resource
 {
+    enum class TextureResidency {
+        RESIDENT,  // All mip levels are loaded
+        DEMOTED,   // Only the smallest mip levels are loaded
+        EVICTED,   // Nothing is loaded, textureID is 0
+    };
+
     /*!
      * Class that stores an OpenGL texture ID and deletes it when it goes out of scope
+     * @note Textures loaded through the resource manager may be demoted or evicted when over the memory budget.
+     *       Use \ref Engine::ResourceManager::useTexture() "useTexture()" to get an ID that is safe to bind.
      */
     class ManagedTexture {
     public:
         unsigned int textureID;
-        explicit ManagedTexture(unsigned int textureID);
+        GLenum target;
+
+        /*! Estimated GPU memory used by the texture, including all mip levels. */
+        size_t gpuBytes = 0;
+        /*! The path the texture was loaded from. Empty if the texture can not be reloaded after eviction. */
+        std::string sourcePath{};
+        TextureResidency residency = TextureResidency::RESIDENT;
+        /*! The index of the frame in which the texture was last bound. */
+        uint64_t lastUsedFrame = 0;
+        /*! The larger dimension of the full size texture, and of the largest mip level currently uploaded. */
+        int fullSize = 0;
+        int residentSize = 0;
+        /*! The largest size asked for by any draw this frame, see \ref Engine::ResourceManager::useTexture() "useTexture()". */
+        int requestedSize = 0;
+
+        explicit ManagedTexture(unsigned int textureID, GLenum target = GL_TEXTURE_2D);
         ~ManagedTexture();
+
+        // Non-copyable
+        ManagedTexture(const ManagedTexture&) = delete;
+        ManagedTexture& operator=(const ManagedTexture&) = delete;
     };
+
+    /*!
+     * Queries OpenGL for the amount of memory a texture uses, including all of its mip levels and faces.
+     * @note Will bind the texture.
+     * @note This is an estimate, the driver may pad or compress the texture differently.
+     */
+    [[nodiscard]] size_t getTextureMemoryUsage(unsigned int textureID, GLenum target);
+    /*!
+     * Replaces a texture with a new one only containing its smaller mip levels.
+     * @param texture The texture to demote.
+     * @param maxSize The maximum width and height of the largest mip level kept.
+     * @return Whether the texture was demoted. Textures with no mip levels small enough can't be demoted.
+     * @note Will bind the new texture.
+     */
+    bool demoteTexture(ManagedTexture& texture, int maxSize);
 }
 
 namespace Resource::Loading
 {
+    /*! Frees pixel data allocated by the image decoder. */
+    struct ImageDeleter {
+        void operator()(unsigned char* pixels) const;
+    };
+    /*! A decoded image in CPU memory. Decoding is thread safe, so images can be prepared on worker threads. */
+    struct Image {
+        int width = 0, height = 0, channelCount = 0;
+        std::unique_ptr<unsigned char, ImageDeleter> pixels;
+        /*! Set for cooked images, whose mip levels are stored back to back in `compressedData` rather than in `pixels`. */
+        std::optional<BlockCompression::BlockFormat> blockFormat{};
+        std::vector<unsigned char> compressedData{};
+        /*! Every level below `pixels` of uncompressed RGBA images, back to back. Empty if the driver should generate them. */
+        std::vector<unsigned char> mipData{};
+        int levelCount = 1;
+        /*! Set for HDR images instead of `pixels`, every level of RGBA16F texels back to back. */
+        std::vector<uint16_t> halfData{};
+        /*!
+         * Hash of the decoded pixels, dimensions and usage, identical images share the same hash regardless of their source.
+         * The usage decides the colour space and how mip levels are filtered, so the same pixels used in different ways don't.
+         */
+        uint64_t contentHash = 0;
+        /*! Hash of the encoded source file, naming its entry in the compression cache. 0 if the cache wasn't used. */
+        uint64_t sourceHash = 0;
+        /*! Whether the colour channels are sRGB encoded, and should be linearised when sampled. Set for albedo textures. */
+        bool srgb = false;
+    };
+
+    /*!
+     * Decodes an image file without touching OpenGL.
+     * @details If a cooked `.dds` file with the same name exists, made with the `texcook` tool, it is loaded instead.
+     *          Loose cooked files older than their source image are ignored.
+     *          RGB images are expanded to RGBA, which uploads without any repacking.
+     *          RGBA images get their mip levels generated here too, filtered to suit what the file name says they are used for.
+     * @param useCompressionCache Look for a copy compressed at runtime by \ref compressImage() "compressImage()"
+     *                            before decoding the source image. Sets `sourceHash` either way.
+     * @note Safe to call from any thread.
+     */
+    [[nodiscard]] Expected<Image> decodeImage(const std::string& filePath, bool useCompressionCache = false);
+    /*! @returns `contentHash` combined with the usage an image was prepared for, see \ref Image::contentHash. */
+    [[nodiscard]] uint64_t hashTextureUsage(uint64_t contentHash, BlockCompression::TextureUsage usage);
+    /*!
+     * Reads the dimensions of a source image from its header, without decoding it.
+     * @return Nothing if the image can't be read, or if a cooked version would be loaded in its place.
+     * @note Safe to call from any thread.
+     */
+    [[nodiscard]] std::optional<std::array<int, 2>> getSourceImageSize(const std::string& filePath);
+    /*!
+     * Block compresses a decoded image and generates its mip levels, for source images that were never cooked.
+     * @details Uses the fast encoders, BC1 or BC3 for colour depending on whether the image has any transparency.
+     * @note Safe to call from any thread, and slow enough that it should be.
+     */
+    [[nodiscard]] Expected<Image> compressImage(const Image& image, BlockCompression::TextureUsage usage);
+    /*!
+     * Writes an image made by \ref compressImage() "compressImage()" to the compression cache,
+     * where \ref decodeImage() "decodeImage()" picks it up the next time the same source image is loaded.
+     * @note Safe to call from any thread.
+     */
+    [[nodiscard]] Expected<void> saveToCompressionCache(const Image& image);
+    /*!
+     * Uploads a decoded image as a mipmapped 2D texture, with immutable storage in a sized format.
+     * @details Cooked images are uploaded as is, along with their precomputed mip levels.
+     *          Other images get their full mip chain allocated up front, and generated by the driver if not decoded with one.
+     * @param maxSize Leave out the mip levels larger than this, if the image has its smaller levels in memory.
+     * @return The texture ID if successful, or an error if not.
+     * @attention If returned successfully, it is YOUR responsibility to free the memory allocated by opengl.
+     */
+    [[nodiscard]] Expected<unsigned int> uploadTexture(const Image& image, int maxSize = std::numeric_limits<int>::max());
+    /*! @returns The larger dimension of the largest mip level \ref uploadTexture() "uploadTexture()" would upload. */
+    [[nodiscard]] int getUploadedSize(const Image& image, int maxSize = std::numeric_limits<int>::max());
+    /*! Appended to the path of an environment map to load its diffuse irradiance instead, see \ref decodeCubemap() "decodeCubemap()". */
+    constexpr std::string_view IRRADIANCE_MAP_SUFFIX = "#irradiance";
+    /*! @returns Whether a cubemap path names an equirectangular HDR environment map, rather than a set of faces. */
+    [[nodiscard]] bool isEnvironmentMapPath(std::string_view filePath);
+    /*!
+     * Decodes the six faces of a cubemap without touching OpenGL.
+     * @details Equirectangular `.hdr` images are converted into an RGBA16F cubemap prefiltered for specular reflections,
+     *          with increasingly rough reflections in each mip level, or with \ref IRRADIANCE_MAP_SUFFIX into the diffuse irradiance.
+     *          Converting takes seconds, so both results are cached under `cache/environments` the first time either is asked for.
+     *          Faces stored as separate files are decoded in parallel over the thread pool.
+     * @param filePath The path to the file, see \ref loadCubemap(const std::string&) "loadCubemap" for the naming scheme.
+     * @note Safe to call from any thread.
+     */
+    [[nodiscard]] Expected<std::array<Image, 6>> decodeCubemap(const std::string& filePath);
+    /*!
+     * Uploads six decoded faces as a cubemap texture.
+     * @return The texture ID if successful, or an error if not.
+     * @attention If returned successfully, it is YOUR responsibility to free the memory allocated by opengl.
+     */
+    [[nodiscard]] Expected<unsigned int> uploadCubemap(const std::array<Image, 6>& faces);
+
     /*!
      * Load a texture from a file.
      * @param filePath The path to the file.
@@ -35,10 +176,10 @@ namespace Resource::Loading
      */
     std::expected<unsigned int, Error> loadTexture(const unsigned char* data, int size);
 
-    // TODO: Allow loading cubemap from equirectangular projection
     /*!
-     * Loads a cubemap texture from a set of files.
-     * @param filePath The path to the file. The different directions are inserted before the file extension with an underscore.
+     * Loads a cubemap texture from a set of files, or from an equirectangular environment map.
+     * @param filePath The path to the file. The different directions are inserted before the file extension with an underscore,
+     *                 unless it is an environment map, see \ref decodeCubemap() "decodeCubemap()".
      * @return The texture ID if successful, or an error if not.
      * @attention If returned successfully, it is YOUR responsibility to free the memory allocated by opengl.
      * @note The file name suffixes are: `_right`, `_left`, `_top`, `_bottom`, `_front`, `_back`.
@@ -57,6 +198,7 @@ namespace Resource::Loading
 
     /*!
      * Loads a cubemap texture from a single file to be used for all sides.
+     * @details The image is decoded and uploaded once, then copied to the other sides on the GPU.
      * @param filePath The path to the file.
      * @return The texture ID if successful, or an error if not.
      * @attention If returned successfully, it is YOUR responsibility to free the memory allocated by opengl.
@@ -2,15 +2,82 @@
 
 #include <GL/glew.h>
 #include <SDL.h>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <optional>
+#include <thread>
 
+#include "engine/util/file.h"
 #include "engine/util/logging.h"
+#include "engine/demo.h"
 #include "engine/game.h"
 #include "engine/state.h"
 
 EngineState *engineState;
 
-int run()
+/*! Applies the command line options to the engine config, see \ref EngineConfig for what they do. */
+void parseArguments(const int argc, char** argv, EngineConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--record-demo" && hasValue)
+            config.recordDemoPath = argv[++i];
+        else if (argument == "--play-demo" && hasValue)
+            config.playDemoPath = argv[++i];
+        else if (argument == "--lock-timestep" && hasValue)
+            config.demoLockedTimestep = std::strtod(argv[++i], nullptr);
+        else
+            SPDLOG_WARN("Ignoring unknown or incomplete command line option \"{}\"", argument);
+    }
+}
+
+// Prevent spiral of death  // TODO: Magic number?
+constexpr double MAX_FIXED_CATCH_UP = 0.1;
+
+/*!
+ * Runs fixed updates on their own thread at the fixed tick rate, see \ref EngineConfig::threadedSimulation.
+ * The thread is stopped and joined when this is destroyed.
+ */
+class SimulationThread {
+    using Clock = std::chrono::steady_clock;
+public:
+    SimulationThread() : thread(&SimulationThread::loop, this) {}
+    ~SimulationThread() {
+        stopping = true;
+        thread.join();
+    }
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    /*! @returns Whether a fixed update failed, which stops the simulation. */
+    [[nodiscard]] bool hasFailed() const { return failed; }
+
+private:
+    void loop() {
+        Clock::time_point nextTick = Clock::now();
+        while (!stopping) {
+            const double desiredFixedDT = 1.0 / engineState->config.fixedTPS;
+            std::this_thread::sleep_until(nextTick);
+            const Clock::time_point now = Clock::now();
+            if (now - nextTick > std::chrono::duration<double>(MAX_FIXED_CATCH_UP))
+                nextTick = now;  // Fell too far behind, drop the ticks that were missed
+
+            if (!fixedUpdate(desiredFixedDT)) {
+                failed = true;
+                return;
+            }
+            nextTick += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(desiredFixedDT));
+        }
+    }
+
+    std::atomic<bool> stopping = false;
+    std::atomic<bool> failed = false;
+    std::thread thread;  // Last, so everything the loop uses is initialised before it starts
+};
+
+int run(const int argc, char** argv)
 {
 #pragma region Setup
     setupLogging();
@@ -74,12 +141,28 @@ int run()
     }
 #endif
 
+    // Prefiltered environment maps have tiny mip levels, which show their face edges unless filtered across them
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // Loose files are still preferred, so development can happen without repacking
+    if (std::filesystem::exists(RESOURCE_PACK_PATH)) {
+        Expected<void> packResult = mountResourcePack(RESOURCE_PACK_PATH);
+        if (!packResult.has_value())
+            reportError(FW_ERROR(packResult.error(), "Failed to mount resource pack, falling back to loose files"));
+    }
+
     // Loaded enough to create the global state
     engineState = new EngineState(sdlWindow, glContext);
+    parseArguments(argc, argv, engineState->config);
     Expected<void> managerResult = engineState->resourceManager.populateErrorResources();
     if (!managerResult.has_value())
         throw std::runtime_error(stringifyError(FW_ERROR(managerResult.error(),
             "Failed to load resource manager error resources")));
+    if (engineState->config.prefetchResources && std::filesystem::exists(LOAD_MANIFEST_PATH)) {
+        Expected<void> prefetchResult = engineState->resourceManager.prefetch(LOAD_MANIFEST_PATH);
+        if (!prefetchResult.has_value())
+            reportError(FW_ERROR(prefetchResult.error(), "Failed to start prefetching resources"));
+    }
 
     if (!setupGame()) {
         SPDLOG_ERROR("Setup failed");
@@ -90,60 +173,158 @@ int run()
 #pragma region MainLoop
     {
         double fixedAccumulator = 0.0;
+        std::optional<Demo::Recorder> recorder;
+        std::optional<Demo::Player> demoPlayer;
+        if (!engineState->config.playDemoPath.empty()) {
+            Expected<Demo::Player> opened = Demo::Player::open(engineState->config.playDemoPath);
+            if (opened.has_value())
+                demoPlayer.emplace(std::move(opened.value()));
+            else
+                reportError(FW_ERROR(opened.error(), "Failed to open demo, running normally"));
+        }
+        else if (!engineState->config.recordDemoPath.empty()) {
+            Expected<Demo::Recorder> created = Demo::Recorder::create(engineState->config.recordDemoPath);
+            if (created.has_value())
+                recorder.emplace(std::move(created.value()));
+            else
+                reportError(FW_ERROR(created.error(), "Failed to start recording demo"));
+        }
+        const bool lockedTimestep = demoPlayer.has_value() && engineState->config.demoLockedTimestep > 0.0;
+
+        // Only read on startup, the game can't switch which thread its simulation state lives on halfway through
+        std::optional<SimulationThread> simulation;
+        if (engineState->config.threadedSimulation) {
+            if (recorder.has_value() || demoPlayer.has_value()) {
+                SPDLOG_WARN("Demos can only record and replay fixed updates on the main thread, ignoring threadedSimulation");
+                engineState->config.threadedSimulation = false;  // So the game interpolates with the alpha it is given
+            }
+            else
+                simulation.emplace();
+        }
+        const auto processEvent = [sdlWindow](const SDL_Event& event) {
+            // Tracked from events rather than asked of SDL, so replayed key events drive it too
+            if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+                engineState->keysDown[event.key.keysym.scancode] = event.type == SDL_KEYDOWN;
+            if (handleEvent(event)) return true;
+
+            switch (event.type) {
+                default: break;
+                case SDL_QUIT:
+                    SPDLOG_DEBUG("Received quit signal");
+                    return false;
+                case SDL_WINDOWEVENT:
+                    if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                        int w, h;
+                        SDL_GL_GetDrawableSize(sdlWindow, &w, &h);
+                        glViewport(0, 0, w, h);
+                    }
+                    break;
+            }
+            return true;
+        };
+        // Live input is ignored while replaying, the window can still be closed and resized
+        const auto handleLiveEvent = [&](const SDL_Event& event) {
+            if (demoPlayer.has_value() && event.type != SDL_QUIT && event.type != SDL_WINDOWEVENT)
+                return true;
+            if (recorder.has_value())
+                recorder->recordEvent(event);
+            return processEvent(event);
+        };
+        Engine::FramePacer& framePacer = engineState->framePacer;
         Uint64 frameStart = SDL_GetPerformanceCounter();
         while (true) {
 #pragma region DeltaTime
+            // Waits before the frame rather than after it, handling input all the while, so the frame starts with the latest input
+            if (engineState->config.limitFPS && !engineState->config.vsync && !lockedTimestep) {
+                const double expectedDT = 1.0 / engineState->config.maxFPS;
+                const auto deadline = frameStart + static_cast<Uint64>(expectedDT * static_cast<double>(SDL_GetPerformanceFrequency()));
+                if (!framePacer.waitUntil(deadline, handleLiveEvent))
+                    goto quit;
+            }
+
             const Uint64 lastFrameStart = frameStart;
             frameStart = SDL_GetPerformanceCounter();
             double deltaTime = static_cast<double>(frameStart - lastFrameStart) / static_cast<double>(SDL_GetPerformanceFrequency());
             if (engineState->config.deltaTimeLimit > 0 && deltaTime > engineState->config.deltaTimeLimit) // Things may get a bit weird if our deltaTime is like 10 seconds
                 deltaTime = engineState->config.deltaTimeLimit;
-
-            // TODO: Process inputs instead of sleeping, to mitigate some input lag
-            const double expectedDT = 1.0 / engineState->config.maxFPS;
-            if (engineState->config.limitFPS && !engineState->config.vsync && deltaTime < expectedDT) {
-                SDL_Delay(static_cast<Uint32>((expectedDT - deltaTime) * 1000.0));
-            }
+            if (recorder.has_value())
+                recorder->recordFrame(deltaTime);
 #pragma endregion
 
-            fixedAccumulator += deltaTime;
-            fixedAccumulator = std::fmin(fixedAccumulator, 0.1); // Prevent spiral of death  // TODO: Magic number?
-            const double desiredFixedDT = 1.0 / engineState->config.fixedTPS;
+            double interpolationAlpha = 0.0;
+            if (demoPlayer.has_value()) {
+#pragma region "Replay the recorded frame"
+                demoPlayer->addFrameTime(deltaTime);
+                if (lockedTimestep)
+                    deltaTime = engineState->config.demoLockedTimestep;
+                for (bool rendered = false; !rendered; ) {
+                    const std::optional<Demo::Record> record = demoPlayer->next();
+                    if (!record.has_value()) {
+                        SPDLOG_INFO("Demo finished: {}", demoPlayer->getSummary());
+                        goto quit;
+                    }
+                    switch (record->type) {
+                        case Demo::RecordType::EVENT:
+                            if (!processEvent(record->event))
+                                goto quit;
+                            break;
+                        case Demo::RecordType::FRAME:
+                            if (!lockedTimestep)
+                                deltaTime = record->value;
+                            break;
+                        case Demo::RecordType::TICK:
+                            // With a locked timestep, ticks follow from it below instead
+                            if (!lockedTimestep && !fixedUpdate(record->value)) {
+                                SPDLOG_ERROR("Fixed update failed");
+                                goto quit;
+                            }
+                            break;
+                        case Demo::RecordType::RENDER:
+                            interpolationAlpha = record->value;
+                            rendered = true;
+                            break;
+                    }
+                }
+#pragma endregion
+            }
 
-            while (fixedAccumulator >= desiredFixedDT) {
-                if (!fixedUpdate(desiredFixedDT)) {
+            if (simulation.has_value()) {
+                if (simulation->hasFailed()) {
                     SPDLOG_ERROR("Fixed update failed");
                     goto quit;
                 }
-                fixedAccumulator -= desiredFixedDT;
+                // Left at 0, a tick may finish while the frame is drawn, see renderUpdate()
             }
+            else if (!demoPlayer.has_value() || lockedTimestep) {
+                fixedAccumulator += deltaTime;
+                fixedAccumulator = std::fmin(fixedAccumulator, MAX_FIXED_CATCH_UP);
+                const double desiredFixedDT = 1.0 / engineState->config.fixedTPS;
 
-            // TODO: Allow recording demos?
-            SDL_Event event;
-            while (SDL_PollEvent(&event)) {
-                if (handleEvent(event)) continue;
-
-                switch (event.type) {
-                    default: break;
-                    case SDL_QUIT:
-                        SPDLOG_DEBUG("Received quit signal");
+                while (fixedAccumulator >= desiredFixedDT) {
+                    if (recorder.has_value())
+                        recorder->recordTick(desiredFixedDT);
+                    if (!fixedUpdate(desiredFixedDT)) {
+                        SPDLOG_ERROR("Fixed update failed");
                         goto quit;
-                    case SDL_WINDOWEVENT:
-                        if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                            int w, h;
-                            SDL_GL_GetDrawableSize(sdlWindow, &w, &h);
-                            glViewport(0, 0, w, h);
-                        }
-                        break;
+                    }
+                    fixedAccumulator -= desiredFixedDT;
                 }
+                interpolationAlpha = fixedAccumulator / desiredFixedDT;
             }
 
-            const bool renderSuccess = renderUpdate(deltaTime);
+            if (!framePacer.pollEvents(handleLiveEvent))
+                goto quit;
+            if (recorder.has_value())
+                recorder->recordRender(interpolationAlpha);
+
+            const bool renderSuccess = renderUpdate(deltaTime, interpolationAlpha);
             glLogErrors();
             if (!renderSuccess) {
                 SPDLOG_ERROR("Render update failed");
                 goto quit;
             }
+            framePacer.frameSubmitted();
+            engineState->resourceManager.endFrame();
         }
     }
 #pragma endregion
@@ -151,6 +332,11 @@ int run()
 #pragma region Shutdown
 quit:
     shutdownGame();
+    {
+        Expected<void> manifestResult = engineState->resourceManager.saveLoadManifest(LOAD_MANIFEST_PATH);
+        if (!manifestResult.has_value())
+            reportError(FW_ERROR(manifestResult.error(), "Failed to save load manifest"));
+    }
 quitNoShutdown:
     delete engineState;
     SPDLOG_DEBUG("Shutting down");
@@ -3,5 +3,10 @@
 #define LLG_GL_VER_MAJOR 4
 #define LLG_GL_VER_MINOR 6
 
-int run();
+/*! Resource pack mounted on startup if present, see `tools/pack.cpp`. */
+#define RESOURCE_PACK_PATH "resources.llgpak"
+/*! Resources loaded in a session are recorded here, and prefetched on the next startup. */
+#define LOAD_MANIFEST_PATH "load_order.manifest"
+
+int run(int argc, char** argv);
 
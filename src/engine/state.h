@@ -1,7 +1,12 @@
 #pragma once
+#include <array>
+#include <string>
+#include <SDL_scancode.h>
 #include <SDL_video.h>
 
+#include "engine/frame_pacer.h"
 #include "engine/resources/resource_manager.h"
+#include "engine/util/thread_pool.h"
 
 struct EngineConfig {
     double deltaTimeLimit = 3.0;
@@ -9,6 +14,55 @@ struct EngineConfig {
     bool vsync = true;
     int maxFPS = 100;
     int fixedTPS = 60;
+    /*!
+     * Run fixed updates on their own thread, so simulation and rendering overlap instead of adding up.
+     * Only read on startup.
+     */
+    bool threadedSimulation = false;
+
+    /*! Textures are demoted and evicted when their combined size exceeds this many bytes. 0 for no limit. */
+    size_t textureMemoryBudget = 0;
+    /*! The largest mip level size kept when demoting a texture. 0 to evict textures outright. */
+    int textureDemotionSize = 64;
+    /*!
+     * Block compress textures that weren't cooked on worker threads, caching the result on disk.
+     * The uncompressed texture is used until compression finishes.
+     */
+    bool compressTextures = true;
+    /*!
+     * Load only the small mip levels of textures up front, and stream in the larger ones on worker threads
+     * once something is drawn close enough to the camera to need them.
+     */
+    bool textureStreaming = true;
+    /*! The largest mip level size uploaded when a streamed texture is first loaded. */
+    int textureStreamingInitialSize = 64;
+    /*! Pack the small textures of scene materials into shared atlases when the scene is loaded. */
+    bool atlasSmallTextures = true;
+    /*!
+     * Upload meshes with quantized 16 byte vertices instead of 32 byte ones, see \ref Resource::PackedMeshVertex.
+     * Only applies to meshes loaded after it is changed.
+     */
+    bool packVertices = true;
+
+    /*! Cells of a streamed world closer to the player than this are loaded, see \ref Engine::WorldStreamer. */
+    float worldLoadRadius = 96.0f;
+    /*! Cells of a streamed world farther from the player than this are unloaded. Larger than the load radius, so cells on the edge aren't reloaded over and over. */
+    float worldUnloadRadius = 128.0f;
+    /*! The farthest cells of a streamed world are unloaded when their geometry exceeds this many bytes. 0 for no limit. */
+    size_t worldMemoryBudget = 0;
+
+    /*! Record every frame's input and timing to this file, see \ref Demo::Recorder. Set with `--record-demo <path>`. */
+    std::string recordDemoPath;
+    /*! Replay a demo instead of taking live input, quitting once it ends. Set with `--play-demo <path>`. */
+    std::string playDemoPath;
+    /*!
+     * While replaying, advance every frame by this many seconds instead of the recorded frame times, and run as fast as possible.
+     * 0 to replay the recorded times. Set with `--lock-timestep <seconds>`.
+     */
+    double demoLockedTimestep = 0.0;
+
+    /*! Decode the resources loaded in the previous session on worker threads during startup. */
+    bool prefetchResources = true;
 };
 
 struct EngineState {
@@ -20,7 +74,13 @@ struct EngineState {
 
     EngineConfig config{};
 
+    // Declared before anything that submits work to it, so it is destroyed last
+    Engine::ThreadPool threadPool{};
     Engine::ResourceManager resourceManager{};
+    Engine::FramePacer framePacer{};
+
+    /*! Which keys are held, indexed by SDL_Scancode. Tracked from handled events, so replayed demos drive it too. */
+    std::array<bool, SDL_NUM_SCANCODES> keysDown{};
 };
 
 /*!
@@ -1,8 +1,18 @@
 #include "file.h"
 
+#include <filesystem>
 #include <fstream>
+#include <thread>
+#include <vector>
+
+#include "engine/util/resource_pack.h"
+
+std::vector<ResourcePack> mountedPacks;
 
 std::expected<std::string, Error> readTextFile(const std::string &filePath) {
+    if (const auto packed = findPackedFile(filePath))
+        return std::string(reinterpret_cast<const char*>(packed->data()), packed->size());
+
     std::ifstream file(filePath);
     if (!file.is_open())
         return std::unexpected(ERROR("Failed to open file: " + filePath));
@@ -10,3 +20,52 @@ std::expected<std::string, Error> readTextFile(const std::string &filePath) {
     std::string fileContents((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
     return fileContents;
 }
+
+Expected<void> writeFileAtomically(const std::filesystem::path& filePath, const std::function<bool(std::ostream&)>& write) {
+    std::error_code ec;
+    if (filePath.has_parent_path())
+        std::filesystem::create_directories(filePath.parent_path(), ec);
+    if (ec)
+        return std::unexpected(ERROR("Failed to create directory for \"" + filePath.generic_string() + "\": " + ec.message()));
+
+    // Unique per thread, so concurrent writers of the same file don't clobber each other's temporary files
+    std::filesystem::path tempPath = filePath;
+    tempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file || !write(file)) {
+            file.close();
+            std::filesystem::remove(tempPath, ec);
+            return std::unexpected(ERROR("Failed to write file: " + tempPath.generic_string()));
+        }
+    }
+    std::filesystem::rename(tempPath, filePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return std::unexpected(ERROR("Failed to move file into place: " + filePath.generic_string()));
+    }
+    return {};
+}
+
+Expected<void> mountResourcePack(const std::string& packPath) {
+    Expected<ResourcePack> pack = ResourcePack::open(packPath);
+    if (!pack.has_value())
+        return std::unexpected(FW_ERROR(pack.error(), "Failed to mount resource pack"));
+    SPDLOG_INFO("Mounted resource pack \"{}\" with {} files", packPath, pack->getEntryCount());
+    mountedPacks.push_back(std::move(pack.value()));
+    return {};
+}
+
+std::optional<std::span<const unsigned char>> findPackedFile(const std::string& filePath) {
+    if (mountedPacks.empty())
+        return std::nullopt;
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(filePath, ec))
+        return std::nullopt;  // Loose files override packed ones
+
+    for (auto pack = mountedPacks.rbegin(); pack != mountedPacks.rend(); ++pack) {
+        if (auto data = pack->find(filePath))
+            return data;
+    }
+    return std::nullopt;
+}
@@ -1,7 +1,30 @@
 #pragma once
 #include <expected>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
 #include <string>
 
 #include "engine/util/error.h"
 
 std::expected<std::string, Error> readTextFile(const std::string &filePath);
+/*!
+ * Writes a file under a temporary name and then moves it into place, so readers never see it partially written.
+ * Creates the parent directory if needed. Safe to call from several threads, even for the same path.
+ * @param write Writes the contents, returning whether it succeeded.
+ */
+[[nodiscard]] Expected<void> writeFileAtomically(const std::filesystem::path& filePath, const std::function<bool(std::ostream&)>& write);
+
+/*!
+ * Mounts a resource pack, making its files available to the resource loaders.
+ * Packs mounted later take priority over earlier ones.
+ */
+[[nodiscard]] Expected<void> mountResourcePack(const std::string& packPath);
+/*!
+ * Looks up a file in the mounted resource packs.
+ * @return A view into the memory mapped pack, valid for the rest of the program.
+ *         Empty if the file isn't packed, or if a loose file with the same path exists (to allow overriding packed files during development).
+ */
+[[nodiscard]] std::optional<std::span<const unsigned char>> findPackedFile(const std::string& filePath);
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+namespace HashDetail {
+    constexpr uint64_t rotl64(const uint64_t x, const int r) { return (x << r) | (x >> (64 - r)); }
+    inline uint64_t read64(const unsigned char* p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+    inline uint32_t read32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+
+    constexpr uint64_t round(uint64_t acc, const uint64_t input) {
+        acc += input * XXH_PRIME64_2;
+        acc = rotl64(acc, 31);
+        return acc * XXH_PRIME64_1;
+    }
+    constexpr uint64_t mergeRound(uint64_t acc, const uint64_t value) {
+        acc ^= round(0, value);
+        return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+}
+
+/*!
+ * @brief 64-bit xxHash (XXH64) of a block of memory.
+ * @details Fast non-cryptographic hash, used to identify content and look up paths.
+ *          Results match the reference implementation on little-endian machines.
+ */
+inline uint64_t xxh64(const void* data, const size_t length, const uint64_t seed = 0) {
+    using namespace HashDetail;
+    auto p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + length;
+    uint64_t h64;
+
+    if (length >= 32) {
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = round(v1, read64(p)); p += 8;
+            v2 = round(v2, read64(p)); p += 8;
+            v3 = round(v3, read64(p)); p += 8;
+            v4 = round(v4, read64(p)); p += 8;
+        } while (p <= limit);
+
+        h64 = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h64 = mergeRound(h64, v1);
+        h64 = mergeRound(h64, v2);
+        h64 = mergeRound(h64, v3);
+        h64 = mergeRound(h64, v4);
+    } else {
+        h64 = seed + XXH_PRIME64_5;
+    }
+    h64 += static_cast<uint64_t>(length);
+
+    while (p + 8 <= end) {
+        h64 ^= round(0, read64(p));
+        h64 = rotl64(h64, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h64 ^= static_cast<uint64_t>(read32(p)) * XXH_PRIME64_1;
+        h64 = rotl64(h64, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h64 ^= static_cast<uint64_t>(*p) * XXH_PRIME64_5;
+        h64 = rotl64(h64, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    // Avalanche
+    h64 ^= h64 >> 33;
+    h64 *= XXH_PRIME64_2;
+    h64 ^= h64 >> 29;
+    h64 *= XXH_PRIME64_3;
+    h64 ^= h64 >> 32;
+    return h64;
+}
+
+inline uint64_t xxh64(const std::string_view string, const uint64_t seed = 0) {
+    return xxh64(string.data(), string.size(), seed);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "engine/util/hash.h"
+
+/*
+ * On-disk layout of a resource pack (all values little-endian):
+ *   PackHeader
+ *   PackEntry[entryCount]  (the table of contents, sorted by pathHash then path)
+ *   char[]                 (path string table, not null-terminated)
+ *   file data              (each file aligned to PACK_DATA_ALIGNMENT)
+ *
+ * Shared between the engine and the packer tool, so this header must stay free of engine dependencies.
+ */
+namespace Pack {
+    constexpr char MAGIC[8] = {'L', 'L', 'G', 'P', 'A', 'C', 'K', '\0'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint64_t DATA_ALIGNMENT = 16;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t tocOffset;
+        uint64_t stringsOffset;
+    };
+    static_assert(sizeof(Header) == 32);
+
+    struct Entry {
+        uint64_t pathHash;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        uint32_t pathOffset;  // Relative to the start of the string table
+        uint32_t pathLength;
+    };
+    static_assert(sizeof(Entry) == 32);
+
+    /*!
+     * Normalises a path so that different spellings of the same relative path share a pack entry.
+     * @example `./resources\assets/../assets/a.png` becomes `resources/assets/a.png`
+     */
+    inline std::string normalizePath(const std::string_view path) {
+        std::string generic(path);
+        for (char& c : generic)
+            if (c == '\\') c = '/';
+        std::string normal = std::filesystem::path(generic).lexically_normal().generic_string();
+        while (normal.starts_with("./"))
+            normal.erase(0, 2);
+        return normal;
+    }
+
+    inline uint64_t hashPath(const std::string_view normalizedPath) {
+        return xxh64(normalizedPath);
+    }
+}
@@ -0,0 +1,174 @@
+#include "resource_pack.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#pragma region MappedFile
+Expected<MappedFile> MappedFile::open(const std::string& filePath) {
+    MappedFile mapped;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return std::unexpected(ERROR("Failed to open file for mapping: " + filePath));
+    mapped.fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+        return std::unexpected(ERROR("Failed to get size of file: " + filePath));
+    mapped.size = static_cast<size_t>(fileSize.QuadPart);
+    if (mapped.size == 0)
+        return mapped;  // Empty files can't be mapped, but are still valid
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return std::unexpected(ERROR("Failed to create file mapping: " + filePath));
+    mapped.mappingHandle = mapping;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+        return std::unexpected(ERROR("Failed to map view of file: " + filePath));
+    mapped.data = static_cast<const unsigned char*>(view);
+#else
+    const int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::unexpected(ERROR("Failed to open file for mapping: " + filePath + ": " + std::strerror(errno)));
+
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        return std::unexpected(ERROR("Failed to stat file: " + filePath + ": " + std::strerror(errno)));
+    }
+    mapped.size = static_cast<size_t>(fileStat.st_size);
+    if (mapped.size == 0) {
+        ::close(fd);
+        return mapped;  // Empty files can't be mapped, but are still valid
+    }
+
+    void* view = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED)
+        return std::unexpected(ERROR("Failed to map file: " + filePath + ": " + std::strerror(errno)));
+    mapped.data = static_cast<const unsigned char*>(view);
+#endif
+    return mapped;
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    data = other.data;
+    size = other.size;
+    other.data = nullptr;
+    other.size = 0;
+#ifdef _WIN32
+    fileHandle = other.fileHandle;
+    mappingHandle = other.mappingHandle;
+    other.fileHandle = nullptr;
+    other.mappingHandle = nullptr;
+#endif
+}
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        data = other.data;
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = nullptr;
+        other.mappingHandle = nullptr;
+#endif
+    }
+    return *this;
+}
+#pragma endregion
+
+#pragma region ResourcePack
+Expected<ResourcePack> ResourcePack::open(const std::string& packPath) {
+    Expected<MappedFile> file = MappedFile::open(packPath);
+    if (!file.has_value())
+        return std::unexpected(FW_ERROR(file.error(), "Failed to map resource pack"));
+
+    const std::span<const unsigned char> bytes = file->bytes();
+    if (bytes.size() < sizeof(Pack::Header))
+        return std::unexpected(ERROR("Resource pack is too small to be valid: " + packPath));
+    Pack::Header header{};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, Pack::MAGIC, sizeof(Pack::MAGIC)) != 0)
+        return std::unexpected(ERROR("Not a resource pack: " + packPath));
+    if (header.version != Pack::VERSION)
+        return std::unexpected(ERROR("Unsupported resource pack version " + std::to_string(header.version)
+            + " (expected " + std::to_string(Pack::VERSION) + "): " + packPath));
+    if (header.tocOffset % alignof(Pack::Entry) != 0
+        // Written so a crafted offset can't wrap around and pass
+        || header.tocOffset > bytes.size()
+        || static_cast<uint64_t>(header.entryCount) * sizeof(Pack::Entry) > bytes.size() - header.tocOffset
+        || header.stringsOffset > bytes.size())
+        return std::unexpected(ERROR("Resource pack table of contents is out of bounds: " + packPath));
+
+    ResourcePack pack(std::move(file.value()));
+    pack.path = packPath;
+    const unsigned char* base = pack.file.bytes().data();
+    pack.entries = reinterpret_cast<const Pack::Entry*>(base + header.tocOffset);
+    pack.entryCount = header.entryCount;
+    pack.strings = reinterpret_cast<const char*>(base + header.stringsOffset);
+
+    // Validate everything up front so lookups never have to
+    const size_t stringTableSize = bytes.size() - header.stringsOffset;
+    for (uint32_t i = 0; i < pack.entryCount; i++) {
+        const Pack::Entry& entry = pack.entries[i];
+        if (static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > stringTableSize
+            || entry.dataOffset > bytes.size() || entry.dataSize > bytes.size() - entry.dataOffset)
+            return std::unexpected(ERROR("Resource pack entry " + std::to_string(i) + " is out of bounds: " + packPath));
+        if (i > 0 && pack.entries[i - 1].pathHash > entry.pathHash)
+            return std::unexpected(ERROR("Resource pack table of contents is not sorted: " + packPath));
+    }
+    return pack;
+}
+
+std::optional<std::span<const unsigned char>> ResourcePack::find(const std::string_view filePath) const {
+    const std::string normalized = Pack::normalizePath(filePath);
+    const uint64_t hash = Pack::hashPath(normalized);
+
+    const Pack::Entry* end = entries + entryCount;
+    for (const Pack::Entry* entry = std::lower_bound(entries, end, hash,
+            [](const Pack::Entry& e, const uint64_t h) { return e.pathHash < h; });
+         entry != end && entry->pathHash == hash; ++entry) {
+        // Hash collisions are astronomically unlikely, but cheap to rule out
+        if (std::string_view(strings + entry->pathOffset, entry->pathLength) == normalized)
+            return file.bytes().subspan(entry->dataOffset, entry->dataSize);
+    }
+    return std::nullopt;
+}
+#pragma endregion
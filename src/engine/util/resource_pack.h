@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "engine/util/error.h"
+#include "engine/util/pack_format.h"
+
+/*!
+ * A read-only memory mapping of an entire file.
+ * The mapping is released when the object goes out of scope.
+ */
+class MappedFile {
+public:
+    /*! Maps a file into memory. */
+    [[nodiscard]] static Expected<MappedFile> open(const std::string& filePath);
+    ~MappedFile();
+
+    [[nodiscard]] std::span<const unsigned char> bytes() const { return {data, size}; }
+
+    // Non-copyable
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    // Moveable
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+private:
+    MappedFile() = default;
+    void release();
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/*!
+ * A memory mapped archive of resource files, created with the `llgpack` tool.
+ * Lookups return views directly into the mapping, nothing is copied.
+ */
+class ResourcePack {
+public:
+    /*! Maps and validates a resource pack. */
+    [[nodiscard]] static Expected<ResourcePack> open(const std::string& packPath);
+
+    /*!
+     * Looks up a file in the pack.
+     * @param filePath The path of the file, as it would be loaded from disk. It will be normalised.
+     * @return A view of the file's bytes, valid for as long as the pack is alive.
+     */
+    [[nodiscard]] std::optional<std::span<const unsigned char>> find(std::string_view filePath) const;
+    [[nodiscard]] uint32_t getEntryCount() const { return entryCount; }
+    [[nodiscard]] const std::string& getPath() const { return path; }
+
+private:
+    explicit ResourcePack(MappedFile&& file) : file(std::move(file)) {}
+
+    std::string path;
+    MappedFile file;
+    const Pack::Entry* entries = nullptr;
+    uint32_t entryCount = 0;
+    const char* strings = nullptr;
+};
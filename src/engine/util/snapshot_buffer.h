@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace Engine {
+    /*!
+     * Hands immutable copies of some state from one thread to another, keeping the latest two so the reader can interpolate.
+     * @details Snapshots are shared, so a reader can keep using the ones it got while newer ones are published.
+     *          The lock is only held to swap pointers, never while copying the state itself.
+     */
+    template<typename T>
+    class SnapshotBuffer {
+    public:
+        struct Snapshots {
+            std::shared_ptr<const T> previous;
+            std::shared_ptr<const T> current;
+        };
+
+        /*! Makes a snapshot the current one, and the current one the previous one. */
+        void publish(T snapshot) {
+            auto published = std::make_shared<const T>(std::move(snapshot));
+            std::lock_guard lock(mutex);
+            snapshots.previous = std::exchange(snapshots.current, std::move(published));
+        }
+        /*! Replaces both snapshots, so there is nothing to interpolate from, such as before the first update or after teleporting. */
+        void reset(T snapshot) {
+            auto published = std::make_shared<const T>(std::move(snapshot));
+            std::lock_guard lock(mutex);
+            snapshots.previous = published;
+            snapshots.current = std::move(published);
+        }
+        /*! @returns The latest two snapshots, both null if nothing was published yet. */
+        [[nodiscard]] Snapshots read() const {
+            std::lock_guard lock(mutex);
+            return snapshots;
+        }
+
+    private:
+        mutable std::mutex mutex;
+        Snapshots snapshots;
+    };
+}
@@ -0,0 +1,268 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Engine {
+    /*!
+     * Chase-Lev work-stealing deque, with the memory orderings from "Correct and Efficient Work-Stealing for Weak Memory Models".
+     * @details Only the owning worker pushes and pops, at the bottom. Any thread may steal, from the top.
+     */
+    class WorkStealingDeque {
+        struct Buffer {
+            explicit Buffer(const int64_t capacity)
+                : capacity(capacity), slots(std::make_unique<std::atomic<Job*>[]>(static_cast<size_t>(capacity))) {}
+
+            [[nodiscard]] Job* get(const int64_t i) const { return slots[static_cast<size_t>(i & (capacity - 1))].load(std::memory_order_relaxed); }
+            void put(const int64_t i, Job* job) { slots[static_cast<size_t>(i & (capacity - 1))].store(job, std::memory_order_relaxed); }
+
+            int64_t capacity;  // Always a power of two
+            std::unique_ptr<std::atomic<Job*>[]> slots;
+        };
+        static constexpr int64_t INITIAL_CAPACITY = 256;
+
+        // On separate cache lines, as the owner and thieves mostly touch one each
+        alignas(64) std::atomic<int64_t> top = 0;
+        alignas(64) std::atomic<int64_t> bottom = 0;
+        std::atomic<Buffer*> buffer;
+        std::vector<std::unique_ptr<Buffer>> buffers;  // Outgrown buffers are kept, as thieves may still be reading them
+
+    public:
+        WorkStealingDeque() {
+            buffers.push_back(std::make_unique<Buffer>(INITIAL_CAPACITY));
+            buffer.store(buffers.back().get(), std::memory_order_relaxed);
+        }
+
+        void push(Job* job) {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            Buffer* current = buffer.load(std::memory_order_relaxed);
+            if (b - t > current->capacity - 1) {
+                auto grown = std::make_unique<Buffer>(current->capacity * 2);
+                for (int64_t i = t; i < b; i++)
+                    grown->put(i, current->get(i));
+                current = grown.get();
+                buffers.push_back(std::move(grown));
+                buffer.store(current, std::memory_order_release);
+            }
+            current->put(b, job);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        /*! @returns The newest job, or null if empty. */
+        [[nodiscard]] Job* pop() {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Buffer* current = buffer.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job* job = current->get(b);
+            if (t == b) {
+                // The last job, race thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        /*! @returns The oldest job, or null if empty or another thread took it first. */
+        [[nodiscard]] Job* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            Job* job = buffer.load(std::memory_order_acquire)->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+    };
+
+    // Which pool and worker the current thread belongs to, so jobs scheduled from a worker go to its own deque
+    constexpr size_t NO_WORKER = SIZE_MAX;
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local size_t currentWorker = NO_WORKER;
+
+    unsigned int ThreadPool::defaultThreadCount() {
+        // hardware_concurrency may return 0 if it can't tell
+        return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    ThreadPool::ThreadPool(const unsigned int threadCount) {
+        deques.reserve(threadCount);
+        for (unsigned int i = 0; i < threadCount; i++)
+            deques.push_back(std::make_unique<WorkStealingDeque>());
+        // Every deque exists before any worker starts stealing
+        workers.reserve(threadCount);
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+
+        // Deleting the jobs left over breaks the promises of their futures
+        for (const std::unique_ptr<WorkStealingDeque>& deque : deques)
+            while (Job* job = deque->pop())
+                delete job;
+        for (Job* job : injected)
+            delete job;
+    }
+
+    void ThreadPool::schedule(std::move_only_function<void()> function, JobCounter* counter) {
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        push(std::make_unique<Job>(std::move(function), counter));
+    }
+
+    void ThreadPool::scheduleAfter(JobCounter& dependency, std::move_only_function<void()> function, JobCounter* counter) {
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        auto job = std::make_unique<Job>(std::move(function), counter);
+        {
+            // finish() takes the continuations under the same lock after the count reaches zero, so neither side misses the other
+            std::lock_guard lock(dependency.mutex);
+            if (!dependency.isDone()) {
+                dependency.continuations.push_back(std::move(job));
+                return;
+            }
+        }
+        push(std::move(job));
+    }
+
+    void ThreadPool::wait(const JobCounter& counter) {
+        helpUntil([&] { return counter.isDone(); }, [&] {
+            std::unique_lock lock(counter.mutex);
+            counter.finished.wait_for(lock, WAIT_POLL_INTERVAL, [&] { return counter.isDone(); });
+        });
+        // The last finish() may still hold the lock, and the caller is free to destroy the counter once this returns
+        std::lock_guard lock(counter.mutex);
+    }
+
+    void ThreadPool::parallelFor(const size_t count, const std::function<void(size_t)>& body, const size_t grainSize) {
+        if (count == 0)
+            return;
+        const size_t grain = std::max<size_t>(grainSize, 1);
+        const size_t chunkCount = (count + grain - 1) / grain;
+        // Helpers may start after everything is done and the caller has returned, so they only share this
+        struct Progress {
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> completed = 0;
+        };
+        const auto progress = std::make_shared<Progress>();
+        const auto work = [progress, count, grain, &body] {
+            for (size_t first; (first = progress->next.fetch_add(grain)) < count; ) {
+                const size_t last = std::min(first + grain, count);
+                for (size_t i = first; i < last; i++)
+                    body(i);
+                if (progress->completed.fetch_add(last - first) + (last - first) == count)
+                    progress->completed.notify_all();
+            }
+        };
+
+        // body is only touched after claiming an index, which can't happen once all of them are done
+        const size_t helperCount = std::min<size_t>(workers.size(), chunkCount - 1);
+        for (size_t i = 0; i < helperCount; i++)
+            schedule(work);
+
+        work();
+        for (size_t completed; (completed = progress->completed.load()) < count; )
+            progress->completed.wait(completed);
+    }
+
+    void ThreadPool::push(std::unique_ptr<Job> job) {
+        if (currentPool == this) {
+            deques[currentWorker]->push(job.release());
+            queuedJobs.fetch_add(1);
+            // Taking the lock orders this with a worker checking for jobs before going to sleep
+            { std::lock_guard lock(mutex); }
+        }
+        else {
+            std::lock_guard lock(mutex);
+            injected.push_back(job.release());
+            queuedJobs.fetch_add(1);
+        }
+        condition.notify_one();
+    }
+
+    Job* ThreadPool::findJob() {
+        const bool isWorker = currentPool == this;
+        Job* job = isWorker ? deques[currentWorker]->pop() : nullptr;
+        // The shared queue holds whole tasks from other threads, so only workers take from it
+        if (job == nullptr && isWorker) {
+            std::lock_guard lock(mutex);
+            if (!injected.empty()) {
+                job = injected.front();
+                injected.pop_front();
+            }
+        }
+        if (job == nullptr && !deques.empty()) {
+            // Start from a different victim on every thread, so thieves don't all pile onto the same one
+            thread_local size_t victim = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            for (size_t attempt = 0; attempt < deques.size() && job == nullptr; attempt++) {
+                victim = (victim + 1) % deques.size();
+                if (!isWorker || victim != currentWorker)
+                    job = deques[victim]->steal();
+            }
+        }
+        if (job != nullptr)
+            queuedJobs.fetch_sub(1);
+        return job;
+    }
+
+    void ThreadPool::execute(Job* job) {
+        const std::unique_ptr<Job> owned(job);
+        owned->function();
+        if (owned->counter != nullptr)
+            finish(*owned->counter);
+    }
+
+    void ThreadPool::finish(JobCounter& counter) {
+        std::vector<std::unique_ptr<Job>> continuations;
+        {
+            // The count reaches zero under the lock, so a waiter taking it afterwards knows the counter is no longer touched
+            std::lock_guard lock(counter.mutex);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            continuations.swap(counter.continuations);
+            counter.finished.notify_all();
+        }
+        for (std::unique_ptr<Job>& continuation : continuations)
+            push(std::move(continuation));
+    }
+
+    void ThreadPool::helpUntil(const std::function<bool()>& isDone, const std::function<void()>& block) {
+        while (!isDone()) {
+            if (Job* job = findJob())
+                execute(job);
+            else
+                block();  // What's left is already running elsewhere, or waiting for a worker
+        }
+    }
+
+    void ThreadPool::workerLoop(const size_t workerIndex) {
+        currentPool = this;
+        currentWorker = workerIndex;
+        while (!stopping) {
+            if (Job* job = findJob()) {
+                execute(job);
+                continue;
+            }
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+        }
+    }
+}
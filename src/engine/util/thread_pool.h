@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Engine {
+    class JobCounter;
+
+    /*! A unit of work for the \ref ThreadPool, and the counter it decrements once done. */
+    struct Job {
+        std::move_only_function<void()> function;
+        JobCounter* counter = nullptr;
+    };
+
+    /*!
+     * Counts the jobs scheduled against it that haven't finished yet, so they can be waited on or depended on.
+     * @note Must outlive every job scheduled against it or after it.
+     *       Jobs discarded by the pool being destroyed never finish, so neither does their counter.
+     */
+    class JobCounter {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        [[nodiscard]] bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class ThreadPool;
+        std::atomic<size_t> pending = 0;
+        mutable std::mutex mutex;
+        mutable std::condition_variable finished;  // Notified under mutex once pending reaches zero
+        std::vector<std::unique_ptr<Job>> continuations;  // Scheduled once pending reaches zero, guarded by mutex
+    };
+
+    class WorkStealingDeque;
+
+    /*!
+     * A fixed set of worker threads executing jobs, each with its own Chase-Lev deque.
+     * @details Jobs scheduled from a worker go on the bottom of its own deque, where it takes them back from newest first.
+     *          Jobs scheduled from any other thread go on a shared queue, and are taken oldest first.
+     *          Workers that run out of jobs steal the oldest ones from the other workers.
+     *          Threads waiting on the pool run jobs in the meantime, see \ref wait(const JobCounter&) "wait()",
+     *          and block once there are none they may run.
+     * @note Jobs must not touch OpenGL, the context is only current on the main thread.
+     */
+    class ThreadPool {
+    public:
+        /*! @returns One thread per core, minus one for the main thread. Always at least one. */
+        [[nodiscard]] static unsigned int defaultThreadCount();
+
+        explicit ThreadPool(unsigned int threadCount = defaultThreadCount());
+        /*! Stops the workers. Jobs that haven't started yet are discarded, their futures report a broken promise. */
+        ~ThreadPool();
+
+        /*! Queues a task to run on a worker thread. */
+        template<typename F>
+        [[nodiscard]] std::future<std::invoke_result_t<F>> submit(F&& task) {
+            std::packaged_task<std::invoke_result_t<F>()> packagedTask(std::forward<F>(task));
+            auto future = packagedTask.get_future();
+            schedule(std::move(packagedTask));
+            return future;
+        }
+
+        /*! @param counter Incremented now and decremented once the job has run, if given. */
+        void schedule(std::move_only_function<void()> function, JobCounter* counter = nullptr);
+        /*!
+         * Queues a job to run once every job scheduled against a counter has finished.
+         * @param counter Incremented now and decremented once the job has run, if given.
+         *                Waiting on it also waits for the dependency.
+         */
+        void scheduleAfter(JobCounter& dependency, std::move_only_function<void()> function, JobCounter* counter = nullptr);
+        /*!
+         * Runs jobs on the calling thread until every job scheduled against the counter has finished.
+         * @details Workers run any job, other threads only ones already spawned by the workers,
+         *          so the main thread never picks up an unrelated long job from the shared queue.
+         *          Blocks whenever there is nothing to run.
+         */
+        void wait(const JobCounter& counter);
+        /*! Runs jobs on the calling thread until the future has a result, like the overload above. */
+        template<typename T>
+        void wait(const std::future<T>& future) {
+            helpUntil([&] { return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; },
+                [&] { future.wait_for(WAIT_POLL_INTERVAL); });
+        }
+
+        /*!
+         * Runs `body(i)` for every i in [0, count), spread over the workers and the calling thread.
+         * @details The calling thread claims indices as well and only waits for ones already being run,
+         *          so it is safe to call from within a task, even when every worker is busy.
+         * @param grainSize How many consecutive indices are claimed at once. Raise it when `body` is cheap.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t grainSize = 1);
+        /*! Runs `body(item)` for every item, like the overload above. */
+        template<typename T, typename F>
+        void parallelFor(const std::span<T> items, F&& body, const size_t grainSize = 1) {
+            parallelFor(items.size(), [&](const size_t i) { body(items[i]); }, grainSize);
+        }
+
+        [[nodiscard]] unsigned int getThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+        // Non-copyable, non-moveable (workers hold a pointer to the pool)
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+    private:
+        void workerLoop(size_t workerIndex);
+        void push(std::unique_ptr<Job> job);
+        /*! Takes a job from the calling worker's own deque, the shared queue (workers only) or another worker, in that order. */
+        [[nodiscard]] Job* findJob();
+        void execute(Job* job);
+        void finish(JobCounter& counter);
+        /*!
+         * Runs jobs until `isDone`, calling `block` whenever there are none.
+         * @param block Waits for up to \ref WAIT_POLL_INTERVAL, or less once done.
+         */
+        void helpUntil(const std::function<bool()>& isDone, const std::function<void()>& block);
+
+        // How long a waiting thread blocks before looking for jobs again, as new ones don't wake it
+        static constexpr std::chrono::milliseconds WAIT_POLL_INTERVAL{1};
+
+        std::vector<std::unique_ptr<WorkStealingDeque>> deques;  // One per worker, same order
+        std::vector<std::thread> workers;
+        std::deque<Job*> injected;  // Jobs scheduled from outside the workers, guarded by mutex
+        std::atomic<size_t> queuedJobs = 0;  // Jobs in any deque or the shared queue, workers sleep while it's zero
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> stopping = false;
+    };
+}
@@ -0,0 +1,223 @@
+#include "world_streamer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <numeric>
+#include <sstream>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "engine/state.h"
+#include "engine/util/file.h"
+#include "engine/util/logging.h"
+
+namespace Engine {
+    // Uploading a cell stalls the frame, so spread them out
+    constexpr size_t MAX_LOADS_PER_FRAME = 1;
+    // Imports share the thread pool with texture streaming and compression
+    constexpr size_t MAX_PENDING_LOADS = 4;
+
+    Expected<WorldLayout> loadWorldLayout(const std::string& layoutPath)
+    {
+        const auto contents = readTextFile(layoutPath);
+        if (!contents.has_value())
+            return std::unexpected(FW_ERROR(contents.error(), "Failed to read world layout"));
+
+        WorldLayout layout;
+        std::istringstream stream(contents.value());
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(stream, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty() || line.front() == '#')
+                continue;
+            const auto lineError = [&](const std::string& message) {
+                return std::unexpected(ERROR(fmt::format("{} on line {} of world layout \"{}\"", message, lineNumber, layoutPath)));
+            };
+
+            if (line.starts_with("cell_size ")) {
+                const char* first = line.data() + std::string_view("cell_size ").size();
+                const auto [end, ec] = std::from_chars(first, line.data() + line.size(), layout.cellSize);
+                if (ec != std::errc() || !(layout.cellSize > 0.0f))
+                    return lineError("Invalid cell size");
+                continue;
+            }
+
+            // Format: <x> <z> <path>, where the path may contain spaces
+            WorldCell cell;
+            const char* cursor = line.data();
+            const char* const lineEnd = line.data() + line.size();
+            for (int* coordinate : {&cell.coordinates.x, &cell.coordinates.y}) {
+                const auto [end, ec] = std::from_chars(cursor, lineEnd, *coordinate);
+                if (ec != std::errc() || end == lineEnd || *end != ' ')
+                    return lineError("Invalid cell coordinates");
+                cursor = end + 1;
+            }
+            cell.scenePath = std::string(cursor, lineEnd);
+            if (cell.scenePath.empty())
+                return lineError("Missing scene path");
+            layout.cells.push_back(std::move(cell));
+        }
+        return layout;
+    }
+
+    /*! @returns The CPU and GPU memory taken up by a scene's graph and geometry. Textures are left to the texture budget. */
+    size_t getSceneBytes(const Resource::Scene& scene) {
+        size_t bytes = scene.graph.getAllocatedBytes();
+        for (const Resource::Mesh& mesh : scene.meshes) {
+            bytes += mesh.vertices.capacity() * sizeof(Resource::MeshVertex) + mesh.indices.capacity() * sizeof(unsigned int);
+            // Buffers shared with other cells are counted by each of them, so unloading either is assumed to free them
+            if (mesh.buffers != nullptr)
+                bytes += mesh.buffers->gpuBytes;
+        }
+        return bytes;
+    }
+
+    WorldStreamer::WorldStreamer(WorldLayout layout)
+        : cellSize(layout.cellSize)
+    {
+        cells.reserve(layout.cells.size());
+        for (WorldCell& cell : layout.cells) {
+            StreamedCell& streamed = cells.emplace_back();
+            streamed.cell = std::move(cell);
+        }
+    }
+
+    WorldStreamer::~WorldStreamer() {
+        for (StreamedCell& cell : cells)
+            if (cell.state == CellState::LOADING)
+                engineState->resourceManager.discardScenePrefetch(cell.cell.scenePath);
+    }
+
+    size_t WorldStreamer::getLoadedCellCount() const {
+        return std::ranges::count(cells, CellState::LOADED, &StreamedCell::state);
+    }
+
+    void WorldStreamer::update(const glm::vec3& origin) {
+        const glm::vec2 point(origin.x, origin.z);
+        for (StreamedCell& cell : cells) {
+            const glm::vec2 cellMin = glm::vec2(cell.cell.coordinates) * cellSize;
+            cell.distance = glm::length(point - glm::clamp(point, cellMin, cellMin + cellSize));
+        }
+
+        // Cells between the two radii keep whatever state they're in, so moving along an edge doesn't reload them
+        const float unloadRadius = std::max(engineState->config.worldUnloadRadius, engineState->config.worldLoadRadius);
+        for (StreamedCell& cell : cells)
+            if (cell.distance > unloadRadius)
+                unload(cell);
+
+        finishLoads();
+        enforceBudget();
+        startLoads();
+    }
+
+    Expected<void> WorldStreamer::Draw(const Culling::View* view) const {
+        for (const StreamedCell& cell : cells) {
+            if (cell.state != CellState::LOADED)
+                continue;
+            // Cells are authored in world space
+            Expected<void> result = cell.scene->Draw(glm::mat4(1.0f), view);
+            if (!result.has_value())
+                return std::unexpected(FW_ERROR(result.error(), "Failed to draw world cell \"" + cell.cell.scenePath + "\""));
+        }
+        return {};
+    }
+
+    void WorldStreamer::unload(StreamedCell& cell) {
+        if (cell.state == CellState::LOADING)
+            engineState->resourceManager.discardScenePrefetch(cell.cell.scenePath);
+        else if (cell.state == CellState::LOADED) {
+            SPDLOG_DEBUG("Unloading world cell ({}, {})", cell.cell.coordinates.x, cell.cell.coordinates.y);
+            memoryUsage -= cell.bytes;
+            cell.scene.reset();  // The resource manager only holds on to it weakly
+        }
+        else
+            return;  // Failed cells stay failed, the resource manager would only hand out the error scene again
+        cell.state = CellState::UNLOADED;
+    }
+
+    /*! @returns The indices of the cells in a state, nearest first. */
+    template<typename Cells, typename State>
+    std::vector<size_t> getCellsByDistance(const Cells& cells, const State state) {
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < cells.size(); i++)
+            if (cells[i].state == state)
+                indices.push_back(i);
+        std::ranges::sort(indices, {}, [&](const size_t i) { return cells[i].distance; });
+        return indices;
+    }
+
+    void WorldStreamer::finishLoads() {
+        ResourceManager& resourceManager = engineState->resourceManager;
+        size_t loaded = 0;
+        for (const size_t index : getCellsByDistance(cells, CellState::LOADING)) {
+            StreamedCell& cell = cells[index];
+            // Restarts the import in case the scene was unloaded elsewhere before it was claimed
+            resourceManager.prefetchScene(cell.cell.scenePath);
+            if (loaded == MAX_LOADS_PER_FRAME || !resourceManager.isSceneReady(cell.cell.scenePath))
+                continue;
+            loaded++;
+
+            cell.scene = resourceManager.loadScene(cell.cell.scenePath);
+            if (cell.scene == resourceManager.errorScene) {
+                SPDLOG_WARN("Failed to load world cell ({}, {}), it will be left out", cell.cell.coordinates.x, cell.cell.coordinates.y);
+                cell.scene.reset();
+                cell.state = CellState::FAILED;
+                continue;
+            }
+            cell.bytes = getSceneBytes(*cell.scene);
+            cell.state = CellState::LOADED;
+            memoryUsage += cell.bytes;
+            SPDLOG_DEBUG("Loaded world cell ({}, {}), {} bytes", cell.cell.coordinates.x, cell.cell.coordinates.y, cell.bytes);
+        }
+    }
+
+    void WorldStreamer::enforceBudget() {
+        const size_t budget = engineState->config.worldMemoryBudget;
+        if (budget == 0)
+            return;
+        std::vector<size_t> loaded = getCellsByDistance(cells, CellState::LOADED);
+        // The nearest cell is kept even if it doesn't fit on its own
+        while (memoryUsage > budget && loaded.size() > 1) {
+            StreamedCell& farthest = cells[loaded.back()];
+            loaded.pop_back();
+            SPDLOG_DEBUG("World cells are over the memory budget, {} of {} bytes", memoryUsage, budget);
+            unload(farthest);
+        }
+    }
+
+    void WorldStreamer::startLoads() {
+        const size_t budget = engineState->config.worldMemoryBudget;
+        const float loadRadius = engineState->config.worldLoadRadius;
+        size_t pendingCount = 0;
+        size_t projectedUsage = memoryUsage;
+        for (const StreamedCell& cell : cells) {
+            if (cell.state == CellState::LOADING) {
+                pendingCount++;
+                projectedUsage += cell.bytes;
+            }
+        }
+
+        for (const size_t index : getCellsByDistance(cells, CellState::UNLOADED)) {
+            StreamedCell& cell = cells[index];
+            if (pendingCount == MAX_PENDING_LOADS || cell.distance > loadRadius)
+                break;
+            // Cells that were loaded before are only loaded again if they fit, counting the farther cells they would push out.
+            // Otherwise a cell unloaded for the budget would be loaded again right away.
+            if (budget != 0 && cell.bytes != 0) {
+                const size_t reclaimable = std::transform_reduce(cells.begin(), cells.end(), size_t{0}, std::plus{},
+                    [&](const StreamedCell& other) {
+                        return other.state == CellState::LOADED && other.distance > cell.distance ? other.bytes : 0;
+                    });
+                if (projectedUsage + cell.bytes > budget + reclaimable)
+                    continue;
+            }
+            engineState->resourceManager.prefetchScene(cell.cell.scenePath);
+            cell.state = CellState::LOADING;
+            pendingCount++;
+            projectedUsage += cell.bytes;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "engine/render/culling.h"
+#include "engine/resources/scene.h"
+#include "engine/util/error.h"
+
+namespace Engine {
+    /*! One square of a world, a scene authored in world space. */
+    struct WorldCell {
+        /*! Which square on the X and Z axes the cell covers, in multiples of the cell size. */
+        glm::ivec2 coordinates{};
+        std::string scenePath;
+    };
+
+    /*! A level split into a grid of cells on the X and Z axes, which are loaded as the player gets close to them. */
+    struct WorldLayout {
+        float cellSize = 64.0f;
+        std::vector<WorldCell> cells;
+    };
+    /*!
+     * Reads a world layout, which may be packed.
+     * @details The format is one `<x> <z> <scene path>` line per cell, where the path may contain spaces,
+     *          plus an optional `cell_size <size>` line. Empty lines and lines starting with `#` are skipped.
+     */
+    [[nodiscard]] Expected<WorldLayout> loadWorldLayout(const std::string& layoutPath);
+
+    /*!
+     * Keeps the cells of a world around a point loaded, and the rest unloaded.
+     * @details Cells are imported on worker threads through \ref ResourceManager::prefetchScene() "prefetchScene()",
+     *          and loaded through the resource manager once done, so anything else holding on to a cell's scene shares it.
+     *          Cells load within \ref EngineConfig::worldLoadRadius and unload past \ref EngineConfig::worldUnloadRadius.
+     *          When the loaded cells take up more than \ref EngineConfig::worldMemoryBudget, the farthest ones are unloaded.
+     * @note Must only be used on the main thread.
+     */
+    class WorldStreamer {
+    public:
+        explicit WorldStreamer(WorldLayout layout);
+        /*! Drops the imports that haven't been loaded yet. */
+        ~WorldStreamer();
+        WorldStreamer(const WorldStreamer&) = delete;
+        WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+        /*!
+         * Starts loading the cells that came into range, finishes the ones that were imported and unloads the rest.
+         * @note Should be called once every frame, before drawing.
+         */
+        void update(const glm::vec3& origin);
+        /*! Draws every loaded cell. */
+        Expected<void> Draw(const Culling::View* view = nullptr) const;
+
+        /*! @returns The bytes of geometry held by the loaded cells, which is what the memory budget applies to. */
+        [[nodiscard]] size_t getMemoryUsage() const { return memoryUsage; }
+        [[nodiscard]] size_t getLoadedCellCount() const;
+
+    private:
+        enum class CellState { UNLOADED, LOADING, LOADED, FAILED };
+        struct StreamedCell {
+            WorldCell cell;
+            CellState state = CellState::UNLOADED;
+            std::shared_ptr<Resource::Scene> scene;
+            /*! What the cell took up when it was last loaded, 0 if it never was. */
+            size_t bytes = 0;
+            /*! From the origin of the last update to the nearest point of the cell. */
+            float distance = 0.0f;
+        };
+
+        void unload(StreamedCell& cell);
+        void finishLoads();
+        void enforceBudget();
+        void startLoads();
+
+        float cellSize;
+        std::vector<StreamedCell> cells;
+        size_t memoryUsage = 0;
+    };
+}
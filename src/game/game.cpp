@@ -1,9 +1,11 @@
 #include "engine/game.h"
 
+#include <algorithm>
 #include <imgui.h>
 #include <memory>
 #include <engine/resources/scene.h>
 #include <GL/glew.h>
+#include <SDL_timer.h>
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -14,8 +16,10 @@
 #include "state.h"
 #include "engine/resources/resource_manager.h"
 #include "engine/state.h"
+#include "engine/render/culling.h"
 #include "engine/render/frame_buffer.h"
 #include "engine/util/logging.h"
+#include "engine/world/world_streamer.h"
 
 GameState *gameState;
 
@@ -23,8 +27,8 @@ unsigned int uboMatrices;
 
 std::unique_ptr<FrameBuffer> frameBuffer;
 
-// This is TEMPORARY until I // TODO: Implement a concept of objects/levels/whatever
-std::vector<std::shared_ptr<Resource::Scene>> scenes;
+// TODO: Implement a concept of objects on top of the level
+std::unique_ptr<Engine::WorldStreamer> world;
 Skybox *skybox;
 std::shared_ptr<Resource::Shader> mainShader;
 
@@ -67,26 +71,35 @@ bool setupGame() {
     glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_STATIC_DRAW);
     glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
 
-    scenes.push_back(engineState->resourceManager.loadScene("resources/assets/models/map.obj"));
+    auto worldLayout = Engine::loadWorldLayout("resources/assets/worlds/map.world");
+    if (!worldLayout.has_value())
+        throw std::runtime_error(stringifyError(FW_ERROR(worldLayout.error(), "Failed to load world layout")));
+    world = std::make_unique<Engine::WorldStreamer>(std::move(worldLayout.value()));
+
+    gameState->snapshots.reset({gameState->playerState.origin});
 
     return true;
 }
 void shutdownGame() {
     DebugGUI::shutdown();
+    world.reset();
     glDeleteBuffers(1, &uboMatrices);
     delete gameState;
     delete skybox;
 }
 bool pausedRenderUpdate(double deltaTime);
 
-bool renderUpdate(const double deltaTime) {
-    if (gameState->isPaused)
+bool renderUpdate(const double deltaTime, const double interpolationAlpha) {
+    if (gameState->isPaused) {
+        std::lock_guard lock(gameState->inputMutex);
+        gameState->input = {glm::vec3(0.0f), true};
         return pausedRenderUpdate(deltaTime);
+    }
 
     int windowWidth, windowHeight;
     SDL_GL_GetDrawableSize(engineState->sdlWindow, &windowWidth, &windowHeight);
 
-    const Uint8* keyState = SDL_GetKeyboardState(nullptr);
+    const auto& keyState = engineState->keysDown;
     auto inputDir = glm::vec3(0.0f, 0.0f,  0.0f);
     if (keyState[SDL_SCANCODE_W])
         inputDir += gameState->playerState.getForward();
@@ -105,8 +118,24 @@ bool renderUpdate(const double deltaTime) {
             !SDL_GetRelativeMouseMode()));
 
     inputDir = glm::dot(inputDir, inputDir) > 0.0f ? glm::normalize(inputDir) : inputDir; // dot(v, v) is squared length
-    constexpr auto CAMERA_SPEED = 2.5f;
-    gameState->playerState.origin += inputDir * CAMERA_SPEED * static_cast<float>(deltaTime);
+    {
+        std::lock_guard lock(gameState->inputMutex);
+        gameState->input = {inputDir, false};
+    }
+
+    // Drawn between the latest two ticks, so movement stays smooth at any frame rate
+    const auto [previousSnapshot, currentSnapshot] = gameState->snapshots.read();
+    double alpha = interpolationAlpha;
+    if (engineState->config.threadedSimulation && currentSnapshot->tickSeconds > 0.0) {
+        // Worked out from the tick that was read, as another one may have finished since the alpha we were given
+        const double sinceTick = static_cast<double>(SDL_GetPerformanceCounter() - currentSnapshot->tickEnd)
+            / static_cast<double>(SDL_GetPerformanceFrequency());
+        alpha = std::clamp(sinceTick / currentSnapshot->tickSeconds, 0.0, 1.0);
+    }
+    Player camera;
+    camera.origin = glm::mix(previousSnapshot->playerOrigin, currentSnapshot->playerOrigin, static_cast<float>(alpha));
+    camera.rotation = gameState->playerState.rotation;
+    world->update(camera.origin);
 
     frameBuffer->bind();
     glEnable(GL_DEPTH_TEST);
@@ -123,11 +152,14 @@ bool renderUpdate(const double deltaTime) {
         glEnable(GL_CULL_FACE);
 
     // TODO: FIGURE THIS OUT WITH NEW STATE
+    const glm::mat4 projection = CameraUtils::getProjectionMatrix(gameState->settings, windowWidth, windowHeight);
+    const glm::mat4 view = CameraUtils::getViewMatrix(camera);
     glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-        glm::value_ptr(CameraUtils::getProjectionMatrix(gameState->settings, windowWidth, windowHeight)));
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-        glm::value_ptr(CameraUtils::getViewMatrix(gameState->playerState)));
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+    // Meshlets facing away can only be skipped while back faces aren't drawn anyway, as set up above
+    const Culling::View cullingView = Culling::makeView(projection * view, camera.origin,
+        !gameState->settings.wireframe);
 
     mainShader->use();
 
@@ -144,8 +176,8 @@ bool renderUpdate(const double deltaTime) {
     mainShader->setFloat("pointLights[0].linear", 0.09f);
     mainShader->setFloat("pointLights[0].quadratic", 0.032f);
 
-    mainShader->setVec3("spotLight.position", gameState->playerState.origin);
-    mainShader->setVec3("spotLight.direction", gameState->playerState.getForward());
+    mainShader->setVec3("spotLight.position", camera.origin);
+    mainShader->setVec3("spotLight.direction", camera.getForward());
     mainShader->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
     mainShader->setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
     mainShader->setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
@@ -156,16 +188,16 @@ bool renderUpdate(const double deltaTime) {
     mainShader->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
     // TODO: Why is this not handled in the buffer
-    mainShader->setVec3("viewPos", gameState->playerState.origin);
+    mainShader->setVec3("viewPos", camera.origin);
 
-    for (const auto &scene : scenes) {
-        auto drawRet = scene->Draw();
-        if (!drawRet.has_value())
-            reportError(FW_ERROR(drawRet.error(), "Failed to draw scene"));
-    }
+    engineState->resourceManager.setStreamingView(camera.origin,
+        static_cast<float>(windowHeight) / (2.0f * std::tan(glm::radians(gameState->settings.baseFov) / 2.0f)));
+
+    if (auto drawRet = world->Draw(&cullingView); !drawRet.has_value())
+        reportError(FW_ERROR(drawRet.error(), "Failed to draw world"));
 
     const glm::mat4 trans = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, -2.0f));
-    engineState->resourceManager.loadScene("INVALID_SCENE")->Draw(trans);
+    engineState->resourceManager.loadScene("INVALID_SCENE")->Draw(trans, &cullingView);
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
@@ -209,8 +241,17 @@ bool pausedRenderUpdate(const double deltaTime) {
 }
 
 bool fixedUpdate(const double deltaTime) {
-    if (gameState->isPaused) return true;
-
+    SimulationInput input;
+    {
+        std::lock_guard lock(gameState->inputMutex);
+        input = gameState->input;
+    }
+    if (!input.paused) {
+        constexpr auto CAMERA_SPEED = 2.5f;
+        gameState->playerState.origin += input.moveDirection * CAMERA_SPEED * static_cast<float>(deltaTime);
+    }
+    // Published while paused too, so both snapshots settle on the same state and nothing is left to interpolate
+    gameState->snapshots.publish({gameState->playerState.origin, SDL_GetPerformanceCounter(), deltaTime});
     return true;
 }
 
@@ -1,5 +1,8 @@
 #include "gui.h"
 
+#include <array>
+#include <cfloat>
+#include <ranges>
 #include <imgui.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_sdl2.h>
@@ -46,10 +49,12 @@ namespace DebugGUI {
     }
 
     void drawSettingsGUI(double deltaTime);
+    void drawResourceStats();
     void drawOverlay(double deltaTime);
 
     void drawFrame(double deltaTime) {
         drawSettingsGUI(deltaTime);
+        drawResourceStats();
         drawOverlay(deltaTime);
 
         // // TODO: fix menu not being visible on first pause
@@ -92,6 +97,116 @@ namespace DebugGUI {
             ImGui::SliderFloat("Sensitivity", &gameState->settings.sensitivity, 0.01f, 1.0f);
         }
         ImGui::Checkbox("Wireframe", &gameState->settings.wireframe);
+
+        if (ImGui::CollapsingHeader("Textures")) {
+            constexpr size_t MiB = 1024 * 1024;
+            ImGui::Text("Texture memory: %.1f MiB",
+                static_cast<double>(engineState->resourceManager.getTextureMemoryUsage()) / MiB);
+            int budgetMiB = static_cast<int>(engineState->config.textureMemoryBudget / MiB);
+            if (ImGui::DragInt("Budget (MiB, 0 = unlimited)", &budgetMiB, 1, 0, 16384))
+                engineState->config.textureMemoryBudget = static_cast<size_t>(budgetMiB) * MiB;
+            ImGui::DragInt("Demotion size", &engineState->config.textureDemotionSize, 1, 0, 1024);
+            ImGui::Checkbox("Compress uncooked textures", &engineState->config.compressTextures);
+            ImGui::Checkbox("Stream mip levels", &engineState->config.textureStreaming);
+            ImGui::DragInt("Initial streaming size", &engineState->config.textureStreamingInitialSize, 1, 1, 1024);
+            ImGui::Checkbox("Atlas small scene textures", &engineState->config.atlasSmallTextures);
+        }
+        ImGui::End();
+    }
+
+    void drawTimingHistogram(const char* label, const Engine::TimingHistogram& histogram) {
+        std::array<float, Engine::TimingHistogram::BUCKET_COUNT> values{};
+        for (size_t i = 0; i < values.size(); i++)
+            values[i] = static_cast<float>(histogram.buckets[i]);
+        const std::string overlay = fmt::format("n={} avg={:.2f}ms max={:.2f}ms",
+            histogram.count, histogram.meanSeconds() * 1000.0, histogram.maxSeconds * 1000.0);
+        ImGui::PlotHistogram(label, values.data(), static_cast<int>(values.size()), 0, overlay.c_str(),
+            0.0f, FLT_MAX, ImVec2(0, 60));
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Bucket i holds loads taking 2^i to 2^(i+1) microseconds");
+    }
+
+    void drawResourceStats() {
+        if (!ImGui::Begin("Resources")) {
+            ImGui::End();
+            return;
+        }
+        const Engine::ResourceStats stats = engineState->resourceManager.getStats();
+        constexpr double KiB = 1024.0;
+
+        constexpr std::array<std::pair<Engine::ResourceType, const char*>, Engine::RESOURCE_TYPE_COUNT> typeNames = {{
+            {Engine::ResourceType::SHADER, "Shaders"},
+            {Engine::ResourceType::TEXTURE, "Textures"},
+            {Engine::ResourceType::CUBEMAP, "Cubemaps"},
+            {Engine::ResourceType::SCENE, "Scenes"},
+        }};
+        const auto drawRow = [](const char* name, const Engine::ResourceTypeStats& typeStats) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(typeStats.cacheHits));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(typeStats.cacheMisses));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(typeStats.prefetchHits));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(typeStats.contentShares));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(typeStats.failures));
+            ImGui::TableNextColumn(); ImGui::Text("%zu", typeStats.liveObjects);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f KiB", static_cast<double>(typeStats.cpuBytes) / KiB);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f KiB", static_cast<double>(typeStats.gpuBytes) / KiB);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f ms", typeStats.decodeTime.totalSeconds * 1000.0);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f ms", typeStats.uploadTime.totalSeconds * 1000.0);
+        };
+        constexpr auto tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+        if (ImGui::BeginTable("ResourceCounters", 11, tableFlags)) {
+            for (const char* header : {"Type", "Hits", "Misses", "Prefetched", "Shared", "Failed",
+                                       "Live", "CPU", "GPU", "Decode", "Upload"})
+                ImGui::TableSetupColumn(header);
+            ImGui::TableHeadersRow();
+            for (const auto& [type, name] : typeNames)
+                drawRow(name, stats[type]);
+            drawRow("Mesh buffers", stats.meshBuffers);
+            ImGui::EndTable();
+        }
+        if (ImGui::Button("Reset"))
+            engineState->resourceManager.resetStats();
+
+        if (ImGui::CollapsingHeader("Timings")) {
+            for (const auto& [type, name] : typeNames) {
+                if (!ImGui::TreeNode(name))
+                    continue;
+                // Scenes are imported rather than decoded, and converted rather than uploaded
+                const bool isScene = type == Engine::ResourceType::SCENE;
+                drawTimingHistogram(isScene ? "Import" : "Decode", stats[type].decodeTime);
+                drawTimingHistogram(isScene ? "Convert" : "Upload", stats[type].uploadTime);
+                ImGui::TreePop();
+            }
+            if (ImGui::TreeNode("Mesh buffers")) {
+                drawTimingHistogram("Upload", stats.meshBuffers.uploadTime);
+                ImGui::TreePop();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Recent loads")) {
+            constexpr auto loadTableFlags = tableFlags | ImGuiTableFlags_ScrollY;
+            if (ImGui::BeginTable("RecentLoads", 4, loadTableFlags, ImVec2(0, 200))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Wait");
+                ImGui::TableSetupColumn("Upload");
+                ImGui::TableSetupColumn("Status");
+                ImGui::TableHeadersRow();
+                for (const Engine::LoadEvent& event : stats.recentLoads | std::views::reverse) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(event.path.c_str());
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f ms", event.waitSeconds * 1000.0);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f ms", event.uploadSeconds * 1000.0);
+                    ImGui::TableNextColumn();
+                    if (event.failed)
+                        ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Failed");
+                    else
+                        ImGui::TextUnformatted(event.prefetched ? "Prefetched" : "Loaded");
+                }
+                ImGui::EndTable();
+            }
+        }
         ImGui::End();
     }
 
@@ -128,6 +243,14 @@ namespace DebugGUI {
         else if (fps < 120)
             col = ImVec4(0.0f, 1.0f, 0.0f, 1.0f);
         ImGui::TextColored(col, "%.0f FPS (%.1f ms)", fps, deltaTime * 1000.0);
+        const Engine::LatencyStats latency = engineState->framePacer.getLatencyStats();
+        if (latency.sampleCount > 0) {
+            ImGui::Text("Input latency: %.1f ms (avg %.1f, max %.1f)",
+                latency.latestSeconds * 1000.0, latency.averageSeconds * 1000.0, latency.maxSeconds * 1000.0);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("From the first input of a frame to the GPU finishing it, over the last %zu frames with input",
+                    latency.sampleCount);
+        }
 
         // Macro mayhem to not have duplicate code :D
         // Starting to feel like a JS dev
@@ -13,8 +13,9 @@ void Skybox::draw() const
 
     shader->use();
     shader->setInt("skybox", 0);
+    shader->setBool("hdr", Resource::Loading::isEnvironmentMapPath(cubemap->sourcePath));
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap->textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, engineState->resourceManager.useTexture(cubemap));
 
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, sizeof(CubeIndicesInside) / sizeof(unsigned int), GL_UNSIGNED_INT, nullptr);
@@ -1,6 +1,10 @@
 #pragma once
+#include <cstdint>
+#include <mutex>
+#include <glm/vec3.hpp>
 
 #include "engine/typedefs.h"
+#include "engine/util/snapshot_buffer.h"
 #include "game/player.h"
 
 struct GameSettings {
@@ -16,14 +20,35 @@ struct GameSettings {
 struct WorldState {
 };
 
+/*! What the simulation needs from input handling, written once per frame. */
+struct SimulationInput {
+    glm::vec3 moveDirection{};  // In world space, at most unit length
+    bool paused = false;
+};
+
+/*! What rendering needs from the simulation, published after every fixed update. */
+struct SimulationSnapshot {
+    glm::vec3 playerOrigin{};
+    uint64_t tickEnd = 0;      // When the tick finished, in SDL performance counter ticks
+    double tickSeconds = 0.0;  // The tick's deltaTime, 0 if it didn't come from a tick
+};
+
 // TODO: Make state (or rather parts of it, smartly) savable (including engine state!!!)
 struct GameState {
     GameSettings settings{};
 
+    /*!
+     * The player's origin belongs to the simulation, which may run on its own thread, see \ref EngineConfig::threadedSimulation.
+     * Rendering reads it from \ref snapshots instead. The rotation belongs to the main thread, mouse look isn't delayed by a tick.
+     */
     Player playerState{};
     WorldState worldState{};
 
     bool isPaused = false;
+
+    std::mutex inputMutex;
+    SimulationInput input{};  // Guarded by inputMutex
+    Engine::SnapshotBuffer<SimulationSnapshot> snapshots{};
 };
 
 extern GameState *gameState;
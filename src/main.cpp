@@ -1,7 +1,7 @@
 #include <SDL.h>
 #include "engine/run.h"
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
-    return run();
+    return run(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "engine/util/pack_format.h"
+
+struct PackFile {
+    std::string path;  // Normalised path, as looked up by the engine
+    std::filesystem::path sourcePath;
+    uint64_t size;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Invalid number of arguments.\n"
+                  << "Usage: " << argv[0] << " output.llgpak input_dir_or_file...\n"
+                  << "Paths are stored as given, so run this from the directory the game is run from.\n";
+        return 1;
+    }
+
+    std::filesystem::path outputPath{argv[1]};
+
+    std::vector<PackFile> files;
+    for (int i = 2; i < argc; i++) {
+        std::filesystem::path input{argv[i]};
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(input, ec)) {
+            files.push_back({Pack::normalizePath(input.generic_string()), input, std::filesystem::file_size(input)});
+            continue;
+        }
+        if (!std::filesystem::is_directory(input, ec)) {
+            std::cerr << "Input is neither a file nor a directory: " << input << "\n";
+            return 1;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+            if (!entry.is_regular_file()) continue;
+            files.push_back({Pack::normalizePath(entry.path().generic_string()), entry.path(), entry.file_size()});
+        }
+    }
+
+    // The engine binary searches the table of contents by hash
+    std::ranges::sort(files, [](const PackFile& a, const PackFile& b) {
+        const uint64_t hashA = Pack::hashPath(a.path), hashB = Pack::hashPath(b.path);
+        return hashA != hashB ? hashA < hashB : a.path < b.path;
+    });
+    const auto duplicate = std::ranges::adjacent_find(files, {}, &PackFile::path);
+    if (duplicate != files.end()) {
+        std::cerr << "File was specified more than once: " << duplicate->path << "\n";
+        return 1;
+    }
+
+    // Lay out the file
+    const auto alignUp = [](const uint64_t value) {
+        return (value + Pack::DATA_ALIGNMENT - 1) / Pack::DATA_ALIGNMENT * Pack::DATA_ALIGNMENT;
+    };
+    Pack::Header header{};
+    std::memcpy(header.magic, Pack::MAGIC, sizeof(Pack::MAGIC));
+    header.version = Pack::VERSION;
+    header.entryCount = static_cast<uint32_t>(files.size());
+    header.tocOffset = sizeof(Pack::Header);
+    header.stringsOffset = header.tocOffset + files.size() * sizeof(Pack::Entry);
+
+    std::vector<Pack::Entry> entries(files.size());
+    std::string strings;
+    for (size_t i = 0; i < files.size(); i++) {
+        entries[i].pathHash = Pack::hashPath(files[i].path);
+        entries[i].pathOffset = static_cast<uint32_t>(strings.size());
+        entries[i].pathLength = static_cast<uint32_t>(files[i].path.size());
+        entries[i].dataSize = files[i].size;
+        strings += files[i].path;
+    }
+    uint64_t dataCursor = alignUp(header.stringsOffset + strings.size());
+    for (auto& entry : entries) {
+        entry.dataOffset = dataCursor;
+        dataCursor = alignUp(dataCursor + entry.dataSize);
+    }
+
+    std::ofstream outFile(outputPath, std::ios::binary);
+    if (!outFile) {
+        std::perror(("Error opening output file: " + outputPath.string()).c_str());
+        return 1;
+    }
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Pack::Entry)));
+    outFile.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+    std::vector<char> buffer;
+    for (size_t i = 0; i < files.size(); i++) {
+        // Pad up to the entry's aligned offset
+        const auto padding = static_cast<std::streamsize>(entries[i].dataOffset) - outFile.tellp();
+        for (std::streamsize p = 0; p < padding; p++)
+            outFile.put('\0');
+
+        std::ifstream inFile(files[i].sourcePath, std::ios::binary);
+        buffer.resize(files[i].size);
+        if (!inFile || !inFile.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+            std::cerr << "Error reading input file: " << files[i].sourcePath << "\n";
+            return 1;
+        }
+        outFile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    if (!outFile) {
+        std::cerr << "Error writing output file: " << outputPath << "\n";
+        return 1;
+    }
+
+    std::cout << "Packed " << files.size() << " files into " << outputPath << " (" << outFile.tellp() << " bytes)\n";
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "engine/resources/block_compression.h"
+#include "engine/resources/dds.h"
+#include "engine/resources/mipmap.h"
+
+constexpr const char* formatNames[] = {"BC1", "BC3", "BC4", "BC5", "BC7"};
+
+bool isCookable(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::ranges::transform(extension, extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+bool cookTexture(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) {
+    int width, height, channelCount;
+    stbi_uc* pixels = stbi_load(inputPath.string().c_str(), &width, &height, &channelCount, 4);
+    if (!pixels) {
+        std::cerr << "Error decoding " << inputPath << ": " << stbi_failure_reason() << "\n";
+        return false;
+    }
+    std::vector<unsigned char> rgba(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+
+    const BlockCompression::TextureUsage usage = BlockCompression::guessTextureUsage(inputPath.generic_string());
+    const BlockCompression::BlockFormat format = BlockCompression::getBlockFormat(usage);
+    const int levelCount = Mipmap::getLevelCount(width, height);
+    const std::vector<unsigned char> compressed = BlockCompression::compressMipChain(format, rgba, width, height,
+        BlockCompression::getMipmapOptions(usage));
+
+    std::ofstream outFile(outputPath, std::ios::binary);
+    if (!outFile) {
+        std::perror(("Error opening output file: " + outputPath.string()).c_str());
+        return false;
+    }
+    if (!Dds::writeFile(outFile, format, width, height, levelCount, compressed)) {
+        std::cerr << "Error writing output file: " << outputPath << "\n";
+        return false;
+    }
+
+    std::cout << inputPath.generic_string() << ": " << width << "x" << height << " "
+              << formatNames[static_cast<int>(format)] << ", " << levelCount << " levels, "
+              << compressed.size() << " bytes\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool force = false;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--force") == 0)
+            force = true;
+        else
+            inputs.emplace_back(argv[i]);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Invalid number of arguments.\n"
+                  << "Usage: " << argv[0] << " [--force] input_dir_or_file...\n"
+                  << "Writes a block compressed <name>.dds with a full mip chain next to every image.\n"
+                  << "The format follows the file name: *_normal is BC5, *_specular is BC4, anything else is BC7.\n";
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& input : inputs) {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(input, ec)) {
+            files.push_back(input);
+            continue;
+        }
+        if (!std::filesystem::is_directory(input, ec)) {
+            std::cerr << "Input is neither a file nor a directory: " << input << "\n";
+            return 1;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+            if (entry.is_regular_file() && isCookable(entry.path()))
+                files.push_back(entry.path());
+    }
+
+    int failures = 0, skipped = 0;
+    for (const auto& file : files) {
+        std::filesystem::path outputPath = file;
+        outputPath.replace_extension(".dds");
+        std::error_code ec;
+        if (!force && std::filesystem::exists(outputPath, ec)
+            && std::filesystem::last_write_time(outputPath, ec) >= std::filesystem::last_write_time(file, ec)) {
+            skipped++;
+            continue;
+        }
+        if (!cookTexture(file, outputPath))
+            failures++;
+    }
+    if (skipped > 0)
+        std::cout << "Skipped " << skipped << " up to date textures\n";
+    return failures == 0 ? 0 : 1;
+}